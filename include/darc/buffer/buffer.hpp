@@ -35,7 +35,12 @@
 
 #pragma once
 
+#include <cstddef>
+#include <vector>
+#include <cassert>
+#include <algorithm>
 #include <streambuf>
+#include <boost/asio/buffer.hpp>
 
 namespace darc
 {
@@ -45,11 +50,68 @@ namespace buffer
 class buffer
 {
 public:
+  typedef std::vector<boost::asio::const_buffer> segment_list_type;
 
   virtual std::streambuf * streambuf() = 0;
   virtual char* gptr() = 0;
   virtual char* pptr() = 0;
   virtual char* data() = 0;
+  // Number of valid bytes in the buffer
+  virtual size_t len() = 0;
+
+  // Contiguous memory regions holding the valid data, in order
+  virtual void segments(segment_list_type& list)
+  {
+    list.push_back(boost::asio::const_buffer(data(), len()));
+  }
+
+  // Regions from the read position to the end of the valid data
+  virtual void unread_segments(segment_list_type& list)
+  {
+    size_t consumed = gptr() - data();
+    list.push_back(boost::asio::const_buffer(gptr(), len() - consumed));
+  }
+
+  // Contiguous room for size bytes at the write position, or 0 if the buffer
+  // can not provide it. commit() makes the bytes written there valid data.
+  virtual char * prepare(size_t size)
+  {
+    return 0;
+  }
+
+  virtual void commit(size_t size)
+  {
+    assert(false); // commit without prepare
+  }
+
+  // Skip size bytes at the read position
+  virtual void consume(size_t size)
+  {
+    char scratch[256];
+    while(size > 0)
+    {
+      std::streamsize n = streambuf()->sgetn(scratch, std::min(size, sizeof(scratch)));
+      if(n <= 0)
+      {
+        break;
+      }
+      size -= n;
+    }
+  }
+
+  // Free space in front of data()
+  virtual size_t headroom()
+  {
+    return 0;
+  }
+
+  // Write in front of the existing data without moving it. Returns false if
+  // there is no room.
+  virtual bool prepend(const char * data, size_t size)
+  {
+    return false;
+  }
+
   virtual ~buffer() {}
 
 };
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Source of outgoing message buffers
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <boost/shared_ptr.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+class buffer_allocator
+{
+public:
+  virtual ~buffer_allocator()
+  {
+  }
+
+  // Empty buffer with room for size bytes after headroom bytes, which
+  // lower layers can prepend their headers into
+  virtual shared_buffer allocate(size_t size, size_t headroom) = 0;
+
+  // Whether the buffers can not grow past size, so callers must pass the
+  // exact serialized size rather than a hint
+  virtual bool exact_size() const
+  {
+    return false;
+  }
+
+};
+
+typedef boost::shared_ptr<buffer_allocator> shared_buffer_allocator;
+
+}
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * DARC size-class buffer pool
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+/**
+ * Thread-safe pool of recycled memory blocks.
+ *
+ * Requests are rounded up to a power-of-two size class. Each class carves its
+ * blocks out of larger slabs and keeps released blocks on a free list, so in
+ * steady state allocate/deallocate never reach the heap. Requests larger than
+ * the biggest class go directly to the heap.
+ */
+class buffer_pool : public boost::noncopyable
+{
+public:
+  static const size_t min_block_size = 64;
+  static const size_t num_size_classes = 15; // 64 bytes .. 1 MB
+  static const size_t slab_size = 64 * 1024;
+
+  struct statistics
+  {
+    size_t allocations;      // total allocate() calls
+    size_t heap_allocations; // allocate() calls which had to go to the heap
+    size_t cached_blocks;    // blocks currently on the free lists
+    size_t slab_bytes;       // bytes owned by the pool
+
+    statistics() :
+      allocations(0),
+      heap_allocations(0),
+      cached_blocks(0),
+      slab_bytes(0)
+    {
+    }
+  };
+
+protected:
+  struct size_class
+  {
+    boost::mutex mutex;
+    size_t block_size;
+    std::vector<void*> free_blocks;
+    std::vector<char*> slabs;
+    size_t allocations;
+    size_t heap_allocations;
+
+    size_class() :
+      block_size(0),
+      allocations(0),
+      heap_allocations(0)
+    {
+    }
+  };
+
+  size_class classes_[num_size_classes];
+
+  // Statistics for requests above the largest size class
+  boost::mutex oversize_mutex_;
+  size_t oversize_allocations_;
+
+public:
+  buffer_pool();
+  ~buffer_pool();
+
+  void * allocate(size_t size);
+  void deallocate(void * block, size_t size);
+
+  // Actual number of bytes handed out for a request of 'size' bytes
+  static size_t block_size(size_t size);
+
+  statistics stats();
+
+  // Process wide pool. Never destroyed, as zmq may release buffers from its
+  // own threads during shutdown.
+  static buffer_pool& instance();
+
+protected:
+  static size_t class_index(size_t size);
+  void refill(size_class& sc);
+
+};
+
+}
+}
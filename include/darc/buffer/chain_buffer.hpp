@@ -0,0 +1,383 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Segmented buffer growing in pool allocated chunks
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstring>
+#include <algorithm>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <darc/buffer/buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+#include <darc/buffer/memory_accounting.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+class chain_buffer;
+typedef boost::shared_ptr<chain_buffer> shared_chain_buffer;
+
+/**
+ * Writing past the end of the last segment appends a new chunk from the
+ * buffer_pool, chunk sizes doubling up to max_chunk_size. Data already written
+ * is never moved. Received frames can be chained with append() so a multipart
+ * message is read without flattening it.
+ *
+ * The first chunk reserves headroom, so lower layers can prepend their
+ * headers in place and the whole packet still goes out as one segment.
+ */
+class chain_buffer : public std::streambuf, public darc::buffer::buffer
+{
+public:
+  static const size_t default_chunk_size = 1024*4;
+  static const size_t max_chunk_size = 1024*1024;
+  // Room for headers added by the lower layers, e.g. the link header
+  static const size_t default_headroom = 256;
+
+protected:
+  struct segment
+  {
+    shared_buffer storage;
+    char * start; // start of the memory, before any headroom
+    char * begin;
+    size_t len;
+    size_t capacity;
+  };
+
+  typedef std::vector<segment, pool_allocator<segment> > segment_chain_type;
+  segment_chain_type chain_;
+
+  size_t get_segment_; // segment holding the get area
+  size_t next_chunk_size_;
+  size_t headroom_;
+
+  // Bytes taken from the pool, and how many of them are charged to
+  // growth_counters_ beyond the charge made up front
+  memory_accounting::counters * growth_counters_;
+  size_t allocated_;
+  size_t up_front_;
+  size_t charged_;
+
+public:
+  chain_buffer(size_t first_chunk_size = default_chunk_size,
+               size_t headroom = default_headroom) :
+    get_segment_(0),
+    next_chunk_size_(first_chunk_size),
+    headroom_(headroom),
+    growth_counters_(0),
+    allocated_(0),
+    up_front_(0),
+    charged_(0)
+  {
+    setp(0, 0);
+    setg(0, 0, 0);
+  }
+
+  ~chain_buffer()
+  {
+    if(growth_counters_ != 0)
+    {
+      growth_counters_->remove(charged_ - up_front_);
+    }
+  }
+
+  static shared_chain_buffer create(size_t first_chunk_size = default_chunk_size,
+                                    size_t headroom = default_headroom)
+  {
+    return boost::allocate_shared<chain_buffer>(pool_allocator<chain_buffer>(),
+                                                first_chunk_size,
+                                                headroom);
+  }
+
+  // For a chain charged up_front bytes when it was created from a size
+  // hint: chunks allocated past that are charged to c for as long as the
+  // chain is alive
+  void charge_growth(memory_accounting::counters& c, size_t up_front)
+  {
+    growth_counters_ = &c;
+    up_front_ = up_front;
+    charged_ = up_front;
+    charge_allocated();
+  }
+
+  // Add data as a read-only segment. Further writes start a new chunk.
+  void append(shared_buffer data)
+  {
+    sync_put();
+    segment s;
+    s.storage = data;
+    s.start = data->data();
+    s.begin = data->data();
+    s.len = data->len();
+    s.capacity = s.len;
+    chain_.push_back(s);
+    setp(0, 0);
+  }
+
+  size_t segment_count() const
+  {
+    return chain_.size();
+  }
+
+  virtual std::streambuf * streambuf()
+  {
+    return this;
+  }
+
+  virtual char * pptr()
+  {
+    return std::streambuf::pptr();
+  }
+
+  virtual char * gptr()
+  {
+    return std::streambuf::gptr();
+  }
+
+  // Start of the first segment only
+  virtual char * data()
+  {
+    return chain_.empty() ? 0 : chain_.front().begin;
+  }
+
+  virtual size_t len()
+  {
+    size_t total = 0;
+    for(size_t i = 0; i < chain_.size(); i++)
+    {
+      total += written(i);
+    }
+    return total;
+  }
+
+  virtual size_t headroom()
+  {
+    return chain_.empty() ? 0 : chain_.front().begin - chain_.front().start;
+  }
+
+  // Uses the headroom of the first segment, or inserts a new segment in front
+  // when it is too small. Not possible once reading has started.
+  virtual bool prepend(const char * data, size_t size)
+  {
+    if(eback() != 0 || get_segment_ != 0)
+    {
+      return false;
+    }
+
+    sync_put();
+    if(size <= headroom())
+    {
+      segment& front = chain_.front();
+      front.begin -= size;
+      front.len += size;
+      front.capacity += size;
+      memcpy(front.begin, data, size);
+
+      if(std::streambuf::pptr() != 0 && chain_.size() == 1)
+      {
+        // still writing into the first segment
+        setp(front.begin, front.begin + front.capacity);
+        pbump(front.len);
+      }
+    }
+    else
+    {
+      segment s;
+      s.storage = pooled_buffer::create(size);
+      s.start = s.storage->data();
+      s.begin = s.start;
+      s.len = size;
+      s.capacity = size;
+      memcpy(s.begin, data, size);
+      chain_.insert(chain_.begin(), s);
+      allocated_ += size;
+      charge_allocated();
+    }
+    return true;
+  }
+
+  virtual void segments(segment_list_type& list)
+  {
+    for(size_t i = 0; i < chain_.size(); i++)
+    {
+      size_t len = written(i);
+      if(len > 0)
+      {
+        list.push_back(boost::asio::const_buffer(chain_[i].begin, len));
+      }
+    }
+  }
+
+  // Starts a new chunk if the current one does not have size bytes left
+  virtual char * prepare(size_t size)
+  {
+    if((size_t)(epptr() - std::streambuf::pptr()) < size)
+    {
+      sync_put();
+      add_chunk(std::max(size, grow_chunk_size()));
+    }
+    return std::streambuf::pptr();
+  }
+
+  virtual void commit(size_t size)
+  {
+    pbump(size);
+    sync_put();
+  }
+
+  virtual void unread_segments(segment_list_type& list)
+  {
+    for(size_t i = get_segment_; i < chain_.size(); i++)
+    {
+      segment& s = chain_[i];
+      char * begin = (i == get_segment_ && eback() != 0) ? std::streambuf::gptr() : s.begin;
+      size_t len = written(i) - (begin - s.begin);
+      if(len > 0)
+      {
+        list.push_back(boost::asio::const_buffer(begin, len));
+      }
+    }
+  }
+
+protected:
+  // Bytes written into segment i, counting what is in the put area. Only
+  // reads, so a buffer that is no longer written to can be read by any
+  // number of threads at once, e.g. a broadcast frame on several links.
+  size_t written(size_t i) const
+  {
+    if(i + 1 == chain_.size() && std::streambuf::pptr() != 0)
+    {
+      return std::streambuf::pptr() - chain_[i].begin;
+    }
+    return chain_[i].len;
+  }
+
+  // Record how much has been written into the last segment, before the
+  // chain is changed
+  void sync_put()
+  {
+    if(std::streambuf::pptr() != 0)
+    {
+      segment& tail = chain_.back();
+      tail.len = std::streambuf::pptr() - tail.begin;
+    }
+  }
+
+  void add_chunk(size_t size)
+  {
+    size_t headroom = chain_.empty() ? headroom_ : 0;
+    segment s;
+    s.storage = pooled_buffer::create(headroom + size);
+    s.start = s.storage->data();
+    s.begin = s.start + headroom;
+    s.len = 0;
+    s.capacity = size;
+    chain_.push_back(s);
+    setp(s.begin, s.begin + s.capacity);
+    allocated_ += headroom + size;
+    charge_allocated();
+  }
+
+  // Size of the next chunk, doubling each time up to max_chunk_size
+  size_t grow_chunk_size()
+  {
+    size_t size = next_chunk_size_;
+    next_chunk_size_ = std::max(std::min(size * 2, max_chunk_size), size_t(default_chunk_size));
+    return size;
+  }
+
+  void charge_allocated()
+  {
+    if(growth_counters_ != 0 && allocated_ > charged_)
+    {
+      growth_counters_->add(allocated_ - charged_);
+      charged_ = allocated_;
+    }
+  }
+
+  virtual int_type overflow(int_type c)
+  {
+    sync_put();
+    add_chunk(grow_chunk_size());
+
+    if(!traits_type::eq_int_type(c, traits_type::eof()))
+    {
+      *std::streambuf::pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+    return traits_type::not_eof(c);
+  }
+
+  virtual int_type underflow()
+  {
+    while(get_segment_ < chain_.size())
+    {
+      segment& s = chain_[get_segment_];
+      size_t len = written(get_segment_);
+      if(eback() == 0)
+      {
+        setg(s.begin, s.begin, s.begin + len);
+      }
+      else
+      {
+        // the segment may have grown since the get area was set
+        setg(s.begin, std::streambuf::gptr(), s.begin + len);
+      }
+
+      if(std::streambuf::gptr() < egptr())
+      {
+        return traits_type::to_int_type(*std::streambuf::gptr());
+      }
+
+      if(get_segment_ + 1 == chain_.size())
+      {
+        // stay on the last segment, more may be written to it
+        break;
+      }
+      get_segment_++;
+      setg(0, 0, 0);
+    }
+    return traits_type::eof();
+  }
+
+};
+
+}
+}
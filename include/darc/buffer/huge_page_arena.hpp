@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Pre-faulted huge page arena for large message buffers
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <darc/buffer/buffer_allocator.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+class huge_page_arena;
+typedef boost::shared_ptr<huge_page_arena> shared_huge_page_arena;
+
+/**
+ * The arena maps slot_count slots of slot_size bytes (rounded up to whole
+ * 2 MB huge pages) up front and touches every page, so publishing large
+ * messages neither page faults nor misses the TLB as often as fresh heap
+ * memory. Explicit huge pages (MAP_HUGETLB) are used when the system has
+ * them reserved, otherwise transparent huge pages are requested with
+ * madvise(MADV_HUGEPAGE).
+ *
+ * Requests larger than a slot, or made while all slots are in use, are
+ * served from the default chain_buffer path. Buffers keep the arena alive.
+ */
+class huge_page_arena : public buffer_allocator,
+                        public boost::enable_shared_from_this<huge_page_arena>,
+                        public boost::noncopyable
+{
+  friend class huge_page_buffer;
+
+public:
+  static const size_t huge_page_size = 2 * 1024 * 1024;
+
+  struct statistics
+  {
+    size_t allocations; // total allocate() calls
+    size_t fallbacks;   // allocate() calls not served from the arena
+    size_t free_slots;  // slots currently available
+    bool huge_pages;    // region is backed by explicit huge pages
+
+    statistics() :
+      allocations(0),
+      fallbacks(0),
+      free_slots(0),
+      huge_pages(false)
+    {
+    }
+  };
+
+protected:
+  boost::mutex mutex_;
+  char * map_;
+  size_t map_size_;
+  char * region_; // huge page aligned start of the slots
+  size_t slot_size_;
+  std::vector<size_t> free_slots_;
+  statistics stats_;
+
+  huge_page_arena(size_t slot_size, size_t slot_count);
+
+  void release(size_t slot);
+
+public:
+  ~huge_page_arena();
+
+  static shared_huge_page_arena create(size_t slot_size, size_t slot_count);
+
+  shared_buffer allocate(size_t size, size_t headroom);
+
+  bool exact_size() const
+  {
+    return true;
+  }
+
+  size_t slot_size() const
+  {
+    return slot_size_;
+  }
+
+  statistics stats();
+
+};
+
+}
+}
@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Accounting of the memory held by live buffers
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include <ostream>
+#include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <darc/id.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/buffer_allocator.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+// Origin of a buffer. Null IDs stand for "not specific to a tag/peer".
+struct memory_tag
+{
+  uint32_t service;
+  ID tag;
+  ID peer;
+
+  memory_tag(uint32_t service, const ID& tag = ID::null(), const ID& peer = ID::null()) :
+    service(service),
+    tag(tag),
+    peer(peer)
+  {
+  }
+
+  bool operator<(const memory_tag& other) const
+  {
+    if(service != other.service)
+    {
+      return service < other.service;
+    }
+    if(tag != other.tag)
+    {
+      return tag < other.tag;
+    }
+    return peer < other.peer;
+  }
+};
+
+/**
+ * Live and peak bytes per memory_tag. A charged buffer is counted until the
+ * last reference to it is dropped, wherever that reference is held: a zmq
+ * keep_alive, a queued handler or a slice given to a subscriber.
+ */
+class memory_accounting : public boost::noncopyable
+{
+public:
+  struct counters
+  {
+    boost::atomic<size_t> live;
+    boost::atomic<size_t> peak;
+    boost::atomic<size_t> buffers; // live buffers
+
+    counters() :
+      live(0),
+      peak(0),
+      buffers(0)
+    {
+    }
+
+    void add(size_t bytes)
+    {
+      size_t now = (live += bytes);
+      size_t old_peak = peak.load();
+      while(now > old_peak && !peak.compare_exchange_weak(old_peak, now))
+      {
+      }
+    }
+
+    void remove(size_t bytes)
+    {
+      live -= bytes;
+    }
+  };
+
+  struct entry
+  {
+    memory_tag tag;
+    size_t live;
+    size_t peak;
+    size_t buffers;
+
+    entry(const memory_tag& tag) :
+      tag(tag),
+      live(0),
+      peak(0),
+      buffers(0)
+    {
+    }
+  };
+
+  typedef std::vector<entry> entry_list_type;
+
+protected:
+  typedef std::map<memory_tag, counters*> counter_map_type;
+
+  boost::mutex mutex_;
+  counter_map_type counters_; // entries are never removed
+
+public:
+  // Counters for tag, stable for the lifetime of the process
+  counters& get(const memory_tag& tag);
+
+  // Handle to data which counts bytes against tag while it is alive
+  shared_buffer charge(const memory_tag& tag, const shared_buffer& data, size_t bytes);
+  shared_buffer charge(counters& c, const shared_buffer& data, size_t bytes);
+
+  void entries(entry_list_type& list);
+  void dump(std::ostream& os);
+
+  // Process wide accounting. Never destroyed, like buffer_pool::instance().
+  static memory_accounting& instance();
+
+};
+
+// Charges every buffer it hands out to a tag. Wraps another allocator, or
+// the default chain_buffer path if that is null. Chain buffers also charge
+// the chunks they grow by, as size is only a hint for them.
+class accounting_allocator : public buffer_allocator
+{
+protected:
+  memory_accounting::counters& counters_;
+  buffer_allocator * allocator_;
+
+public:
+  accounting_allocator(const memory_tag& tag, buffer_allocator * allocator = 0) :
+    counters_(memory_accounting::instance().get(tag)),
+    allocator_(allocator)
+  {
+  }
+
+  shared_buffer allocate(size_t size, size_t headroom);
+
+  bool exact_size() const
+  {
+    return allocator_ != 0 && allocator_->exact_size();
+  }
+
+};
+
+}
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * STL allocator backed by the darc buffer_pool
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <darc/buffer/buffer_pool.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+/**
+ * Used with boost::allocate_shared so the shared_ptr control block and the
+ * object itself are recycled through the pool as well.
+ */
+template<typename T>
+class pool_allocator
+{
+public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template<typename U>
+  struct rebind
+  {
+    typedef pool_allocator<U> other;
+  };
+
+  buffer_pool * pool_;
+
+public:
+  pool_allocator(buffer_pool& pool = buffer_pool::instance()) :
+    pool_(&pool)
+  {
+  }
+
+  template<typename U>
+  pool_allocator(const pool_allocator<U>& other) :
+    pool_(other.pool_)
+  {
+  }
+
+  pointer allocate(size_type n, const void * = 0)
+  {
+    return static_cast<pointer>(pool_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, size_type n)
+  {
+    pool_->deallocate(p, n * sizeof(T));
+  }
+
+  void construct(pointer p, const T& value)
+  {
+    new(p) T(value);
+  }
+
+  void destroy(pointer p)
+  {
+    p->~T();
+  }
+
+  pointer address(reference r) const
+  {
+    return &r;
+  }
+
+  const_pointer address(const_reference r) const
+  {
+    return &r;
+  }
+
+  size_type max_size() const
+  {
+    return size_type(-1) / sizeof(T);
+  }
+
+  template<typename U>
+  bool operator==(const pool_allocator<U>& other) const
+  {
+    return pool_ == other.pool_;
+  }
+
+  template<typename U>
+  bool operator!=(const pool_allocator<U>& other) const
+  {
+    return pool_ != other.pool_;
+  }
+
+};
+
+}
+}
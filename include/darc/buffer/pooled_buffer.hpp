@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Raw buffer with storage recycled through the buffer_pool
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <boost/ref.hpp>
+#include <boost/make_shared.hpp>
+#include <darc/buffer/raw_buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/buffer_pool.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+class pooled_buffer : public raw_buffer
+{
+protected:
+  buffer_pool& pool_;
+  char * storage_;
+  size_t capacity_;
+
+public:
+  pooled_buffer(buffer_pool& pool, size_t len) :
+    raw_buffer(static_cast<char*>(pool.allocate(len)), len),
+    pool_(pool),
+    storage_(pbase()),
+    capacity_(len)
+  {
+  }
+
+  ~pooled_buffer()
+  {
+    pool_.deallocate(storage_, capacity_);
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+  // The storage goes back to the pool when the last shared_buffer reference
+  // is dropped, also when that happens from zmq_buffer::free_func.
+  static shared_buffer create(size_t len, buffer_pool& pool = buffer_pool::instance())
+  {
+    return boost::allocate_shared<pooled_buffer>(pool_allocator<pooled_buffer>(pool),
+                                                 boost::ref(pool),
+                                                 len);
+  }
+
+};
+
+}
+}
@@ -35,6 +35,9 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstring>
+#include <algorithm>
 #include <darc/buffer/buffer.hpp>
 
 namespace darc
@@ -44,8 +47,12 @@ namespace buffer
 
 class raw_buffer : public std::streambuf, public darc::buffer::buffer
 {
+protected:
+  char * begin_; // start of the memory, data() is later if headroom is reserved
+
 public:
-  raw_buffer(char* begin, size_t buffer_size, size_t data_size = 0)
+  raw_buffer(char* begin, size_t buffer_size, size_t data_size = 0) :
+    begin_(begin)
   {
     setp(begin, begin + buffer_size);
     setg(begin, begin, begin + data_size);
@@ -71,6 +78,77 @@ public:
     return pbase();
   }
 
+  // Data is valid up to whatever has been written, or the initial data_size
+  virtual size_t len()
+  {
+    return std::max(std::streambuf::pptr(), egptr()) - pbase();
+  }
+
+  virtual char * prepare(size_t size)
+  {
+    return (size_t)(epptr() - std::streambuf::pptr()) >= size ? std::streambuf::pptr() : 0;
+  }
+
+  virtual void commit(size_t size)
+  {
+    pbump(size);
+  }
+
+  virtual void consume(size_t size)
+  {
+    if(std::streambuf::gptr() + size > egptr())
+    {
+      underflow();
+    }
+    assert(std::streambuf::gptr() + size <= egptr());
+    gbump(size);
+  }
+
+  // Leave room in front of the data for headers added later with prepend().
+  // Only possible before anything is written.
+  void reserve_headroom(size_t size)
+  {
+    assert(len() == 0);
+    char * begin = pbase() + size;
+    setp(begin, epptr());
+    setg(begin, begin, begin);
+  }
+
+  virtual size_t headroom()
+  {
+    return pbase() - begin_;
+  }
+
+  virtual bool prepend(const char * data, size_t size)
+  {
+    if(size > headroom() || std::streambuf::gptr() != eback())
+    {
+      return false;
+    }
+
+    size_t written = std::streambuf::pptr() - pbase();
+    char * begin = pbase() - size;
+    memcpy(begin, data, size);
+
+    char * data_end = egptr();
+    setp(begin, epptr());
+    pbump(written + size);
+    setg(begin, begin, data_end);
+    return true;
+  }
+
+protected:
+  // Make data written through the put area readable
+  virtual int_type underflow()
+  {
+    if(std::streambuf::pptr() > egptr())
+    {
+      setg(eback(), std::streambuf::gptr(), std::streambuf::pptr());
+      return traits_type::to_int_type(*std::streambuf::gptr());
+    }
+    return traits_type::eof();
+  }
+
 };
 
 }
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Buffer stored in an anonymous shared memory file (memfd)
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <boost/shared_ptr.hpp>
+#include <darc/buffer/raw_buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/shm_exception.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+class shm_buffer;
+typedef boost::shared_ptr<shm_buffer> shared_shm_buffer;
+
+/**
+ * The file descriptor can be passed to another process on the same host,
+ * e.g. over a unix socket, which then maps the same pages with map(). Both
+ * sides see the payload without it being copied. A mapped buffer is a view
+ * of what the other side wrote and should only be read.
+ */
+class shm_buffer : public raw_buffer
+{
+protected:
+  int fd_;
+  char * map_;
+  size_t capacity_;
+
+public:
+  // Takes ownership of fd and of the mapping
+  shm_buffer(int fd, char * map, size_t capacity, size_t data_size);
+  ~shm_buffer();
+
+  // New segment of at least size bytes, throws shm_exception
+  static shared_shm_buffer create(size_t size);
+
+  // Map a segment received from another process. fd is duplicated, so the
+  // caller still owns (and should close) its descriptor.
+  static shared_shm_buffer map(int fd, size_t data_size);
+
+  int fd() const
+  {
+    return fd_;
+  }
+
+  size_t capacity() const
+  {
+    return capacity_;
+  }
+
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Read-only view into the memory of another buffer
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <boost/make_shared.hpp>
+#include <darc/buffer/buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+/**
+ * A slice keeps its parent alive and has its own read position, so several
+ * layers or threads can read the same received frame without copying it and
+ * without moving each other's cursor.
+ */
+class slice_buffer : public std::streambuf, public darc::buffer::buffer
+{
+protected:
+  shared_buffer parent_;
+  char * begin_;
+  size_t len_;
+
+public:
+  slice_buffer(const shared_buffer& parent, const char * begin, size_t len) :
+    parent_(parent),
+    begin_(const_cast<char*>(begin)),
+    len_(len)
+  {
+    setp(0, 0);
+    setg(begin_, begin_, begin_ + len_);
+  }
+
+  static shared_buffer create(const shared_buffer& parent, size_t offset, size_t len)
+  {
+    return boost::allocate_shared<slice_buffer>(pool_allocator<slice_buffer>(),
+                                                parent,
+                                                parent->data() + offset,
+                                                len);
+  }
+
+  // View of what has not been read from parent yet
+  static shared_buffer unread(const shared_buffer& parent)
+  {
+    segment_list_type segments;
+    parent->unread_segments(segments);
+
+    if(segments.size() == 1)
+    {
+      return boost::allocate_shared<slice_buffer>(pool_allocator<slice_buffer>(),
+                                                  parent,
+                                                  boost::asio::buffer_cast<const char*>(segments[0]),
+                                                  boost::asio::buffer_size(segments[0]));
+    }
+
+    shared_chain_buffer chain = chain_buffer::create();
+    for(segment_list_type::iterator it = segments.begin();
+        it != segments.end();
+        it++)
+    {
+      chain->append(boost::allocate_shared<slice_buffer>(pool_allocator<slice_buffer>(),
+                                                         parent,
+                                                         boost::asio::buffer_cast<const char*>(*it),
+                                                         boost::asio::buffer_size(*it)));
+    }
+    return chain;
+  }
+
+  const shared_buffer& parent()
+  {
+    return parent_;
+  }
+
+  virtual std::streambuf * streambuf()
+  {
+    return this;
+  }
+
+  virtual char * gptr()
+  {
+    return std::streambuf::gptr();
+  }
+
+  // Slices can not be written
+  virtual char * pptr()
+  {
+    return 0;
+  }
+
+  virtual char * data()
+  {
+    return begin_;
+  }
+
+  virtual size_t len()
+  {
+    return len_;
+  }
+
+};
+
+}
+}
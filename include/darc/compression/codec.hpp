@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Block compression codecs for message payloads
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace darc
+{
+namespace compression
+{
+
+class codec
+{
+public:
+  // Wire values, never reorder
+  enum type
+  {
+    none = 0,
+    lz = 1,
+    zlib = 2
+  };
+
+  virtual ~codec()
+  {
+  }
+
+  virtual type id() const = 0;
+
+  // Largest compressed size of len bytes
+  virtual size_t bound(size_t len) const = 0;
+
+  // dst must hold bound(len) bytes. Returns the compressed length.
+  virtual size_t compress(const char * src, size_t len, char * dst) const = 0;
+
+  // False if src is corrupt or does not expand to exactly dst_len bytes
+  virtual bool decompress(const char * src, size_t len, char * dst, size_t dst_len) const = 0;
+
+  // The codec for a wire value, 0 for none and unknown values
+  static const codec * get(uint16_t id);
+};
+
+}
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Optional compression of serialized messages, configured per topic
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/compression/codec.hpp>
+
+namespace darc
+{
+namespace compression
+{
+
+struct compression_config
+{
+  codec::type codec_id;
+  // Messages smaller than this are sent as they are
+  size_t threshold;
+  // Stop compressing for backoff messages when the ratio drops below min_ratio
+  bool adaptive;
+  double min_ratio;
+  size_t backoff;
+
+  compression_config(codec::type codec_id = codec::none,
+                     size_t threshold = 256,
+                     bool adaptive = true,
+                     double min_ratio = 1.2,
+                     size_t backoff = 32) :
+    codec_id(codec_id),
+    threshold(threshold),
+    adaptive(adaptive),
+    min_ratio(min_ratio),
+    backoff(backoff)
+  {
+  }
+};
+
+struct compression_stats
+{
+  uint64_t messages;
+  uint64_t compressed;
+  uint64_t below_threshold;
+  uint64_t poor_ratio; // compressed, but sent as they were
+  uint64_t backed_off; // not tried while backing off
+  uint64_t bytes_in; // original size of the compressed messages
+  uint64_t bytes_out;
+
+  compression_stats() :
+    messages(0),
+    compressed(0),
+    below_threshold(0),
+    poor_ratio(0),
+    backed_off(0),
+    bytes_in(0),
+    bytes_out(0)
+  {
+  }
+};
+
+class compression_stage
+{
+protected:
+  boost::mutex mutex_;
+  compression_config config_;
+  compression_stats stats_;
+  size_t backoff_left_;
+
+public:
+  // Largest message decompress() will expand to
+  static const size_t max_original_size = 1 << 30;
+
+  compression_stage(const compression_config& config = compression_config());
+
+  void configure(const compression_config& config);
+  compression_config config();
+  compression_stats stats();
+
+  /**
+   * Packs msg when it is worth compressing. Returns true with the
+   * compression header and compressed bytes in out, or false with out
+   * either empty or holding the packed, uncompressed message.
+   */
+  bool compress(const outbound_data_base& msg, darc::buffer::shared_buffer& out);
+
+  // Expands a payload produced by compress(). Empty if it is corrupt.
+  static darc::buffer::shared_buffer decompress(darc::buffer::shared_buffer data);
+};
+
+}
+}
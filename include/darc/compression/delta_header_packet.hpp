@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2012, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * In front of a delta encoded message payload
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <darc/serializer/raw.hpp>
+
+namespace darc
+{
+namespace compression
+{
+
+struct delta_header_packet
+{
+  // The payload is the whole message, not a delta against the previous
+  static const uint16_t keyframe = 0x1;
+
+  uint16_t flags;
+  uint16_t reserved; // 0
+  uint32_t sequence;
+  uint32_t size; // of the reconstructed message
+
+  delta_header_packet() :
+    flags(0),
+    reserved(0),
+    sequence(0),
+    size(0)
+  {
+  }
+
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & flags;
+    ar & reserved;
+    ar & sequence;
+    ar & size;
+  }
+
+};
+
+}
+}
+
+DARC_RAW_LAYOUT(darc::compression::delta_header_packet, 12)
@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Delta encoding of a message stream against the previous message, for
+ * periodic topics where little changes between messages. The delta is
+ * the XOR of the two serialized messages, run length encoded as pairs of
+ * (unchanged bytes, changed bytes) varints followed by the changed bytes.
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <boost/thread/mutex.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/network/outbound_data.hpp>
+
+namespace darc
+{
+namespace compression
+{
+
+// XOR/RLE delta of cur against prev, both len bytes, appended to out
+void delta_encode(const char * prev, const char * cur, size_t len, std::vector<char>& out);
+
+// Applies a delta to data in place. False if the delta is corrupt.
+bool delta_apply(const char * delta, size_t delta_len, char * data, size_t len);
+
+struct delta_config
+{
+  // A whole message is sent at least this often
+  size_t keyframe_interval;
+
+  delta_config(size_t keyframe_interval = 100) :
+    keyframe_interval(keyframe_interval)
+  {
+  }
+};
+
+struct delta_stats
+{
+  uint64_t messages;
+  uint64_t keyframes;
+  uint64_t keyframe_requests;
+  uint64_t bytes_in; // serialized size of all messages
+  uint64_t bytes_out; // sent, without the delta header
+
+  delta_stats() :
+    messages(0),
+    keyframes(0),
+    keyframe_requests(0),
+    bytes_in(0),
+    bytes_out(0)
+  {
+  }
+};
+
+/**
+ * Publisher side, one per topic. Keyframes are sent for the first
+ * message, every keyframe_interval messages, when the size changes, when
+ * the delta would not be smaller and after request_keyframe().
+ */
+class delta_encoder
+{
+protected:
+  boost::mutex mutex_;
+  delta_config config_;
+  delta_stats stats_;
+  std::vector<char> last_;
+  uint32_t sequence_;
+  size_t since_keyframe_;
+  bool keyframe_requested_;
+
+public:
+  delta_encoder(const delta_config& config = delta_config());
+
+  void configure(const delta_config& config);
+  delta_stats stats();
+
+  // A receiver lost track of the stream
+  void request_keyframe();
+
+  // Packs msg and returns the delta header followed by the message or
+  // the delta
+  darc::buffer::shared_buffer encode(const outbound_data_base& msg);
+};
+
+/**
+ * Receiver side, one per remote publisher and topic
+ */
+class delta_decoder
+{
+protected:
+  std::vector<char> last_;
+  uint32_t sequence_;
+  bool valid_;
+  bool keyframe_requested_;
+
+public:
+  delta_decoder();
+
+  /**
+   * Reconstructs the message from a payload produced by
+   * delta_encoder::encode(). Empty if it can not be applied, in which
+   * case request_keyframe tells if a keyframe should be asked for. It is
+   * only set once until a keyframe arrives.
+   */
+  darc::buffer::shared_buffer decode(darc::buffer::shared_buffer data, bool& request_keyframe);
+};
+
+}
+}
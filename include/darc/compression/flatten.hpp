@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <vector>
+#include <darc/buffer/buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+
+namespace darc
+{
+namespace compression
+{
+
+// Points begin at the unread data, copying it into storage if it is in
+// several pieces. Returns the length.
+inline size_t flatten(darc::buffer::shared_buffer& data, std::vector<char>& storage, const char *& begin)
+{
+  darc::buffer::buffer::segment_list_type segments;
+  data->unread_segments(segments);
+  if(segments.size() == 1)
+  {
+    begin = boost::asio::buffer_cast<const char*>(segments.front());
+    return boost::asio::buffer_size(segments.front());
+  }
+
+  for(darc::buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    const char * p = boost::asio::buffer_cast<const char*>(*it);
+    storage.insert(storage.end(), p, p + boost::asio::buffer_size(*it));
+  }
+  begin = storage.empty() ? 0 : &storage[0];
+  return storage.size();
+}
+
+}
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * One TCP connection of the asio+tcp transport
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <boost/utility.hpp>
+#include <boost/asio.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <darc/id.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <iris/static_scope.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace asio_tcp
+{
+
+class asio_protocol_manager;
+
+// Handlers may run on the io_service after the manager is destroyed. They
+// reach it only through this, under a shared lock, and the manager clears
+// it when it goes away.
+struct asio_manager_ref
+{
+  boost::shared_mutex mutex;
+  asio_protocol_manager * manager;
+
+  asio_manager_ref(asio_protocol_manager * m) :
+    manager(m)
+  {
+  }
+};
+
+typedef boost::shared_ptr<asio_manager_ref> shared_asio_manager_ref;
+
+struct asio_socket_options
+{
+  bool no_delay;
+  int send_buffer_size;    // 0 leaves the system default
+  int receive_buffer_size;
+
+  asio_socket_options() :
+    no_delay(true),
+    send_buffer_size(0),
+    receive_buffer_size(0)
+  {
+  }
+};
+
+/**
+ * Frames are sent with a 4 byte length in front. Frames queued while a write
+ * is in progress go out together in the next one, lengths and all segments
+ * of the frames gathered into a single writev.
+ *
+ * Reads go into pooled chunks, and each frame which arrived in full is
+ * handed on as a slice of its chunk. Frames larger than a chunk are read
+ * directly into a pooled buffer of their own.
+ *
+ * The other side's peer id is exchanged first, so it can be disconnected
+ * when the connection goes away.
+ */
+class asio_connection : public boost::enable_shared_from_this<asio_connection>,
+                        public iris::static_scope<iris::Info>,
+                        public boost::noncopyable
+{
+public:
+  static const size_t read_chunk_size = 64 * 1024;
+  static const size_t min_read_size = 4096; // less room left in a chunk is not read into
+  static const size_t max_frame_size = 256 * 1024 * 1024;
+  static const size_t max_write_frames = 64; // gathered into one write
+  static const size_t max_queued_frames = 10000; // more are dropped
+
+protected:
+  shared_asio_manager_ref manager_;
+  ID outbound_id_;
+  ID remote_peer_id_;
+  boost::asio::ip::tcp::socket socket_;
+  asio_socket_options options_;
+
+  // The endpoint connected to, for connections which are to be remade
+  bool reconnect_;
+  boost::asio::ip::tcp::endpoint endpoint_;
+
+  boost::mutex mutex_; // socket_ and the write state
+  bool closed_;
+  bool writing_;
+  std::deque<buffer::shared_buffer> write_queue_;
+  std::vector<buffer::shared_buffer> write_frames_; // kept until written
+  std::vector<char> write_headers_;
+  std::vector<boost::asio::const_buffer> write_buffers_;
+  std::vector<char> hello_; // written before the first frame
+  uint64_t dropped_;
+
+  // Only used by the read handlers
+  bool hello_received_;
+  buffer::shared_buffer chunk_;
+  size_t chunk_begin_; // first byte not handed on
+  size_t chunk_end_;
+  buffer::shared_buffer frame_; // larger than a chunk
+  size_t frame_size_;
+
+public:
+  asio_connection(shared_asio_manager_ref manager,
+                  boost::asio::io_service& io_service,
+                  const ID& local_peer_id,
+                  const asio_socket_options& options);
+
+  boost::asio::ip::tcp::socket& socket()
+  {
+    return socket_;
+  }
+
+  // Remade after endpoint, by the manager, when lost
+  void set_reconnect(const boost::asio::ip::tcp::endpoint& endpoint)
+  {
+    reconnect_ = true;
+    endpoint_ = endpoint;
+  }
+
+  bool reconnect() const
+  {
+    return reconnect_;
+  }
+
+  const boost::asio::ip::tcp::endpoint& endpoint() const
+  {
+    return endpoint_;
+  }
+
+  const asio_socket_options& options() const
+  {
+    return options_;
+  }
+
+  const ID& outbound_id() const
+  {
+    return outbound_id_;
+  }
+
+  // Null until the other side said hello
+  const ID& remote_peer_id() const
+  {
+    return remote_peer_id_;
+  }
+
+  // Apply the socket options, the socket must be open
+  void configure();
+
+  // Once connected, called with the manager ref held
+  void start();
+
+  // Frames with their link header. False if dropped.
+  bool send(buffer::shared_buffer data);
+
+  // No more handlers reach the manager after this
+  void close();
+
+  // Frames dropped because too many were queued
+  uint64_t dropped();
+
+protected:
+  void read();
+  void handle_read(const boost::system::error_code& error, size_t size);
+  void handle_frame_read(const boost::system::error_code& error, size_t size);
+  bool parse();
+
+  // Called with mutex_ held
+  void write();
+  void handle_write(const boost::system::error_code& error, size_t size);
+
+  // Closes and tells the manager, once. Called with the manager ref held.
+  void failed(const boost::system::error_code& error);
+
+};
+
+typedef boost::shared_ptr<asio_connection> shared_asio_connection;
+
+}
+}
+}
@@ -0,0 +1,140 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * DARC asio TCP ProtocolManager class
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <set>
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+#include <darc/peer/peer.hpp>
+#include <darc/network/protocol_manager_base.hpp>
+#include <darc/network/inbound_link_base.hpp>
+#include <darc/network/asio/asio_connection.hpp>
+
+namespace darc
+{
+namespace network
+{
+
+class network_manager; // fwd
+
+namespace asio_tcp
+{
+
+/**
+ * "asio+tcp://host:port" on the io_service given to the network_manager,
+ * without any threads of its own. Frames are received and handed on by
+ * whichever thread runs the io_service, so several threads give parallel
+ * connections. connect() keeps trying, also after the other side went away.
+ *
+ * "?nodelay=0" enables Nagle's algorithm, "?sndbuf=bytes&rcvbuf=bytes" set
+ * the socket buffer sizes.
+ */
+class asio_protocol_manager : public protocol_manager_base, public inbound_link_base
+{
+public:
+  static const int reconnect_interval_ms = 100;
+
+private:
+  peer& peer_;
+  boost::asio::io_service& io_service_;
+  shared_asio_manager_ref ref_;
+
+  boost::mutex mutex_;
+
+  typedef std::map</*outbound*/ID, shared_asio_connection> connection_list_type;
+  connection_list_type connection_list_;
+
+  typedef std::set<shared_asio_connection> pending_list_type; // being connected
+  pending_list_type pending_list_;
+
+  typedef boost::shared_ptr<boost::asio::ip::tcp::acceptor> shared_acceptor;
+  typedef std::list<shared_acceptor> acceptor_list_type;
+  acceptor_list_type acceptor_list_;
+
+  typedef boost::shared_ptr<boost::asio::deadline_timer> shared_timer;
+  typedef std::set<shared_timer> timer_list_type;
+  timer_list_type timer_list_;
+
+public:
+  asio_protocol_manager(class network_manager * manager, peer& p, boost::asio::io_service& io_service);
+  ~asio_protocol_manager();
+
+  void send_frame(const darc::ID& outbound_id,
+                  const ID& topic_peer_id,
+                  buffer::shared_buffer data);
+
+  void send_frame_to_all(const ID& topic_peer_id,
+                         buffer::shared_buffer data);
+
+  void accept(const std::string& protocol, const std::string& url);
+  void connect(const std::string& protocol, const std::string& url);
+
+  const darc::ID& peer_id()
+  {
+    return peer_.id();
+  }
+
+  // From the connection's handler
+  void connection_closed(shared_asio_connection connection);
+
+protected:
+  void start_accept(shared_acceptor acceptor, const asio_socket_options& options);
+  void start_connect(const boost::asio::ip::tcp::endpoint& endpoint, const asio_socket_options& options);
+  void start_reconnect(const boost::asio::ip::tcp::endpoint& endpoint, const asio_socket_options& options);
+  void connection_started(shared_asio_connection connection);
+
+  // Handlers, which only reach the manager while it exists
+  static void handle_accept(shared_asio_manager_ref ref,
+                            shared_acceptor acceptor,
+                            shared_asio_connection connection,
+                            const boost::system::error_code& error);
+  static void handle_connect(shared_asio_manager_ref ref,
+                             shared_asio_connection connection,
+                             const boost::system::error_code& error);
+  static void handle_reconnect(shared_asio_manager_ref ref,
+                               shared_timer timer,
+                               boost::asio::ip::tcp::endpoint endpoint,
+                               asio_socket_options options,
+                               const boost::system::error_code& error);
+
+};
+
+} // namespace asio_tcp
+} // namespace network
+} // namespace darc
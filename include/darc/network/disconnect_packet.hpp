@@ -36,6 +36,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -56,3 +57,5 @@ struct disconnect_packet
 
 }
 }
+
+DARC_RAW_LAYOUT(darc::network::disconnect_packet, 16)
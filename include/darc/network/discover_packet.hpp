@@ -36,6 +36,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -44,15 +45,27 @@ namespace network
 
 struct discover_packet
 {
+  // Capabilities of the sending peer
+  const static uint32_t DATA_HEADER = 0x1;
+
   ID outbound_id;
+  uint32_t capabilities;
+
+  discover_packet() :
+    capabilities(0)
+  {
+  }
 
   template<class Archive>
   void serialize(Archive & ar, const unsigned int version)
   {
     ar & outbound_id;
+    ar & capabilities;
   }
 
 };
 
 }
 }
+
+DARC_RAW_LAYOUT(darc::network::discover_packet, 20)
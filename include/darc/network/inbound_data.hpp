@@ -38,6 +38,9 @@
 #include <darc/buffer/shared_buffer.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <iris/glog.hpp>
 
 
 namespace darc
@@ -82,4 +85,72 @@ public:
 
 };
 
+/**
+ * Holds the received frame and deserializes it the first time get() is
+ * called, from whichever thread gets there first. Later calls share the
+ * decoded value, and the frame is released once decoded.
+ *
+ * A frame that fails to decode is logged and get() returns an empty
+ * pointer, so a corrupt frame never throws into a subscriber callback or
+ * the transport thread. verified tells whether the sender advertised a
+ * matching type fingerprint, i.e. whether a failure is a corrupt frame or
+ * a type mismatch.
+ */
+template<typename S, typename T>
+class lazy_inbound_data
+{
+protected:
+  buffer::shared_buffer buffer_;
+  boost::shared_ptr<const T> value_;
+  boost::atomic<bool> decoded_;
+  boost::mutex mutex_;
+  bool verified_;
+
+  void decode()
+  {
+    boost::shared_ptr<T> value = boost::make_shared<T>();
+    S::unpack(buffer_, *value);
+    value_ = value;
+  }
+
+public:
+  lazy_inbound_data(buffer::shared_buffer buffer, bool verified = true) :
+    buffer_(buffer),
+    decoded_(false),
+    verified_(verified)
+  {
+  }
+
+  bool decoded() const
+  {
+    return decoded_.load(boost::memory_order_acquire);
+  }
+
+  const boost::shared_ptr<const T>& get()
+  {
+    if(!decoded_.load(boost::memory_order_acquire))
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      if(!decoded_.load(boost::memory_order_relaxed))
+      {
+        try
+        {
+          decode();
+        }
+        catch(std::exception& e)
+        {
+          iris::glog<iris::Warning>(verified_ ?
+                                    "lazy_inbound_data: dropping corrupt message" :
+                                    "lazy_inbound_data: dropping message that failed to decode, type mismatch?",
+                                    "what", iris::arg<std::string>(e.what()));
+        }
+        buffer_.reset();
+        decoded_.store(true, boost::memory_order_release);
+      }
+    }
+    return value_;
+  }
+
+};
+
 }
@@ -44,7 +44,8 @@
 #include <darc/network/outbound_data.hpp>
 #include <darc/network/inbound_data.hpp>
 #include <darc/serializer/boost.hpp>
-#include <darc/buffer/const_size_buffer.hpp>
+#include <darc/serializer/raw.hpp>
+#include <darc/buffer/chain_buffer.hpp>
 #include <darc/id_arg.hpp>
 #include <iris/static_scope.hpp>
 
@@ -73,42 +74,55 @@ protected:
   }
 
 public:
-  virtual void send_packet(const ID& outbound_id,
-                          const ID& dest_peer_id,
-                          const uint16_t packet_type,
+  // Send data with the link header already prepended
+  virtual void send_frame(const ID& outbound_id,
+                          const ID& topic_peer_id,
                           buffer::shared_buffer data) = 0;
 
-  virtual void send_packet_to_all(const ID& dest_peer_id,
+  virtual void send_frame_to_all(const ID& topic_peer_id,
+                                 buffer::shared_buffer data) = 0;
+
+  void send_packet(const ID& outbound_id,
+                   const ID& dest_peer_id,
+                   const uint16_t packet_type,
+                   buffer::shared_buffer data);
+
+  // The header is written once and shared by all connections
+  void send_packet_to_all(const ID& dest_peer_id,
+                          const uint16_t packet_type,
+                          buffer::shared_buffer data);
+
+  // With checksum, a CRC-32C over the header and data is added after the
+  // header
+  static void prepend_link_header(const ID& src_peer_id,
+                                  const ID& dest_peer_id,
                                   const uint16_t packet_type,
-                                  buffer::shared_buffer data) = 0;
+                                  buffer::shared_buffer& data,
+                                  bool checksum = false);
+
+  // False if the frame has a checksum that does not match. Consumes the
+  // checksum and clears the CHECKSUM flag in header.
+  static bool verify_link_checksum(link_header_packet& header,
+                                   buffer::shared_buffer& data);
 
   class network_manager* network_manager()
   {
     return manager_;
   }
 
-  void packet_received(buffer::shared_buffer header_data,
-                       buffer::shared_buffer body_data);
+  // Frames too short for their headers are logged and dropped
+  void packet_received(buffer::shared_buffer data);
 
-  void handle_discover_packet(const ID& src_peer_id, buffer::shared_buffer& data)
-  {
-    inbound_data<darc::serializer::boost_serializer, discover_packet> dp_i(data);
+  void dispatch_packet(buffer::shared_buffer& data);
 
-    slog<iris::Debug>("Received DISCOVER",
-                      "peer_id", iris::arg<ID>(src_peer_id),
-                      "remote outbound_id", iris::arg<ID>(dp_i.get().outbound_id));
-
-    discover_reply_packet drp;
-    drp.outbound_id = dp_i.get().outbound_id;
-    outbound_data<darc::serializer::boost_serializer, discover_reply_packet> o_drp(drp);
-
-    buffer::shared_buffer buffer = boost::make_shared<buffer::const_size_buffer>(1024); // todo
-
-    o_drp.pack(buffer);
-
-    send_packet_to_all(src_peer_id, link_header_packet::DISCOVER_REPLY, buffer);
+  // Capabilities announced to neighbours in DISCOVER and DISCOVER_REPLY
+  static uint32_t local_capabilities()
+  {
+    return discover_packet::DATA_HEADER;
   }
 
+  void handle_discover_packet(const ID& src_peer_id, buffer::shared_buffer& data);
+
   void handle_discover_reply_packet(const ID& src_peer_id, buffer::shared_buffer& data);
 
   void sendDiscover(const ID& outbound_id)
@@ -118,9 +132,10 @@ public:
 
     discover_packet dp;
     dp.outbound_id = outbound_id;
-    outbound_data<darc::serializer::boost_serializer, discover_packet> o_dp(dp);
+    dp.capabilities = local_capabilities();
+    outbound_data<darc::serializer::raw_serializer, discover_packet> o_dp(dp);
 
-    buffer::shared_buffer buffer = boost::make_shared<buffer::const_size_buffer>(1024); // todo
+    buffer::shared_buffer buffer = buffer::chain_buffer::create(o_dp.serialized_size());
 
     o_dp.pack(buffer);
 
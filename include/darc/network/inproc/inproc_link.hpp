@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Lock-free queue of frames to a peer in the same process
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/lockfree/queue.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+
+namespace darc
+{
+namespace network
+{
+
+class inbound_link_base;
+
+namespace inproc
+{
+
+/**
+ * Frames are queued by reference, from any number of threads, and handed to
+ * the receiver's packet_received() on the link's own thread. The receiver
+ * reads a slice_buffer view of the sender's buffer, so a frame sent to
+ * several peers is shared by all of them and never copied.
+ */
+class inproc_link : public boost::noncopyable
+{
+public:
+  static const size_t initial_capacity = 1024; // preallocated queue nodes
+
+protected:
+  inbound_link_base * receiver_;
+  boost::lockfree::queue<buffer::shared_buffer*> queue_;
+
+  boost::atomic<bool> stop_;
+  boost::atomic<bool> waiting_; // receiver thread is about to sleep
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  boost::thread thread_;
+
+public:
+  inproc_link(inbound_link_base * receiver);
+  ~inproc_link();
+
+  void send(buffer::shared_buffer data);
+
+  // Frames still queued are dropped. Not to be called from the link's own
+  // thread.
+  void stop();
+
+protected:
+  void work();
+
+};
+
+typedef boost::shared_ptr<inproc_link> shared_inproc_link;
+
+}
+}
+}
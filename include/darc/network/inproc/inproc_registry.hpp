@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Names of in-process listeners and the connections between them
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <string>
+#include <boost/utility.hpp>
+#include <boost/thread/mutex.hpp>
+#include <darc/id.hpp>
+#include <darc/network/inproc/inproc_link.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace inproc
+{
+
+class inproc_protocol_manager;
+
+/**
+ * A connect to a name nobody has accepted on yet waits for it, and a
+ * connection whose accepting side goes away is made again when the name is
+ * accepted on again, like zmq connects do. All changes to connections are
+ * made with the registry mutex held; sending only takes the managers' own
+ * locks.
+ */
+class inproc_registry : public boost::noncopyable
+{
+protected:
+  struct connection
+  {
+    std::string name;
+    inproc_protocol_manager * acceptor;
+    inproc_protocol_manager * connector;
+    ID acceptor_outbound_id;
+    ID connector_outbound_id;
+    shared_inproc_link to_acceptor;
+    shared_inproc_link to_connector;
+  };
+
+  typedef std::map<std::string, inproc_protocol_manager*> bound_list_type;
+  typedef std::multimap<std::string, inproc_protocol_manager*> pending_list_type;
+  typedef std::list<connection> connection_list_type;
+
+  boost::mutex mutex_;
+  bound_list_type bound_list_;
+  pending_list_type pending_list_;
+  connection_list_type connection_list_;
+
+public:
+  // Throws address_in_use_exception if name is taken
+  void bind(const std::string& name, inproc_protocol_manager * acceptor);
+  void connect(const std::string& name, inproc_protocol_manager * connector);
+
+  // Closes all connections of manager, the other sides see a disconnect
+  void remove(inproc_protocol_manager * manager);
+
+  // Process wide registry. Never destroyed, like buffer_pool::instance().
+  static inproc_registry& instance();
+
+protected:
+  // Called with mutex_ held
+  void establish(const std::string& name,
+                 inproc_protocol_manager * acceptor,
+                 inproc_protocol_manager * connector);
+
+};
+
+}
+}
+}
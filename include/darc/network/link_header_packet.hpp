@@ -36,6 +36,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -47,6 +48,10 @@ struct link_header_packet
   const static uint16_t DISCONNECT = 2;
   const static uint16_t HEARTBEAT = 3;
   const static uint16_t SERVICE = 10;
+  const static uint16_t DATA = 11; // followed by a data_header_packet
+
+  // Flag in packet_type: a link_checksum_packet follows the header
+  const static uint16_t CHECKSUM = 0x8000;
 
   ID dest_peer_id;
   ID src_peer_id;
@@ -62,4 +67,20 @@ struct link_header_packet
 
 };
 
+// CRC-32C of the link header and everything after the checksum
+struct link_checksum_packet
+{
+  uint32_t crc;
+
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & crc;
+  }
+
+};
+
 }
+
+DARC_RAW_LAYOUT(darc::link_header_packet, 34)
+DARC_RAW_LAYOUT(darc::link_checksum_packet, 4)
@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Header of each datagram sent to a multicast group
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace multicast
+{
+
+// A frame is split over fragment_count datagrams, all with the same
+// sequence. Senders number their frames per group, so receivers can tell
+// which frames they missed.
+struct multicast_fragment_packet
+{
+  ID src_peer_id;
+  uint32_t sequence;
+  uint16_t fragment;
+  uint16_t fragment_count;
+
+  multicast_fragment_packet() :
+    sequence(0),
+    fragment(0),
+    fragment_count(0)
+  {
+  }
+
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & src_peer_id;
+    ar & sequence;
+    ar & fragment;
+    ar & fragment_count;
+  }
+
+};
+
+}
+}
+}
+
+DARC_RAW_LAYOUT(darc::network::multicast::multicast_fragment_packet, 24)
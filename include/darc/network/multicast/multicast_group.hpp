@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Membership of one UDP multicast group
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <map>
+#include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/asio.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <darc/id.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/network/multicast/multicast_fragment_packet.hpp>
+#include <iris/static_scope.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace multicast
+{
+
+class multicast_protocol_manager;
+
+/**
+ * Each frame is sent once to the group, however many peers have joined it,
+ * split into datagrams which fit the MTU. Receivers put the fragments of a
+ * frame back together as they arrive, in order. A frame with a missing
+ * fragment is dropped, and the sequence numbers tell the receiver how many
+ * frames it lost.
+ *
+ * The group is also how peers find each other: DISCOVER is sent to it
+ * periodically and whenever a new sender is heard, and peers which have not
+ * been heard for peer_timeout_ms are disconnected.
+ */
+class multicast_group : public iris::static_scope<iris::Info>, public boost::noncopyable
+{
+public:
+  static const size_t default_mtu = 1500;
+  static const int default_ttl = 1; // stay on the local network
+  static const size_t max_frame_size = 64 * 1024 * 1024;
+  static const int socket_buffer_size = 4 * 1024 * 1024; // requested, the kernel may cap it
+  static const int discover_interval_ms = 1000;
+  static const int peer_timeout_ms = 5000;
+  static const int poll_interval_ms = 100; // how quickly stop() is noticed
+
+  struct statistics
+  {
+    uint64_t sent_frames;
+    uint64_t sent_datagrams;
+    uint64_t received_frames;
+    uint64_t lost_frames;    // frames missing in the sequence, or incomplete
+    uint64_t dropped_frames; // frames too large to send, or which failed to
+
+    statistics() :
+      sent_frames(0),
+      sent_datagrams(0),
+      received_frames(0),
+      lost_frames(0),
+      dropped_frames(0)
+    {
+    }
+  };
+
+protected:
+  // Receive state of each peer sending to the group
+  struct sender_state
+  {
+    boost::posix_time::ptime last_seen;
+    bool synchronized; // next_sequence is known
+    uint32_t next_sequence;
+
+    // Frame being put together
+    buffer::shared_buffer frame;
+    uint32_t sequence;
+    uint16_t next_fragment;
+    uint16_t fragment_count;
+    size_t fragment_size;
+
+    sender_state() :
+      synchronized(false),
+      next_sequence(0),
+      sequence(0),
+      next_fragment(0),
+      fragment_count(0),
+      fragment_size(0)
+    {
+    }
+  };
+
+  multicast_protocol_manager * parent_;
+  ID outbound_id_;
+  boost::asio::ip::udp::endpoint endpoint_;
+  size_t max_payload_; // frame bytes per datagram
+
+  boost::asio::io_service io_service_; // sockets are used synchronously
+  boost::asio::ip::udp::socket rx_socket_; // non-blocking, polled
+  boost::asio::ip::udp::socket tx_socket_;
+
+  boost::mutex send_mutex_;
+  uint32_t sequence_;
+
+  typedef std::map</*peer*/ID, sender_state> sender_list_type;
+  sender_list_type sender_list_;
+  std::vector<char> datagram_;
+
+  boost::atomic<bool> stop_;
+  boost::atomic<uint64_t> sent_frames_;
+  boost::atomic<uint64_t> sent_datagrams_;
+  boost::atomic<uint64_t> received_frames_;
+  boost::atomic<uint64_t> lost_frames_;
+  boost::atomic<uint64_t> dropped_frames_;
+
+public:
+  // Joins the group on interface, or the default one if unspecified.
+  // Throws boost::system::system_error if that fails.
+  multicast_group(multicast_protocol_manager * parent,
+                  const boost::asio::ip::udp::endpoint& endpoint,
+                  const boost::asio::ip::address& interface,
+                  size_t mtu,
+                  int ttl);
+
+  // Frames with their link header. False if dropped.
+  bool send(buffer::shared_buffer data);
+
+  // Receive until stop()
+  void run();
+  void stop();
+
+  const ID& outbound_id() const
+  {
+    return outbound_id_;
+  }
+
+  const boost::asio::ip::udp::endpoint& endpoint() const
+  {
+    return endpoint_;
+  }
+
+  statistics stats() const;
+
+protected:
+  void receive(size_t size, const boost::posix_time::ptime& now);
+  void fragment_received(sender_state& sender,
+                         const multicast_fragment_packet& header,
+                         const char * payload,
+                         size_t size);
+  void frames_lost(const ID& src_peer_id, uint32_t sequence, uint32_t count);
+
+  // Forget peers not heard from in peer_timeout_ms
+  void expire(const boost::posix_time::ptime& now);
+
+};
+
+typedef boost::shared_ptr<multicast_group> shared_multicast_group;
+
+}
+}
+}
@@ -0,0 +1,108 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * DARC UDP multicast ProtocolManager class
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <map>
+#include <list>
+#include <boost/thread.hpp>
+#include <darc/peer/peer.hpp>
+#include <darc/network/protocol_manager_base.hpp>
+#include <darc/network/inbound_link_base.hpp>
+#include <darc/network/multicast/multicast_group.hpp>
+
+namespace darc
+{
+namespace network
+{
+
+class network_manager; // fwd
+
+namespace multicast
+{
+
+/**
+ * "udp+multicast://group:port" for one-to-many traffic, e.g.
+ * "udp+multicast://239.255.0.1:5600". accept() and connect() both join the
+ * group, optionally with "?interface=address&mtu=bytes&ttl=hops", and each
+ * group becomes a connection to every peer found on it. Broadcasts are sent
+ * to the group once, whatever the number of peers, see
+ * network_manager::register_connection.
+ */
+class multicast_protocol_manager : public protocol_manager_base, public inbound_link_base
+{
+private:
+  peer& peer_;
+
+  boost::mutex mutex_;
+  bool stopping_;
+
+  typedef std::map</*outbound*/ID, shared_multicast_group> group_list_type;
+  group_list_type group_list_;
+
+  typedef std::list<boost::shared_ptr<boost::thread> > thread_list_type;
+  thread_list_type thread_list_;
+
+public:
+  multicast_protocol_manager(class network_manager * manager, peer& p);
+  ~multicast_protocol_manager();
+
+  void send_frame(const darc::ID& outbound_id,
+                  const ID& topic_peer_id,
+                  buffer::shared_buffer data);
+
+  void send_frame_to_all(const ID& topic_peer_id,
+                         buffer::shared_buffer data);
+
+  void accept(const std::string& protocol, const std::string& url);
+  void connect(const std::string& protocol, const std::string& url);
+
+  const darc::ID& peer_id()
+  {
+    return peer_.id();
+  }
+
+  // Sum over all groups
+  multicast_group::statistics stats();
+
+protected:
+  void group_work(shared_multicast_group group);
+
+};
+
+} // namespace multicast
+} // namespace network
+} // namespace darc
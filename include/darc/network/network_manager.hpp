@@ -35,14 +35,18 @@
 
 #pragma once
 
+#include <set>
 #include <boost/regex.hpp>
 #include <boost/asio.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
 #include <darc/peer/peer.hpp>
 #include <darc/id.hpp>
 #include <darc/serializer/boost.hpp>
 #include <darc/network/inbound_data.hpp>
 #include <darc/network/protocol_manager_base.hpp>
 #include <darc/network/link_header_packet.hpp>
+#include <darc/network/data_header_packet.hpp>
 #include <iris/glog.hpp>
 #include <darc/id_arg.hpp>
 
@@ -60,30 +64,81 @@ private:
   typedef std::map<const std::string, boost::shared_ptr<protocol_manager_base> > ManagerProtocolMapType;
   ManagerProtocolMapType manager_protocol_map_;
 
-  // Map "Inbound ConnectionID" -> Manager
+  // Map "Outbound ConnectionID" -> Manager, filled in by the managers
   typedef std::map<const darc::ID, protocol_manager_base*> ManagerConnectionMapType;
   ManagerConnectionMapType manager_connection_map_;
+  std::set<darc::ID> shared_connections_; // reach every neighbour on them at once
+  boost::mutex manager_connection_mutex_;
 
   // Node -> Outbound connection map (handle this a little more intelligent, more connections per nodes, timeout etc)
   typedef std::map<const darc::ID, const darc::ID> NeighbourNodesType; // NodeID -> OutboundID
   NeighbourNodesType neighbour_nodes_;
+  // Shared connections neighbours were also found on, used for broadcasts
+  NeighbourNodesType neighbour_shared_nodes_;
+
+  // Capabilities announced in DISCOVER/DISCOVER_REPLY, see discover_packet.
+  // Written on the transport threads and read on the publishers', under
+  // manager_connection_mutex_.
+  typedef std::map<const darc::ID, uint32_t> NeighbourCapabilitiesType;
+  NeighbourCapabilitiesType neighbour_capabilities_;
+
+  // CRC-32C on outgoing frames, frames with one are always verified
+  boost::atomic<bool> link_checksum_;
+  boost::atomic<uint64_t> link_checksum_failures_;
 
 public:
   network_manager(boost::asio::io_service &io_service, darc::peer& p);
-  ~network_manager() {}
+  ~network_manager();
 
   void sendPacket(const darc::ID& recv_node_id, buffer::shared_buffer data);
+  void send_data(const darc::ID& recv_node_id, const data_header_packet& header, buffer::shared_buffer data);
+  bool data_header_supported(const darc::ID& recv_node_id);
   void accept(const std::string& url);
   void connect(const std::string& url);
 
+  // Outbound connections of a protocol manager, which frames to neighbours
+  // discovered on them are sent through. A frame sent on a shared
+  // connection, e.g. a multicast group, reaches all neighbours on it, so
+  // broadcasts are sent on it once to the neighbours found on it. Frames to
+  // one neighbour stay on its own link, and only go on a shared connection
+  // when the neighbour has no other.
+  void register_connection(const ID& connection_id, protocol_manager_base * manager, bool shared = false);
+  void unregister_connection(const ID& connection_id);
+
   void neighbour_peer_discovered(const ID& src_peer_id, const ID& connection_id);
   void neighbour_peer_disconnected(const ID& src_peer_id, const ID& connection_id);
+  void neighbour_capabilities(const ID& src_peer_id, uint32_t capabilities);
   void service_packet_received(const ID& src_peer_id, buffer::shared_buffer data);
+  void data_packet_received(const ID& src_peer_id, const data_header_packet& header, buffer::shared_buffer data);
+
+  void set_link_checksum(bool enable)
+  {
+    link_checksum_ = enable;
+  }
+
+  bool link_checksum() const
+  {
+    return link_checksum_;
+  }
+
+  void link_checksum_failed(const ID& src_peer_id);
+
+  // Received frames dropped because the checksum did not match
+  uint64_t link_checksum_failures() const
+  {
+    return link_checksum_failures_;
+  }
 
 private:
   // Get the protocol manager from a protocol name
   boost::shared_ptr<protocol_manager_base>& getManager(const std::string& protocol);
 
+  void send(const darc::ID& recv_node_id, uint16_t packet_type, buffer::shared_buffer data);
+  void send_frame(const darc::ID& connection_id, const darc::ID& recv_node_id, buffer::shared_buffer data);
+  bool shared_connection(const darc::ID& connection_id);
+  // With manager_connection_mutex_ held
+  bool has_capability(const darc::ID& node_id, uint32_t capability);
+
 };
 
 }
@@ -35,8 +35,12 @@
 
 #pragma once
 
+#include <cassert>
+#include <cstring>
 #include <boost/utility.hpp>
 #include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/slice_buffer.hpp>
 
 namespace darc
 {
@@ -49,6 +53,61 @@ public:
   }
 
   virtual void pack(buffer::shared_buffer& buffer) const = 0;
+
+  // Exact number of bytes pack() will write
+  virtual size_t serialized_size() const = 0;
+
+  // serialized_size() when it is cheap to tell, or 0 when it would take a
+  // dry run of the serialization. Buffers sized from it grow as pack() writes.
+  virtual size_t size_hint() const
+  {
+    return serialized_size();
+  }
+
+  // Serialize in front of the data already in the buffer, using its
+  // headroom. The existing data is not moved. Without room in front, e.g. a
+  // received frame being passed on, buffer is replaced by a chain of the
+  // header and the data.
+  virtual void prepend(buffer::shared_buffer& buffer) const
+  {
+    darc::buffer::shared_chain_buffer header = darc::buffer::chain_buffer::create(serialized_size(), 0);
+    darc::buffer::shared_buffer header_buffer = header;
+    pack(header_buffer);
+
+    darc::buffer::buffer::segment_list_type segments;
+    header->segments(segments);
+    while(!segments.empty() &&
+          buffer->prepend(boost::asio::buffer_cast<const char*>(segments.back()),
+                          boost::asio::buffer_size(segments.back())))
+    {
+      segments.pop_back();
+    }
+    if(segments.empty())
+    {
+      return;
+    }
+
+    // What is left of the header gets headroom for the next layer
+    darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create(serialized_size());
+    for(darc::buffer::buffer::segment_list_type::iterator it = segments.begin();
+        it != segments.end();
+        it++)
+    {
+      chain->sputn(boost::asio::buffer_cast<const char*>(*it), boost::asio::buffer_size(*it));
+    }
+
+    darc::buffer::buffer::segment_list_type data_segments;
+    buffer->segments(data_segments);
+    for(darc::buffer::buffer::segment_list_type::iterator it = data_segments.begin();
+        it != data_segments.end();
+        it++)
+    {
+      chain->append(boost::make_shared<darc::buffer::slice_buffer>(buffer,
+                                                                   boost::asio::buffer_cast<const char*>(*it),
+                                                                   boost::asio::buffer_size(*it)));
+    }
+    buffer = chain;
+  }
 };
 
 template<typename S, typename T>
@@ -67,6 +126,16 @@ public:
   {
     S::template pack<T>(buffer, data_);
   }
+
+  virtual size_t serialized_size() const
+  {
+    return S::template size<T>(data_);
+  }
+
+  virtual size_t size_hint() const
+  {
+    return S::template size_hint<T>(data_);
+  }
 };
 
 template<typename S, typename T>
@@ -85,14 +154,24 @@ public:
   {
     S::template pack<T>(buffer, *data_);
   }
+
+  virtual size_t serialized_size() const
+  {
+    return S::template size<T>(*data_);
+  }
+
+  virtual size_t size_hint() const
+  {
+    return S::template size_hint<T>(*data_);
+  }
 };
 
 template<typename S, typename T>
 class outbound_list : public outbound_data_base, boost::noncopyable
 {
 protected:
-  const T& begin_;
-  const T& end_;
+  const T begin_;
+  const T end_;
 
 public:
   outbound_list(const T& begin, const T& end) :
@@ -111,6 +190,90 @@ public:
     }
   }
 
+  virtual size_t serialized_size() const
+  {
+    size_t size = 0;
+    for(T it = begin_;
+        it != end_;
+        it++)
+    {
+      size += S::template size<typename T::value_type>(*it);
+    }
+    return size;
+  }
+
+  virtual size_t size_hint() const
+  {
+    size_t size = 0;
+    for(T it = begin_;
+        it != end_;
+        it++)
+    {
+      size_t hint = S::template size_hint<typename T::value_type>(*it);
+      if(hint == 0)
+      {
+        return 0;
+      }
+      size += hint;
+    }
+    return size;
+  }
+
+};
+
+// Data that is already serialized, copied as it is
+class outbound_buffer : public outbound_data_base
+{
+protected:
+  buffer::shared_buffer data_;
+  buffer::buffer::segment_list_type segments_;
+  size_t size_;
+
+public:
+  outbound_buffer(buffer::shared_buffer data) :
+    data_(data),
+    size_(0)
+  {
+    data_->unread_segments(segments_);
+    for(buffer::buffer::segment_list_type::iterator it = segments_.begin();
+        it != segments_.end();
+        it++)
+    {
+      size_ += boost::asio::buffer_size(*it);
+    }
+  }
+
+  virtual void pack(buffer::shared_buffer& buffer) const
+  {
+    for(darc::buffer::buffer::segment_list_type::const_iterator it = segments_.begin();
+        it != segments_.end();
+        it++)
+    {
+      const char * src = boost::asio::buffer_cast<const char*>(*it);
+      size_t size = boost::asio::buffer_size(*it);
+      char * dest = buffer->prepare(size);
+      if(dest != 0)
+      {
+        memcpy(dest, src, size);
+        buffer->commit(size);
+      }
+      else
+      {
+        buffer->streambuf()->sputn(src, size);
+      }
+    }
+  }
+
+  virtual size_t serialized_size() const
+  {
+    return size_;
+  }
+
+  virtual size_t size_hint() const
+  {
+    return size_;
+  }
+
 };
 
 class outbound_pair : public outbound_data_base
@@ -132,6 +295,18 @@ public:
     second_.pack(buffer);
   }
 
+  virtual size_t serialized_size() const
+  {
+    return first_.serialized_size() + second_.serialized_size();
+  }
+
+  virtual size_t size_hint() const
+  {
+    size_t first = first_.size_hint();
+    size_t second = second_.size_hint();
+    return first == 0 || second == 0 ? 0 : first + second;
+  }
+
 };
 
 }
@@ -36,6 +36,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -53,3 +54,5 @@ struct payload_header_packet
 };
 
 }
+
+DARC_RAW_LAYOUT(darc::payload_header_packet, 4)
@@ -59,10 +59,10 @@ public:
   virtual void accept(const std::string& protocol, const std::string& url) = 0;
   virtual void connect(const std::string& protocol, const std::string& url) = 0;
 
-  virtual void send_packet(const darc::ID& outbound_id,
-                           const ID& dest_peer_id,
-                           const uint16_t packet_type,
-                           buffer::shared_buffer data) = 0;
+  // Send a packet which already has its link header
+  virtual void send_frame(const darc::ID& outbound_id,
+                          const ID& topic_peer_id,
+                          buffer::shared_buffer data) = 0;
 /*
   void sendDiscover(const ID& outbound_id)
   {
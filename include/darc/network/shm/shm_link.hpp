@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * One shared memory connection between two peers on the same host
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <boost/utility.hpp>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <darc/id.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/network/shm/shm_ring.hpp>
+#include <iris/static_scope.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace shm
+{
+
+class shm_protocol_manager;
+
+/**
+ * Each side creates the ring it receives on, and an eventfd the other side
+ * writes to when it finds the receiver asleep. Both are passed over the unix
+ * socket the connection was made on, which afterwards only carries the fds
+ * of referenced segments, and tells us when the other side goes away.
+ *
+ * Frames are copied into the ring once by the sender. Larger frames are
+ * given to the receiver where they are in the ring, and stay there until
+ * the last reference is dropped. Frames too large for the ring, or already
+ * in a shm_buffer, are sent as a reference to a memfd which the receiver
+ * maps.
+ */
+class shm_link : public iris::static_scope<iris::Info>, public boost::noncopyable
+{
+public:
+  static const size_t copy_threshold = 4096; // smaller frames are copied out of the ring
+  static const size_t reference_threshold = 64 * 1024; // shm_buffers from this size are not copied
+  static const int send_timeout_ms = 100; // waiting for the receiver to make room
+
+protected:
+  shm_protocol_manager * parent_;
+  int socket_;
+  ID outbound_id_;
+  ID remote_peer_id_;
+
+  shared_shm_ring rx_;
+  int rx_event_;
+
+  boost::mutex send_mutex_;
+  shared_shm_ring tx_;
+  int tx_event_;
+
+  boost::atomic<bool> stop_;
+  bool broken_; // the other side sent something invalid
+  boost::atomic<uint64_t> dropped_;
+
+  shm_link(shm_protocol_manager * parent, int socket);
+
+public:
+  ~shm_link();
+
+  // Exchange rings with the other side of a connected unix socket. Takes
+  // ownership of socket, returns 0 if the other side is not a shm_link.
+  static boost::shared_ptr<shm_link> handshake(shm_protocol_manager * parent, int socket);
+
+  // Frames with their link header. False if dropped.
+  bool send(buffer::shared_buffer data);
+
+  // Receive until stop() or the other side goes away, which returns true
+  bool run();
+  void stop();
+
+  const ID& outbound_id() const
+  {
+    return outbound_id_;
+  }
+
+  const ID& remote_peer_id() const
+  {
+    return remote_peer_id_;
+  }
+
+  // Frames not sent because the receiver did not make room in time
+  uint64_t dropped() const
+  {
+    return dropped_;
+  }
+
+protected:
+  bool receive();
+  buffer::shared_buffer map_reference(const shm_reference& reference);
+
+  // Called with send_mutex_ held
+  char * prepare(size_t size);
+  bool send_reference(int fd, uint64_t offset, uint64_t size);
+
+  void wake(int event_fd);
+
+};
+
+typedef boost::shared_ptr<shm_link> shared_shm_link;
+
+}
+}
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * DARC shared memory ProtocolManager class
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <map>
+#include <list>
+#include <boost/thread.hpp>
+#include <darc/peer/peer.hpp>
+#include <darc/network/protocol_manager_base.hpp>
+#include <darc/network/inbound_link_base.hpp>
+#include <darc/network/shm/shm_link.hpp>
+
+namespace darc
+{
+namespace network
+{
+
+class network_manager; // fwd
+
+namespace shm
+{
+
+/**
+ * "shm://path" for peers on the same host. accept() listens on a unix
+ * socket at path, and connect() keeps trying to connect to one, like a zmq
+ * connect, also after the other side went away. Each connection becomes a
+ * shm_link with its own outbound id and receive thread, and is discovered
+ * with DISCOVER/DISCOVER_REPLY.
+ */
+class shm_protocol_manager : public protocol_manager_base, public inbound_link_base
+{
+public:
+  static const int reconnect_interval_ms = 100;
+
+private:
+  peer& peer_;
+
+  boost::mutex mutex_;
+  bool stopping_;
+
+  typedef std::map</*outbound*/ID, shared_shm_link> link_list_type;
+  link_list_type link_list_;
+
+  typedef std::list<std::pair<int, std::string> > listen_list_type; // socket, path
+  listen_list_type listen_list_;
+
+  typedef std::list<boost::shared_ptr<boost::thread> > thread_list_type;
+  thread_list_type thread_list_;
+
+public:
+  shm_protocol_manager(class network_manager * manager, peer& p);
+  ~shm_protocol_manager();
+
+  void send_frame(const darc::ID& outbound_id,
+                  const ID& topic_peer_id,
+                  buffer::shared_buffer data);
+
+  void send_frame_to_all(const ID& topic_peer_id,
+                         buffer::shared_buffer data);
+
+  void accept(const std::string& protocol, const std::string& url);
+  void connect(const std::string& protocol, const std::string& url);
+
+  const darc::ID& peer_id()
+  {
+    return peer_.id();
+  }
+
+protected:
+  // False if we are shutting down
+  bool start_thread(boost::function<void()> function);
+
+  void listen_work(int socket);
+  void connect_work(const std::string& path);
+  void link_work(shared_shm_link link);
+
+};
+
+} // namespace shm
+} // namespace network
+} // namespace darc
+
+#endif
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * Single producer, single consumer ring of frames in shared memory
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#ifdef __linux__
+
+#include <deque>
+#include <stdint.h>
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <darc/buffer/shm_buffer.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace shm
+{
+
+// Body of a REFERENCE record
+struct shm_reference
+{
+  uint64_t offset; // of the frame in the segment
+  uint64_t size;
+};
+
+/**
+ * The ring lives in an shm_buffer which the consumer creates and passes to
+ * the producer process, which maps the same pages. Frames are written once,
+ * contiguously, and the consumer reads them where they are. Space is handed
+ * back with release(), in any order and from any thread, but the producer
+ * only gets it back up to the oldest frame still in use.
+ *
+ * Only one thread may produce at a time, and only one thread may call
+ * pop(). Positions are byte counters which never wrap.
+ */
+class shm_ring
+{
+public:
+  enum record_type
+  {
+    FRAME = 1,
+    PADDING = 2, // skipped, fills the end of the ring before wrapping
+    REFERENCE = 3 // a shm_reference, the segment fd is sent separately
+  };
+
+  static const size_t control_size = 4096; // one page in front of the data
+  static const size_t record_header_size = 8;
+  static const size_t default_capacity = 8 * 1024 * 1024;
+
+protected:
+  struct control
+  {
+    uint64_t magic;
+    uint64_t capacity;
+    char pad0[48];
+    boost::atomic<uint64_t> head; // written by the producer
+    char pad1[56];
+    boost::atomic<uint64_t> tail; // written by the consumer
+    char pad2[56];
+    boost::atomic<uint32_t> waiting; // consumer is about to sleep
+  };
+
+  struct record_header
+  {
+    uint32_t size;
+    uint32_t type;
+  };
+
+  struct pending_record
+  {
+    uint64_t end;
+    bool released;
+  };
+
+  buffer::shared_shm_buffer memory_;
+  control * control_;
+  char * data_;
+  uint64_t capacity_;
+
+  // Producer
+  size_t prepared_padding_; // in front of the prepared record
+  size_t prepared_size_;
+
+  // Consumer
+  uint64_t read_;
+  boost::mutex release_mutex_;
+  std::deque<pending_record> pending_;
+  uint64_t pending_base_; // sequence number of pending_.front()
+  bool corrupt_;
+
+  shm_ring(buffer::shared_shm_buffer memory);
+
+public:
+  // New empty ring, capacity is rounded up to a power of two
+  static boost::shared_ptr<shm_ring> create(size_t capacity = default_capacity);
+
+  // Ring created by the other side, 0 if the memory does not hold one
+  static boost::shared_ptr<shm_ring> map(buffer::shared_shm_buffer memory);
+
+  int fd() const
+  {
+    return memory_->fd();
+  }
+
+  uint64_t capacity() const
+  {
+    return capacity_;
+  }
+
+  // Largest record the ring can always take once it has drained
+  size_t max_record_size() const
+  {
+    return capacity_ / 4;
+  }
+
+  // Producer: contiguous room for size bytes, or 0 if the consumer has not
+  // released enough yet. Nothing is visible until commit(), which may
+  // write less than was prepared.
+  char * prepare(size_t size);
+  void commit(record_type type, size_t size);
+
+  // Producer, after commit: true once if the consumer went to sleep and must
+  // be woken
+  bool consumer_waiting();
+
+  // Consumer: next record, which stays valid until release(sequence)
+  bool pop(record_type& type, char *& data, size_t& size, uint64_t& sequence);
+  void release(uint64_t sequence);
+
+  // Consumer, before sleeping: announce it, false if there is data after all
+  bool prepare_wait();
+  void end_wait();
+
+  bool empty();
+
+  // The producer wrote a record which does not fit the ring
+  bool corrupt() const
+  {
+    return corrupt_;
+  }
+
+};
+
+typedef boost::shared_ptr<shm_ring> shared_shm_ring;
+
+}
+}
+}
+
+#endif
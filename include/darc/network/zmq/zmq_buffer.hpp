@@ -33,6 +33,8 @@
  * \author Morten Kjaergaard
  */
 
+#pragma once
+
 #include <zmq.hpp>
 #include <darc/buffer/raw_buffer.hpp>
 #include <darc/buffer/shared_buffer.hpp>
@@ -56,10 +58,13 @@ public:
   {
     char* data = (char*)::zmq::message_t::data();
     size_t len = ::zmq::message_t::size();
+    begin_ = data;
     setp(data, data+len);
     setg(data, data, data+len);
   }
 
+  // Drops the reference taken when the frame was queued. For pooled buffers
+  // this returns the storage to the buffer_pool, from the zmq io thread.
   static void free_func(void * data, void * hint)
   {
     darc::buffer::shared_buffer * keep_alive = static_cast<darc::buffer::shared_buffer*>(hint);
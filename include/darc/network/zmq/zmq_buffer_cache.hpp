@@ -0,0 +1,153 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Bounded free list of zmq_buffer objects for a receiving worker
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/atomic.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+#include <darc/network/zmq/zmq_buffer.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace zeromq
+{
+
+/**
+ * The cache owns up to max_size buffers and hands out references to them.
+ * When the dispatcher and all subscribers have dropped a buffer it goes
+ * back to the cache, which closes its zmq message right away, so an idle
+ * buffer holds no frame. The buffer is then received into again. In steady
+ * state receiving a frame therefore neither allocates from the heap nor
+ * locks. When all cached buffers are in use a new one is made, and kept if
+ * the cache is not full yet.
+ *
+ * Only the owning worker's receive thread may call acquire(). The buffers
+ * themselves can be released from any thread.
+ */
+class zmq_buffer_cache
+{
+public:
+  static const size_t default_max_size = 64;
+  static const size_t max_scan = 8; // buffers looked at per acquire()
+
+protected:
+  struct slot
+  {
+    zmq_buffer buffer;
+    boost::atomic<bool> in_use;
+
+    slot() :
+      in_use(false)
+    {
+    }
+  };
+
+  typedef boost::shared_ptr<slot> shared_slot;
+  typedef std::vector<shared_slot> slot_list_type;
+
+  // Deleter of the handed out references, run by whoever drops the last one
+  struct release
+  {
+    shared_slot slot_;
+
+    release(const shared_slot& s) :
+      slot_(s)
+    {
+    }
+
+    void operator()(zmq_buffer * buffer)
+    {
+      buffer->rebuild();
+      buffer->update_buffer();
+      slot_->in_use.store(false, boost::memory_order_release);
+    }
+  };
+
+  slot_list_type slots_;
+  size_t max_size_;
+  size_t next_;
+
+  boost::shared_ptr<zmq_buffer> hand_out(const shared_slot& s)
+  {
+    s->in_use.store(true, boost::memory_order_relaxed);
+    return boost::shared_ptr<zmq_buffer>(&s->buffer,
+                                         release(s),
+                                         buffer::pool_allocator<zmq_buffer>());
+  }
+
+public:
+  zmq_buffer_cache(size_t max_size = default_max_size) :
+    max_size_(max_size),
+    next_(0)
+  {
+    slots_.reserve(max_size_);
+  }
+
+  // Buffer to receive into
+  boost::shared_ptr<zmq_buffer> acquire()
+  {
+    for(size_t i = 0; i < slots_.size() && i < max_scan; i++)
+    {
+      shared_slot& s = slots_[next_];
+      next_ = (next_ + 1) % slots_.size();
+      if(!s->in_use.load(boost::memory_order_acquire))
+      {
+        return hand_out(s);
+      }
+    }
+
+    if(slots_.size() < max_size_)
+    {
+      slots_.push_back(boost::make_shared<slot>());
+      return hand_out(slots_.back());
+    }
+    return boost::make_shared<zmq_buffer>();
+  }
+
+  size_t size() const
+  {
+    return slots_.size();
+  }
+
+};
+
+}
+}
+}
@@ -34,6 +34,7 @@
 #pragma once
 
 #include <darc/network/zmq/zmq_worker.hpp>
+#include <darc/network/zmq/zmq_buffer_cache.hpp>
 
 namespace darc
 {
@@ -50,6 +51,9 @@ public:
                      zmq::context_t& context);
 
 protected:
+  zmq::message_t topic_msg_;
+  zmq_buffer_cache buffer_cache_;
+
   void work_receive();
 
 };
@@ -70,14 +70,12 @@ public:
   zmq_protocol_manager(class network_manager * manager, peer& p);
   ~zmq_protocol_manager();
 
-  void send_packet(const darc::ID& outbound_id,
-                   const ID& dest_peer_id,
-                   const uint16_t packet_type,
-                   buffer::shared_buffer data);
-
-  virtual void send_packet_to_all(const ID& dest_peer_id,
-                                  const uint16_t packet_type,
-                                  buffer::shared_buffer data);
+  void send_frame(const darc::ID& outbound_id,
+                  const ID& topic_peer_id,
+                  buffer::shared_buffer data);
+
+  void send_frame_to_all(const ID& topic_peer_id,
+                         buffer::shared_buffer data);
 
   void accept(const std::string& protocol, const std::string& url);
   void connect(const std::string& protocol, const std::string& url);
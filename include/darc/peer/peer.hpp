@@ -41,7 +41,9 @@
 #include <darc/id.hpp>
 #include <darc/network/outbound_data.hpp>
 #include <darc/network/service_header_packet.hpp>
+#include <darc/network/data_header_packet.hpp>
 #include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/buffer_allocator.hpp>
 
 namespace darc
 {
@@ -57,11 +59,17 @@ protected:
   typedef std::map<service_type, peer_service*> service_list_type;
 
   typedef boost::function<void(const darc::ID&, darc::buffer::shared_buffer)> send_to_function_type;
+  typedef boost::function<void(const darc::ID&,
+                               const data_header_packet&,
+                               darc::buffer::shared_buffer)> send_data_function_type;
+  typedef boost::function<bool(const darc::ID&)> data_header_supported_function_type;
 
   typedef boost::signal<void(const ID&)> peer_connected_signal_type;
   typedef boost::signal<void(const ID&)> peer_disconnected_signal_type;
 
   send_to_function_type send_to_function_;
+  send_data_function_type send_data_function_;
+  data_header_supported_function_type data_header_supported_function_;
   ID id_;
   service_list_type service_list_;
 
@@ -73,8 +81,17 @@ public:
     id_(ID::create())
   {}
 
-  void send_to(const ID& peer_id, service_type service, const outbound_data_base& data);
+  // allocator provides the buffer, by default a pooled chain_buffer
+  void send_to(const ID& peer_id, service_type service, const outbound_data_base& data,
+               buffer::buffer_allocator * allocator = 0);
   void recv(const ID& src_peer_id, buffer::shared_buffer data);
+
+  // Data plane with a single data_header_packet instead of nested headers.
+  // Only to be used when data_header_supported() for the destination.
+  bool data_header_supported(const ID& peer_id);
+  void send_data(const ID& peer_id, const data_header_packet& header, const outbound_data_base& data,
+                 buffer::buffer_allocator * allocator = 0);
+  void recv_data(const ID& src_peer_id, const data_header_packet& header, buffer::shared_buffer data);
   void attach(service_type service_index, peer_service * service_instance);
 
   void peer_connected(const ID& peer_id);
@@ -85,6 +102,13 @@ public:
     send_to_function_ = send_to_function;
   }
 
+  virtual void set_send_data_function(send_data_function_type send_data_function,
+                                      data_header_supported_function_type data_header_supported_function)
+  {
+    send_data_function_ = send_data_function;
+    data_header_supported_function_ = data_header_supported_function;
+  }
+
   const ID& id()
   {
     return id_;
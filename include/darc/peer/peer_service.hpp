@@ -37,6 +37,7 @@
 #include <darc/id.hpp>
 #include <darc/peer/peer.hpp>
 #include <darc/buffer/shared_buffer.hpp>
+#include <iris/glog.hpp>
 
 namespace darc
 {
@@ -55,6 +56,15 @@ public:
   virtual void recv(const darc::ID& src_peer_id,
                     darc::buffer::shared_buffer data) = 0;
 
+  // Services which call send_data() must handle what it sends
+  virtual void recv_data(const darc::ID& src_peer_id,
+                         const data_header_packet& header,
+                         darc::buffer::shared_buffer data)
+  {
+    iris::glog<iris::Warning>("Received data header packet for service without data plane",
+                              "service", iris::arg<uint32_t>(header.service_type));
+  }
+
   peer_service(darc::peer& p, peer::service_type service_id) :
     peer_(p),
     service_id_(service_id)
@@ -66,9 +76,22 @@ public:
   {
   }
 
-  void send_to(const ID& peer_id, const outbound_data_base& data)
+  void send_to(const ID& peer_id, const outbound_data_base& data,
+               darc::buffer::buffer_allocator * allocator = 0)
+  {
+    peer_.send_to(peer_id, service_id_, data, allocator);
+  }
+
+  bool data_header_supported(const ID& peer_id)
+  {
+    return peer_.data_header_supported(peer_id);
+  }
+
+  void send_data(const ID& peer_id, data_header_packet header, const outbound_data_base& data,
+                 darc::buffer::buffer_allocator * allocator = 0)
   {
-    peer_.send_to(peer_id, service_id_, data);
+    header.service_type = service_id_;
+    peer_.send_data(peer_id, header, data, allocator);
   }
 
 };
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
+
+namespace darc
+{
+namespace pubsub
+{
+
+// Sent to a publisher when a delta stream can not be followed
+struct keyframe_request_packet
+{
+  const static uint32_t payload_id = 0x07;
+
+  darc::ID tag_id;
+
+  keyframe_request_packet(const darc::ID& tag_id = ID::null()) :
+    tag_id(tag_id)
+  {
+  }
+
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & tag_id;
+  }
+
+};
+
+}
+}
+
+DARC_RAW_LAYOUT(darc::pubsub::keyframe_request_packet, 16)
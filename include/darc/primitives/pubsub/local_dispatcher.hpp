@@ -1,6 +1,7 @@
 #pragma once
 
 #include <boost/asio.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <darc/primitives/pubsub/subscriber.hpp>
 #include <darc/primitives/pubsub/publisher.hpp>
 #include <darc/ns/tag_handle.hpp>
@@ -21,10 +22,21 @@ public:
   {
   }
 
+  // verified when the sender advertised our type fingerprint
   virtual void remote_message_recv(const ID& tag_id,
-                                   darc::buffer::shared_buffer data) = 0;
+                                   darc::buffer::shared_buffer data,
+                                   bool verified) = 0;
 
   virtual void inform_remote_peer(const ID& peer_id) = 0;
+
+  // Serializer and type, as advertised in publish packets
+  virtual const std::string& type_name() const = 0;
+  virtual uint64_t type_fingerprint() const = 0;
+
+  virtual bool has_subscribers() const = 0;
+
+  // A remote subscriber lost track of the delta stream
+  virtual void request_keyframe() = 0;
 };
 
 template<typename T>
@@ -34,19 +46,85 @@ private:
   typedef std::vector<publisher_impl<T> *> publishers_list_type;
   typedef std::vector<subscriber_impl<T> *> subscribers_list_type;
 
-  typedef serializer::boost_serializer serializer_type;
+  typedef serializer::serializer_selector<T> selector_type;
+  typedef typename selector_type::type serializer_type;
 
   publishers_list_type publishers_;
   subscribers_list_type subscribers_;
 
   message_service * message_service_;
   tag_handle tag_;
+  std::string type_name_;
+  boost::scoped_ptr<darc::compression::compression_stage> compression_;
+  boost::scoped_ptr<darc::compression::delta_encoder> delta_;
 
 public:
   local_dispatcher(message_service * message_service, const tag_handle& tag) :
     message_service_(message_service),
-    tag_(tag)
+    tag_(tag),
+    type_name_(std::string(selector_type::name()) + ":" + type_string_of<T>::name())
+  {
+  }
+
+  const std::string& type_name() const
+  {
+    return type_name_;
+  }
+
+  uint64_t type_fingerprint() const
+  {
+    return serializer::type_fingerprint<T>::value();
+  }
+
+  bool has_subscribers() const
+  {
+    return !subscribers_.empty();
+  }
+
+  // Applies to everything published on the topic. Set it before
+  // publishing starts, later changes are picked up per message.
+  void set_compression(const darc::compression::compression_config& config)
+  {
+    if(compression_.get() == 0)
+    {
+      compression_.reset(new darc::compression::compression_stage(config));
+    }
+    else
+    {
+      compression_->configure(config);
+    }
+  }
+
+  darc::compression::compression_stats compression_stats()
+  {
+    return compression_.get() == 0 ? darc::compression::compression_stats() : compression_->stats();
+  }
+
+  // Sends deltas against the previous message instead of whole messages,
+  // replacing compression. Set it before publishing starts.
+  void set_delta(const darc::compression::delta_config& config)
+  {
+    if(delta_.get() == 0)
+    {
+      delta_.reset(new darc::compression::delta_encoder(config));
+    }
+    else
+    {
+      delta_->configure(config);
+    }
+  }
+
+  darc::compression::delta_stats delta_stats()
+  {
+    return delta_.get() == 0 ? darc::compression::delta_stats() : delta_->stats();
+  }
+
+  void request_keyframe()
   {
+    if(delta_.get() != 0)
+    {
+      delta_->request_keyframe();
+    }
   }
 
   void attach(subscriber_impl<T> &subscriber)
@@ -54,8 +132,9 @@ public:
     if(subscribers_.empty())
     {
       message_service_->send_subscription(ID::null(), tag_->id(),
-                                                      tag_->name(),
-                                                      "");
+                                          tag_->name(),
+                                          type_name_,
+                                          type_fingerprint());
     }
     subscribers_.push_back(&subscriber);
   }
@@ -66,7 +145,8 @@ public:
     {
       message_service_->send_publish(ID::null(), tag_->id(),
                                      tag_->name(),
-                                     "");
+                                     type_name_,
+                                     type_fingerprint());
     }
     publishers_.push_back(&publisher);
   }
@@ -121,27 +201,43 @@ public:
     }
   }
 
-  void dispatch_from_publisher(const boost::shared_ptr<const T> &msg)
+  void dispatch_from_publisher(const boost::shared_ptr<const T> &msg,
+                               darc::buffer::buffer_allocator * allocator = 0)
   {
     dispatch_locally(msg);
 
     outbound_data<serializer_type, T> o_msg(*msg);
-    message_service_->dispatch_remotely(tag_->id(), o_msg);
+    message_service_->dispatch_remotely(tag_->id(), o_msg, allocator, compression_.get(), delta_.get());
   }
 
-  void dispatch_from_publisher(const T& msg)
+  void dispatch_from_publisher(const T& msg,
+                               darc::buffer::buffer_allocator * allocator = 0)
   {
     dispatch_locally(msg);
 
     outbound_data<serializer_type, T> o_msg(msg);
-    message_service_->dispatch_remotely(tag_->id(), o_msg);
+    message_service_->dispatch_remotely(tag_->id(), o_msg, allocator, compression_.get(), delta_.get());
   }
 
+  // Decoding is left to the subscribers, so messages nobody consumes are
+  // never deserialized
   void remote_message_recv(const ID& tag_id,
-                           darc::buffer::shared_buffer data)
+                           darc::buffer::shared_buffer data,
+                           bool verified)
   {
-    inbound_data_ptr<serializer_type, T> i_msg(data);
-    dispatch_locally(i_msg.get());
+    if(subscribers_.empty())
+    {
+      return;
+    }
+
+    typedef typename subscriber_impl<T>::lazy_message_type lazy_message_type;
+    boost::shared_ptr<lazy_message_type> msg = boost::make_shared<lazy_message_type>(data, verified);
+    for(typename subscribers_list_type::iterator it = subscribers_.begin();
+        it != subscribers_.end();
+        it++)
+    {
+      (*it)->postCallback(msg);
+    }
   }
 
   void inform_remote_peer(const ID& peer_id)
@@ -150,14 +246,16 @@ public:
     {
       message_service_->send_publish(ID::null(), tag_->id(),
                                      tag_->name(),
-                                     "");
+                                     type_name_,
+                                     type_fingerprint());
     }
 
     if(!subscribers_.empty())
     {
       message_service_->send_subscription(ID::null(), tag_->id(),
                                           tag_->name(),
-                                          "");
+                                          type_name_,
+                                          type_fingerprint());
     }
   }
 
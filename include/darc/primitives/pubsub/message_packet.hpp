@@ -1,6 +1,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -10,6 +11,10 @@ namespace pubsub
 struct message_packet
 {
   const static uint32_t payload_id = 0x02;
+  // Followed by a compression_header_packet and the compressed message
+  const static uint32_t compressed_payload_id = 0x05;
+  // Followed by a delta_header_packet and the message or a delta
+  const static uint32_t delta_payload_id = 0x06;
 
   darc::ID tag_id;
 
@@ -33,3 +38,5 @@ struct message_packet
 
 }
 }
+
+DARC_RAW_LAYOUT(darc::pubsub::message_packet, 16)
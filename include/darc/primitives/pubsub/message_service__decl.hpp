@@ -13,11 +13,16 @@
 #include <darc/network/inbound_data.hpp>
 #include <darc/serializer/boost.hpp>
 #include <darc/serializer/ros.hpp>
+#include <darc/serializer/serializer_selector.hpp>
+#include <darc/serializer/type_fingerprint.hpp>
+#include <darc/compression/compression_stage.hpp>
+#include <darc/compression/delta_stage.hpp>
 
 #include <darc/network/payload_header_packet.hpp>
 #include <darc/primitives/pubsub/message_packet.hpp>
 #include <darc/primitives/pubsub/subscribe_packet.hpp>
 #include <darc/primitives/pubsub/publish_packet.hpp>
+#include <darc/primitives/pubsub/keyframe_request_packet.hpp>
 #include <darc/primitives/pubsub/subscribed_topic_record.hpp>
 
 namespace darc
@@ -56,6 +61,34 @@ private:
   typedef std::set<subscribed_topic_record> published_topics_list_type;
   published_topics_list_type published_topics_list_;
 
+  // Type fingerprints advertised by remote publishers, per (peer, tag).
+  // Messages for a tag whose fingerprint does not match the local
+  // dispatcher are dropped without decoding. Read and written on the
+  // receive threads, under remote_type_list_mutex_.
+  struct remote_type_record
+  {
+    uint64_t type_fingerprint;
+    std::string type_name;
+    bool rejected;
+  };
+  typedef std::map<std::pair<darc::ID, darc::ID>, remote_type_record> remote_type_list_type;
+  remote_type_list_type remote_type_list_;
+  boost::mutex remote_type_list_mutex_;
+
+  void send_payload(const ID& tag_id, const ID& peer_id, uint16_t payload_type,
+                    const outbound_data_base& msg_data,
+                    darc::buffer::buffer_allocator * allocator);
+
+  // Delta streams from remote publishers, per (peer, tag). Frames arrive on
+  // the threads of several transports.
+  typedef std::map<std::pair<darc::ID, darc::ID>, darc::compression::delta_decoder> delta_decoder_list_type;
+  delta_decoder_list_type delta_decoders_;
+  boost::mutex delta_decoders_mutex_;
+
+  // Warns the first time a remote type is found not to match. Called with
+  // remote_type_list_mutex_ held.
+  bool accept_remote_type(remote_type_record& record, const local_dispatcher_base& dispatcher);
+
   // New Topics
   typedef void(topic_change_callback_type)(bool event, const ID& peer_id, const std::string& topic, const std::string& type);
 public:
@@ -78,23 +111,44 @@ public:
   void peer_connected_handler(const ID& peer_id);
   void peer_disconnected_handler(const ID& peer_id);
 
-  void send_subscription(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name);
-  void send_publish(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name);
+  void send_subscription(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name,
+                         uint64_t type_fingerprint);
+  void send_publish(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name,
+                    uint64_t type_fingerprint);
 
   void recv(const darc::ID& src_peer_id,
             darc::buffer::shared_buffer data);
+  void recv_data(const darc::ID& src_peer_id,
+                 const data_header_packet& header,
+                 darc::buffer::shared_buffer data);
 
-  void send_msg(const ID& tag_id, const ID& peer_id, const outbound_data_base& msg_data);
+  void send_msg(const ID& tag_id, const ID& peer_id, const outbound_data_base& msg_data,
+                darc::buffer::buffer_allocator * allocator = 0,
+                darc::compression::compression_stage * compression = 0,
+                darc::compression::delta_encoder * delta = 0);
 
-  void dispatch_remotely(const ID& tag_id, const outbound_data_base& msg_data);
+  void dispatch_remotely(const ID& tag_id, const outbound_data_base& msg_data,
+                         darc::buffer::buffer_allocator * allocator = 0,
+                         darc::compression::compression_stage * compression = 0,
+                         darc::compression::delta_encoder * delta = 0);
 
   void handle_message_packet(const ID& remote_peer_id,
-                             darc::buffer::shared_buffer data);
+                             darc::buffer::shared_buffer data,
+                             uint32_t payload_type = message_packet::payload_id);
+  void dispatch_remote_message(const ID& remote_peer_id,
+                               const ID& tag_id,
+                               darc::buffer::shared_buffer msg_data,
+                               uint32_t payload_type = message_packet::payload_id);
   void handle_publish_packet(const ID& remote_peer_id,
                              darc::buffer::shared_buffer data);
   void handle_subscribe_packet(const ID& remote_peer_id,
                                darc::buffer::shared_buffer data);
 
+  // Asks the publisher of a delta encoded topic for a whole message
+  void send_keyframe_request(const ID& peer_id, const ID& tag_id);
+  void handle_keyframe_request_packet(const ID& remote_peer_id,
+                                      darc::buffer::shared_buffer data);
+
   ///////////////////////////
   // Local dispatchers stuff
   template<typename T>
@@ -14,13 +14,16 @@ struct publish_packet
   darc::ID topic_id;
   std::string topic_name;
   std::string type_name;
+  uint64_t type_fingerprint;
 
   publish_packet(const darc::ID& topic_id = ID::null(),
                  const std::string& topic_name = "",
-                 const std::string& type_name = "") :
+                 const std::string& type_name = "",
+                 uint64_t type_fingerprint = 0) :
     topic_id(topic_id),
     topic_name(topic_name),
-    type_name(type_name)
+    type_name(type_name),
+    type_fingerprint(type_fingerprint)
   {
   }
 
@@ -30,6 +33,7 @@ struct publish_packet
     ar & topic_id;
     ar & topic_name;
     ar & type_name;
+    ar & type_fingerprint;
   }
 
 };
@@ -7,6 +7,7 @@
 #include <darc/primitives/pubsub/message_service__decl.hpp>
 
 #include <darc/id.hpp>
+#include <darc/buffer/buffer_allocator.hpp>
 
 #include <boost/make_shared.hpp>
 
@@ -23,6 +24,7 @@ private:
   message_service &message_service_;
 
   local_dispatcher<T> * dispatcher_; // ptr type?
+  darc::buffer::shared_buffer_allocator allocator_;
 
 public:
   publisher_impl(boost::asio::io_service &io_service,
@@ -47,11 +49,45 @@ public:
     }
   }
 
+  // Buffers for remote subscribers come from allocator, e.g. a
+  // huge_page_arena for large messages. Empty for the default pool.
+  void set_allocator(darc::buffer::shared_buffer_allocator allocator)
+  {
+    allocator_ = allocator;
+  }
+
+  // Compression is per topic, shared with the other publishers on it.
+  // Only possible once attached.
+  void set_compression(const darc::compression::compression_config& config)
+  {
+    assert(dispatcher_ != 0);
+    dispatcher_->set_compression(config);
+  }
+
+  darc::compression::compression_stats compression_stats()
+  {
+    assert(dispatcher_ != 0);
+    return dispatcher_->compression_stats();
+  }
+
+  // Delta encoding is per topic as well. Only possible once attached.
+  void set_delta(const darc::compression::delta_config& config)
+  {
+    assert(dispatcher_ != 0);
+    dispatcher_->set_delta(config);
+  }
+
+  darc::compression::delta_stats delta_stats()
+  {
+    assert(dispatcher_ != 0);
+    return dispatcher_->delta_stats();
+  }
+
   void publish(const boost::shared_ptr<const T> &msg)
   {
     if(dispatcher_ != 0)
     {
-      dispatcher_->dispatch_from_publisher(msg);
+      dispatcher_->dispatch_from_publisher(msg, allocator_.get());
     }
   }
 
@@ -59,7 +95,7 @@ public:
   {
     if(dispatcher_ != 0)
     {
-      dispatcher_->dispatch_from_publisher(msg);
+      dispatcher_->dispatch_from_publisher(msg, allocator_.get());
     }
   }
 
@@ -102,6 +138,48 @@ public:
     }
   }
 
+  void set_allocator(darc::buffer::shared_buffer_allocator allocator)
+  {
+    if(ok_)
+    {
+      impl_->set_allocator(allocator);
+    }
+  }
+
+  void set_compression(const darc::compression::compression_config& config)
+  {
+    if(ok_)
+    {
+      impl_->set_compression(config);
+    }
+  }
+
+  darc::compression::compression_stats compression_stats()
+  {
+    if(ok_)
+    {
+      return impl_->compression_stats();
+    }
+    return darc::compression::compression_stats();
+  }
+
+  void set_delta(const darc::compression::delta_config& config)
+  {
+    if(ok_)
+    {
+      impl_->set_delta(config);
+    }
+  }
+
+  darc::compression::delta_stats delta_stats()
+  {
+    if(ok_)
+    {
+      return impl_->delta_stats();
+    }
+    return darc::compression::delta_stats();
+  }
+
   void attach(const std::string& topic)
   {
     if(ok_)
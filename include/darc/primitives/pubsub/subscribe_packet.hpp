@@ -1,6 +1,7 @@
 #pragma once
 
 #include <darc/id.hpp>
+#include <darc/serializer/raw.hpp>
 
 namespace darc
 {
@@ -12,9 +13,12 @@ struct subscribe_packet
   const static uint32_t payload_id = 0x01;
 
   darc::ID topic_id;
+  uint64_t type_fingerprint;
 
-  subscribe_packet(const darc::ID& topic_id = ID::null()) :
-    topic_id(topic_id)
+  subscribe_packet(const darc::ID& topic_id = ID::null(),
+                   uint64_t type_fingerprint = 0) :
+    topic_id(topic_id),
+    type_fingerprint(type_fingerprint)
   {
   }
 
@@ -22,9 +26,12 @@ struct subscribe_packet
   void serialize(Archive & ar, const unsigned int version)
   {
     ar & topic_id;
+    ar & type_fingerprint;
   }
 
 };
 
 }
 }
+
+DARC_RAW_LAYOUT(darc::pubsub::subscribe_packet, 24)
@@ -6,6 +6,7 @@
 #include <boost/bind.hpp>
 
 #include <darc/primitives/pubsub/message_service__decl.hpp>
+#include <darc/network/inbound_data.hpp>
 
 #include <darc/id.hpp>
 
@@ -20,6 +21,7 @@ class subscriber_impl
 public:
   typedef void(callback_type)(const T&);
   typedef boost::function<callback_type> callback_functor_type;
+  typedef lazy_inbound_data<typename serializer::serializer_selector<T>::type, T> lazy_message_type;
 
 private:
   boost::asio::io_service &io_service_;
@@ -71,6 +73,26 @@ public:
 //    io_service_.post(callback_, msg);
   }
 
+  // Remote messages, decoded by the first subscriber callback that runs
+  void postCallback(const boost::shared_ptr<lazy_message_type> &msg)
+  {
+    io_service_.post(boost::bind(&subscriber_impl::triggerLazyCallback, this, msg));
+  }
+
+  void triggerLazyCallback(const boost::shared_ptr<lazy_message_type> &msg)
+  {
+    // Detached or no callback since the message was posted
+    if(dispatcher_ == 0 || !callback_)
+    {
+      return;
+    }
+    const boost::shared_ptr<const T>& value = msg->get();
+    if(value.get() != 0)
+    {
+      callback_(*value);
+    }
+  }
+
   void triggerCallback_(const boost::shared_ptr<const T> &msg)
   {
     callback_(*msg);
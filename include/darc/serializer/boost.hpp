@@ -35,20 +35,83 @@
 
 #pragma once
 
+#include <streambuf>
 #include <boost/utility.hpp>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 
 #include <darc/buffer/shared_buffer.hpp>
+#include <darc/serializer/fixed_size.hpp>
 
 namespace darc
 {
 namespace serializer
 {
 
+// Discards everything written to it, only counting the bytes
+class counting_streambuf : public std::streambuf
+{
+protected:
+  size_t count_;
+
+public:
+  counting_streambuf() :
+    count_(0)
+  {
+  }
+
+  size_t count() const
+  {
+    return count_;
+  }
+
+protected:
+  virtual std::streamsize xsputn(const char * s, std::streamsize n)
+  {
+    count_ += n;
+    return n;
+  }
+
+  virtual int_type overflow(int_type c)
+  {
+    count_++;
+    return traits_type::not_eof(c);
+  }
+};
+
 struct boost_serializer
 {
+  // Exact number of bytes pack() will write
+  template<typename T>
+  static size_t size(const T& data)
+  {
+    if(fixed_size<T>::value)
+    {
+      static const size_t fixed = count(data);
+      return fixed;
+    }
+    return count(data);
+  }
+
+  // Only types of a fixed size, others would need a dry run per message
+  template<typename T>
+  static size_t size_hint(const T& data)
+  {
+    return fixed_size<T>::value ? size(data) : 0;
+  }
+
+  template<typename T>
+  static size_t count(const T& data)
+  {
+    counting_streambuf counter;
+    std::ostream os(&counter);
+    boost::archive::binary_oarchive oarchive(os);
+
+    oarchive << data;
+    return counter.count();
+  }
+
   template<typename T>
   static void pack(buffer::shared_buffer& buffer, const T& data)
   {
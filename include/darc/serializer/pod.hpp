@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Serializer for plain old data, copied as it is in memory
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cstring>
+#include <darc/buffer/buffer.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/serializer/serializer_exception.hpp>
+
+namespace darc
+{
+namespace serializer
+{
+
+// Host byte order and padding, so only for peers on the same architecture
+struct pod_serializer
+{
+  template<typename T>
+  static size_t size(const T& data)
+  {
+    return sizeof(T);
+  }
+
+  template<typename T>
+  static size_t size_hint(const T& data)
+  {
+    return size(data);
+  }
+
+  template<typename T>
+  static void pack(buffer::shared_buffer& buffer, const T& data)
+  {
+    char * dest = buffer->prepare(sizeof(T));
+    if(dest != 0)
+    {
+      memcpy(dest, &data, sizeof(T));
+      buffer->commit(sizeof(T));
+    }
+    else
+    {
+      buffer->streambuf()->sputn((const char*)&data, sizeof(T));
+    }
+  }
+
+  template<typename T>
+  static void unpack(buffer::shared_buffer& buffer, T& data)
+  {
+    std::streamsize count = buffer->streambuf()->sgetn((char*)&data, sizeof(T));
+    if(count != (std::streamsize)sizeof(T))
+    {
+      throw serializer_exception()
+        << serializer_exception::expected_size(sizeof(T))
+        << serializer_exception::available_size(count);
+    }
+  }
+};
+
+}
+}
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Archive-free serializer for fixed layout packets
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstring>
+#include <stdint.h>
+
+#include <darc/id.hpp>
+#include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/buffer.hpp>
+#include <darc/serializer/fixed_size.hpp>
+#include <darc/serializer/serializer_exception.hpp>
+
+namespace darc
+{
+namespace serializer
+{
+
+/**
+ * Wire size of a type written by raw_serializer. Only types declared with
+ * DARC_RAW_LAYOUT can be used, others fail to compile.
+ */
+template<typename T>
+struct raw_layout;
+
+#define DARC_RAW_LAYOUT(T, bytes)              \
+  DARC_FIXED_SIZE(T)                           \
+  namespace darc { namespace serializer {      \
+  template<> struct raw_layout<T>              \
+  {                                            \
+    static const size_t size = bytes;          \
+  };                                           \
+  } }
+
+// Writes the fields visited by serialize() as little-endian integers and
+// raw IDs, without any archive preamble
+class raw_oarchive
+{
+protected:
+  char * p_;
+
+  void put(uint64_t value, size_t bytes)
+  {
+    for(size_t i = 0; i < bytes; i++)
+    {
+      *p_++ = static_cast<char>(value >> (8 * i));
+    }
+  }
+
+public:
+  raw_oarchive(char * p) :
+    p_(p)
+  {
+  }
+
+  char * pos() const
+  {
+    return p_;
+  }
+
+  raw_oarchive& operator&(const uint8_t& value)
+  {
+    put(value, sizeof(value));
+    return *this;
+  }
+
+  raw_oarchive& operator&(const uint16_t& value)
+  {
+    put(value, sizeof(value));
+    return *this;
+  }
+
+  raw_oarchive& operator&(const uint32_t& value)
+  {
+    put(value, sizeof(value));
+    return *this;
+  }
+
+  raw_oarchive& operator&(const uint64_t& value)
+  {
+    put(value, sizeof(value));
+    return *this;
+  }
+
+  raw_oarchive& operator&(const ID& value)
+  {
+    memcpy(p_, value.data, ID::static_size());
+    p_ += ID::static_size();
+    return *this;
+  }
+};
+
+class raw_iarchive
+{
+protected:
+  const char * p_;
+
+  uint64_t get(size_t bytes)
+  {
+    uint64_t value = 0;
+    for(size_t i = 0; i < bytes; i++)
+    {
+      value |= static_cast<uint64_t>(static_cast<uint8_t>(*p_++)) << (8 * i);
+    }
+    return value;
+  }
+
+public:
+  raw_iarchive(const char * p) :
+    p_(p)
+  {
+  }
+
+  const char * pos() const
+  {
+    return p_;
+  }
+
+  raw_iarchive& operator&(uint8_t& value)
+  {
+    value = get(sizeof(value));
+    return *this;
+  }
+
+  raw_iarchive& operator&(uint16_t& value)
+  {
+    value = get(sizeof(value));
+    return *this;
+  }
+
+  raw_iarchive& operator&(uint32_t& value)
+  {
+    value = get(sizeof(value));
+    return *this;
+  }
+
+  raw_iarchive& operator&(uint64_t& value)
+  {
+    value = get(sizeof(value));
+    return *this;
+  }
+
+  raw_iarchive& operator&(ID& value)
+  {
+    memcpy(value.data, p_, ID::static_size());
+    p_ += ID::static_size();
+    return *this;
+  }
+};
+
+struct raw_serializer
+{
+  template<typename T>
+  static size_t size(const T& data)
+  {
+    return raw_layout<T>::size;
+  }
+
+  template<typename T>
+  static size_t size_hint(const T& data)
+  {
+    return size(data);
+  }
+
+  template<typename T>
+  static void pack(buffer::shared_buffer& buffer, const T& data)
+  {
+    char bytes[raw_layout<T>::size];
+    raw_oarchive oarchive(bytes);
+    const_cast<T&>(data).serialize(oarchive, 0);
+    assert(oarchive.pos() == bytes + sizeof(bytes));
+
+    buffer->streambuf()->sputn(bytes, sizeof(bytes));
+  }
+
+  template<typename T>
+  static void unpack(buffer::shared_buffer& buffer, T& data)
+  {
+    char bytes[raw_layout<T>::size];
+    std::streamsize count = buffer->streambuf()->sgetn(bytes, sizeof(bytes));
+    if(count != (std::streamsize)sizeof(bytes))
+    {
+      throw serializer_exception()
+        << serializer_exception::expected_size(sizeof(bytes))
+        << serializer_exception::available_size(count);
+    }
+
+    raw_iarchive iarchive(bytes);
+    data.serialize(iarchive, 0);
+  }
+};
+
+}
+}
@@ -35,7 +35,10 @@
 
 #pragma once
 
+#include <vector>
+#include <algorithm>
 #include <ros/serialization.h>
+#include <darc/buffer/buffer.hpp>
 #include <darc/buffer/shared_buffer.hpp>
 #include <iris/glog.hpp>
 
@@ -46,22 +49,72 @@ namespace serializer
 
 struct ros_serializer
 {
+  template<typename T>
+  static size_t size(const T& data)
+  {
+    return ros::serialization::serializationLength(data);
+  }
+
+  template<typename T>
+  static size_t size_hint(const T& data)
+  {
+    return size(data);
+  }
+
+  // Serializes straight into the buffer when it has the exact length free
+  // in one piece, otherwise through a temporary
   template<typename T>
   static void pack(buffer::shared_buffer& buffer, const T& data)
   {
-    ros::serialization::OStream out((uint8_t*)buffer->pptr(), 1024*5); //todo: get correct size
-    uint32_t initial_len = out.getLength();
-    ros::serialization::serialize(out, data);
-    buffer->streambuf()->pubseekoff(out.getLength() - initial_len, std::ios_base::cur);
+    uint32_t len = ros::serialization::serializationLength(data);
+
+    char * dest = buffer->prepare(len);
+    if(dest != 0)
+    {
+      ros::serialization::OStream out((uint8_t*)dest, len);
+      ros::serialization::serialize(out, data);
+      buffer->commit(len);
+    }
+    else
+    {
+      std::vector<uint8_t> tmp(std::max(len, uint32_t(1)));
+      ros::serialization::OStream out(&tmp[0], len);
+      ros::serialization::serialize(out, data);
+      buffer->streambuf()->sputn((const char*)&tmp[0], len);
+    }
   }
 
+  // The message is read from the rest of the frame, which is flattened first
+  // if it is split over several segments
   template<typename T>
   static void unpack(buffer::shared_buffer& buffer, T& data)
   {
-    ros::serialization::IStream in((uint8_t*)buffer->gptr(), 1024*5); //todo: get correct size
-    uint32_t initial_len = in.getLength();
+    darc::buffer::buffer::segment_list_type segments;
+    buffer->unread_segments(segments);
+
+    std::vector<uint8_t> tmp;
+    uint8_t * src = 0;
+    uint32_t len = 0;
+    if(segments.size() == 1)
+    {
+      src = (uint8_t*)boost::asio::buffer_cast<const char*>(segments[0]);
+      len = boost::asio::buffer_size(segments[0]);
+    }
+    else
+    {
+      for(size_t i = 0; i < segments.size(); i++)
+      {
+        const uint8_t * begin = boost::asio::buffer_cast<const uint8_t*>(segments[i]);
+        tmp.insert(tmp.end(), begin, begin + boost::asio::buffer_size(segments[i]));
+      }
+      src = tmp.empty() ? 0 : &tmp[0];
+      len = tmp.size();
+    }
+
+    // Throws ros::serialization::StreamOverrunException on a short frame
+    ros::serialization::IStream in(src, len);
     ros::serialization::deserialize(in, data);
-    buffer->streambuf()->pubseekoff(initial_len - in.getLength(), std::ios_base::cur);
+    buffer->consume(len - in.getLength());
   }
 };
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * Compile time choice of serializer for a message type
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <boost/mpl/if.hpp>
+#include <boost/type_traits/is_pod.hpp>
+#include <boost/type_traits/is_pointer.hpp>
+#include <darc/serializer/type_string_of.hpp>
+#include <darc/serializer/ros.hpp>
+#include <darc/serializer/pod.hpp>
+#include <darc/serializer/boost.hpp>
+
+namespace darc
+{
+namespace serializer
+{
+
+/**
+ * ROS messages use the ROS wire format, plain old data is copied as it is,
+ * and everything else goes through boost serialization. name() is
+ * advertised to remote peers together with the type.
+ */
+template<typename T>
+struct serializer_selector
+{
+  static const bool use_ros = is_ros<T>::value;
+  static const bool use_pod = !use_ros && boost::is_pod<T>::value && !boost::is_pointer<T>::value;
+
+  typedef typename boost::mpl::if_c<use_ros,
+                                    ros_serializer,
+                                    typename boost::mpl::if_c<use_pod,
+                                                              pod_serializer,
+                                                              boost_serializer>::type>::type type;
+
+  static const char * name()
+  {
+    return use_ros ? "ros" : (use_pod ? "pod" : "boost");
+  }
+};
+
+}
+}
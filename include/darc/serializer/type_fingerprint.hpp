@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * 64 bit fingerprint of a message type and the serializer used for it
+ *
+ * \author Morten Kjaergaard
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <ros/message_traits.h>
+#include <darc/serializer/type_string_of.hpp>
+#include <darc/serializer/serializer_selector.hpp>
+
+namespace darc
+{
+namespace serializer
+{
+
+// FNV-1a
+inline uint64_t fnv1a_64(const char * str, uint64_t hash = 14695981039346656037ULL)
+{
+  for(; *str != '\0'; str++)
+  {
+    hash ^= (uint8_t)*str;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+/**
+ * Covers the serializer name, type_string_of<T> and for ROS messages the
+ * MD5 sum, so peers agree on it only if they can decode each other. 0 is
+ * never returned and means "not advertised" on the wire.
+ */
+template<typename T>
+struct type_fingerprint
+{
+  static uint64_t value()
+  {
+    static const uint64_t fingerprint = compute();
+    return fingerprint;
+  }
+
+private:
+  static uint64_t compute()
+  {
+    uint64_t hash = fnv1a_64(serializer_selector<T>::name());
+    hash = fnv1a_64(":", hash);
+    hash = fnv1a_64(type_string_of<T>::name(), hash);
+    hash = md5_impl(hash, ros::message_traits::IsMessage<T>());
+    return hash == 0 ? 1 : hash;
+  }
+
+  static uint64_t md5_impl(uint64_t hash, ros::message_traits::TrueType)
+  {
+    hash = fnv1a_64(":", hash);
+    return fnv1a_64(ros::message_traits::MD5Sum<T>::value(), hash);
+  }
+
+  static uint64_t md5_impl(uint64_t hash, ros::message_traits::FalseType)
+  {
+    return hash;
+  }
+};
+
+}
+}
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <typeinfo>
+#include <ros/message_traits.h>
+
 ////////////
 // Check for member
 // http://stackoverflow.com/questions/257288/is-it-possible-to-write-a-c-template-to-check-for-a-functions-existence/264088#264088
@@ -27,19 +30,10 @@ struct type_string_of
   }
 };
 
-// SFINAE test
 template <typename T>
-class is_ros
+struct is_ros
 {
-  template<typename C>
-  static char my_type(typeof(ros::message_traits::DataType<C>::value));
-
-  template<typename C>
-  static long my_type(...);
-
-public:
-    enum { value2 = sizeof(my_type<T>("")) == sizeof(char) };
-    static const bool value = ros::message_traits::IsMessage<T>::value;
+  static const bool value = ros::message_traits::IsMessage<T>::value;
 };
 
 }
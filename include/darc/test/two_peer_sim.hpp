@@ -3,7 +3,7 @@
 #include <darc/peer/peer.hpp>
 #include <darc/id_arg.hpp>
 
-#include <darc/buffer/raw_buffer.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
 
 namespace darc
 {
@@ -24,16 +24,57 @@ public:
       boost::bind(&two_peer_sim::send_to_node1, this, _1, _2));
   }
 
+  // Send messages with the compact data header, as negotiated by DISCOVER
+  void enable_data_header()
+  {
+    peer1.set_send_data_function(
+      boost::bind(&two_peer_sim::send_data_to_node2, this, _1, _2, _3),
+      boost::bind(&two_peer_sim::data_header_supported, _1));
+    peer2.set_send_data_function(
+      boost::bind(&two_peer_sim::send_data_to_node1, this, _1, _2, _3),
+      boost::bind(&two_peer_sim::data_header_supported, _1));
+  }
+
+  static bool data_header_supported(const darc::ID& peer_id)
+  {
+    return true;
+  }
+
+  void send_data_to_node1(const darc::ID& peer_id, const darc::data_header_packet& header, darc::buffer::shared_buffer data)
+  {
+    peer1.recv_data(peer2.id(), header, copy(data));
+  }
+
+  void send_data_to_node2(const darc::ID& peer_id, const darc::data_header_packet& header, darc::buffer::shared_buffer data)
+  {
+    peer2.recv_data(peer1.id(), header, copy(data));
+  }
+
   void send_to_node1(const darc::ID& peer_id, darc::buffer::shared_buffer data)
   {
     iris::glog<iris::Info>("Data Received from node 2");
-    peer1.recv(peer2.id(), boost::make_shared<darc::buffer::raw_buffer>(data->data(), 1024, 1024));
+    peer1.recv(peer2.id(), copy(data));
   }
 
   void send_to_node2(const darc::ID& peer_id, darc::buffer::shared_buffer data)
   {
     iris::glog<iris::Info>("Data Received from node 1");
-    peer2.recv(peer1.id(), boost::make_shared<darc::buffer::raw_buffer>(data->data(), 1024, 1024));
+    peer2.recv(peer1.id(), copy(data));
+  }
+
+  // Copy only the valid part, as a transport would
+  static darc::buffer::shared_buffer copy(darc::buffer::shared_buffer data)
+  {
+    darc::buffer::shared_buffer result = darc::buffer::pooled_buffer::create(data->len());
+
+    darc::buffer::buffer::segment_list_type segments;
+    data->segments(segments);
+    for(size_t i = 0; i < segments.size(); i++)
+    {
+      result->streambuf()->sputn(boost::asio::buffer_cast<const char*>(segments[i]),
+                                 boost::asio::buffer_size(segments[i]));
+    }
+    return result;
   }
 };
 
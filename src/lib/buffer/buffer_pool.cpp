@@ -0,0 +1,172 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/buffer/buffer_pool.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+buffer_pool::buffer_pool() :
+  oversize_allocations_(0)
+{
+  for(size_t i = 0; i < num_size_classes; i++)
+  {
+    classes_[i].block_size = min_block_size << i;
+  }
+}
+
+buffer_pool::~buffer_pool()
+{
+  for(size_t i = 0; i < num_size_classes; i++)
+  {
+    for(std::vector<char*>::iterator it = classes_[i].slabs.begin();
+        it != classes_[i].slabs.end();
+        it++)
+    {
+      delete[] *it;
+    }
+  }
+}
+
+size_t buffer_pool::class_index(size_t size)
+{
+  size_t index = 0;
+  size_t block = min_block_size;
+  while(block < size)
+  {
+    block <<= 1;
+    index++;
+  }
+  return index;
+}
+
+size_t buffer_pool::block_size(size_t size)
+{
+  size_t index = class_index(size);
+  if(index < num_size_classes)
+  {
+    return min_block_size << index;
+  }
+  return size;
+}
+
+void buffer_pool::refill(size_class& sc)
+{
+  size_t bytes = sc.block_size > slab_size ? sc.block_size : slab_size;
+  char * slab = new char[bytes];
+  sc.slabs.push_back(slab);
+  sc.heap_allocations++;
+
+  for(size_t offset = 0;
+      offset + sc.block_size <= bytes;
+      offset += sc.block_size)
+  {
+    sc.free_blocks.push_back(slab + offset);
+  }
+}
+
+void * buffer_pool::allocate(size_t size)
+{
+  size_t index = class_index(size);
+  if(index >= num_size_classes)
+  {
+    boost::mutex::scoped_lock lock(oversize_mutex_);
+    oversize_allocations_++;
+    return new char[size];
+  }
+
+  size_class& sc = classes_[index];
+  boost::mutex::scoped_lock lock(sc.mutex);
+  sc.allocations++;
+  if(sc.free_blocks.empty())
+  {
+    refill(sc);
+  }
+  void * block = sc.free_blocks.back();
+  sc.free_blocks.pop_back();
+  return block;
+}
+
+void buffer_pool::deallocate(void * block, size_t size)
+{
+  if(block == 0)
+  {
+    return;
+  }
+
+  size_t index = class_index(size);
+  if(index >= num_size_classes)
+  {
+    delete[] static_cast<char*>(block);
+    return;
+  }
+
+  size_class& sc = classes_[index];
+  boost::mutex::scoped_lock lock(sc.mutex);
+  sc.free_blocks.push_back(block);
+}
+
+buffer_pool::statistics buffer_pool::stats()
+{
+  statistics s;
+  for(size_t i = 0; i < num_size_classes; i++)
+  {
+    size_class& sc = classes_[i];
+    boost::mutex::scoped_lock lock(sc.mutex);
+    s.allocations += sc.allocations;
+    s.heap_allocations += sc.heap_allocations;
+    s.cached_blocks += sc.free_blocks.size();
+    for(std::vector<char*>::iterator it = sc.slabs.begin();
+        it != sc.slabs.end();
+        it++)
+    {
+      s.slab_bytes += sc.block_size > slab_size ? sc.block_size : slab_size;
+    }
+  }
+
+  boost::mutex::scoped_lock lock(oversize_mutex_);
+  s.allocations += oversize_allocations_;
+  s.heap_allocations += oversize_allocations_;
+  return s;
+}
+
+buffer_pool& buffer_pool::instance()
+{
+  static buffer_pool * instance_ = new buffer_pool();
+  return *instance_;
+}
+
+}
+}
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/buffer/huge_page_arena.hpp>
+#include <darc/buffer/raw_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+
+#include <boost/make_shared.hpp>
+
+#include <unistd.h>
+#include <sys/mman.h>
+
+namespace darc
+{
+namespace buffer
+{
+
+class huge_page_buffer : public raw_buffer
+{
+protected:
+  shared_huge_page_arena arena_;
+  size_t slot_;
+
+public:
+  huge_page_buffer(const shared_huge_page_arena& arena, char * begin, size_t len, size_t slot) :
+    raw_buffer(begin, len),
+    arena_(arena),
+    slot_(slot)
+  {
+  }
+
+  ~huge_page_buffer()
+  {
+    arena_->release(slot_);
+  }
+
+};
+
+huge_page_arena::huge_page_arena(size_t slot_size, size_t slot_count) :
+  map_(0),
+  map_size_(0),
+  region_(0),
+  slot_size_(((slot_size + huge_page_size - 1) / huge_page_size) * huge_page_size)
+{
+  size_t region_size = slot_size_ * slot_count;
+  if(region_size == 0)
+  {
+    return;
+  }
+
+#ifdef MAP_HUGETLB
+  void * map = mmap(0, region_size, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+  if(map != MAP_FAILED)
+  {
+    map_ = static_cast<char*>(map);
+    map_size_ = region_size;
+    region_ = map_;
+    stats_.huge_pages = true;
+  }
+#endif
+
+  if(map_ == 0)
+  {
+    // Over-allocate so the slots can start on a huge page boundary
+    void * map = mmap(0, region_size + huge_page_size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(map == MAP_FAILED)
+    {
+      // Every allocation falls back
+      return;
+    }
+    map_ = static_cast<char*>(map);
+    map_size_ = region_size + huge_page_size;
+    region_ = reinterpret_cast<char*>(((reinterpret_cast<size_t>(map_) + huge_page_size - 1)
+                                       / huge_page_size) * huge_page_size);
+#ifdef MADV_HUGEPAGE
+    madvise(region_, region_size, MADV_HUGEPAGE);
+#endif
+  }
+
+  // Pre-fault
+  long page_size = sysconf(_SC_PAGESIZE);
+  for(size_t i = 0; i < region_size; i += page_size)
+  {
+    region_[i] = 0;
+  }
+
+  for(size_t i = slot_count; i > 0; i--)
+  {
+    free_slots_.push_back(i - 1);
+  }
+}
+
+huge_page_arena::~huge_page_arena()
+{
+  if(map_ != 0)
+  {
+    munmap(map_, map_size_);
+  }
+}
+
+shared_huge_page_arena huge_page_arena::create(size_t slot_size, size_t slot_count)
+{
+  return shared_huge_page_arena(new huge_page_arena(slot_size, slot_count));
+}
+
+shared_buffer huge_page_arena::allocate(size_t size, size_t headroom)
+{
+  size_t slot = 0;
+  bool found = false;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stats_.allocations++;
+    if(size + headroom <= slot_size_ && !free_slots_.empty())
+    {
+      slot = free_slots_.back();
+      free_slots_.pop_back();
+      found = true;
+    }
+    else
+    {
+      stats_.fallbacks++;
+    }
+  }
+
+  if(!found)
+  {
+    return chain_buffer::create(size, headroom);
+  }
+
+  boost::shared_ptr<huge_page_buffer> buffer =
+    boost::allocate_shared<huge_page_buffer>(pool_allocator<huge_page_buffer>(),
+                                             shared_from_this(),
+                                             region_ + slot * slot_size_,
+                                             slot_size_,
+                                             slot);
+  buffer->reserve_headroom(headroom);
+  return buffer;
+}
+
+void huge_page_arena::release(size_t slot)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  free_slots_.push_back(slot);
+}
+
+huge_page_arena::statistics huge_page_arena::stats()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  statistics result = stats_;
+  result.free_slots = free_slots_.size();
+  return result;
+}
+
+}
+}
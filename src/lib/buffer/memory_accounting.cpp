@@ -0,0 +1,159 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/buffer/memory_accounting.hpp>
+#include <darc/buffer/buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/pool_allocator.hpp>
+
+#include <boost/ref.hpp>
+#include <boost/make_shared.hpp>
+
+namespace darc
+{
+namespace buffer
+{
+
+namespace
+{
+
+struct charged_data
+{
+  shared_buffer data;
+  memory_accounting::counters& c;
+  size_t bytes;
+
+  charged_data(const shared_buffer& data, memory_accounting::counters& c, size_t bytes) :
+    data(data),
+    c(c),
+    bytes(bytes)
+  {
+    c.add(bytes);
+    c.buffers++;
+  }
+
+  ~charged_data()
+  {
+    c.remove(bytes);
+    c.buffers--;
+  }
+};
+
+}
+
+memory_accounting::counters& memory_accounting::get(const memory_tag& tag)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  counter_map_type::iterator item = counters_.find(tag);
+  if(item != counters_.end())
+  {
+    return *item->second;
+  }
+  counters * c = new counters();
+  counters_.insert(counter_map_type::value_type(tag, c));
+  return *c;
+}
+
+shared_buffer memory_accounting::charge(const memory_tag& tag, const shared_buffer& data, size_t bytes)
+{
+  return charge(get(tag), data, bytes);
+}
+
+shared_buffer memory_accounting::charge(counters& c, const shared_buffer& data, size_t bytes)
+{
+  boost::shared_ptr<charged_data> charged =
+    boost::allocate_shared<charged_data>(pool_allocator<charged_data>(),
+                                         data,
+                                         boost::ref(c),
+                                         bytes);
+  // Points at the same buffer, but shares ownership with the charge
+  return shared_buffer(charged, data.get());
+}
+
+void memory_accounting::entries(entry_list_type& list)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  for(counter_map_type::iterator it = counters_.begin();
+      it != counters_.end();
+      it++)
+  {
+    entry e(it->first);
+    e.live = it->second->live;
+    e.peak = it->second->peak;
+    e.buffers = it->second->buffers;
+    list.push_back(e);
+  }
+}
+
+void memory_accounting::dump(std::ostream& os)
+{
+  entry_list_type list;
+  entries(list);
+  os << "service tag peer live_bytes peak_bytes live_buffers" << std::endl;
+  for(entry_list_type::iterator it = list.begin();
+      it != list.end();
+      it++)
+  {
+    os << it->tag.service << " "
+       << it->tag.tag.short_string() << " "
+       << it->tag.peer.short_string() << " "
+       << it->live << " "
+       << it->peak << " "
+       << it->buffers << std::endl;
+  }
+}
+
+memory_accounting& memory_accounting::instance()
+{
+  static memory_accounting * instance_ = new memory_accounting();
+  return *instance_;
+}
+
+shared_buffer accounting_allocator::allocate(size_t size, size_t headroom)
+{
+  shared_buffer data;
+  if(allocator_ != 0)
+  {
+    data = allocator_->allocate(size, headroom);
+  }
+  else
+  {
+    shared_chain_buffer chain = chain_buffer::create(size, headroom);
+    chain->charge_growth(counters_, size + headroom);
+    data = chain;
+  }
+  return memory_accounting::instance().charge(counters_, data, size + headroom);
+}
+
+}
+}
@@ -0,0 +1,168 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#ifdef __linux__
+
+#include <darc/buffer/shm_buffer.hpp>
+
+#include <boost/make_shared.hpp>
+
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+namespace darc
+{
+namespace buffer
+{
+
+namespace
+{
+
+int open_anonymous_file()
+{
+  int fd = -1;
+#ifdef SYS_memfd_create
+  fd = syscall(SYS_memfd_create, "darc", 1 /* MFD_CLOEXEC */);
+  if(fd >= 0 || errno != ENOSYS)
+  {
+    return fd;
+  }
+#endif
+  // Older kernels: named posix shm, unlinked right away
+  char name[64];
+  static int counter = 0;
+  snprintf(name, sizeof(name), "/darc-%d-%d", getpid(), __sync_fetch_and_add(&counter, 1));
+  fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+  if(fd >= 0)
+  {
+    shm_unlink(name);
+  }
+  return fd;
+}
+
+void throw_errno(const char * operation)
+{
+  throw shm_exception()
+    << shm_exception::operation(operation)
+    << shm_exception::error_number(errno);
+}
+
+}
+
+shm_buffer::shm_buffer(int fd, char * map, size_t capacity, size_t data_size) :
+  raw_buffer(map, capacity, data_size),
+  fd_(fd),
+  map_(map),
+  capacity_(capacity)
+{
+}
+
+shm_buffer::~shm_buffer()
+{
+  munmap(map_, capacity_);
+  close(fd_);
+}
+
+shared_shm_buffer shm_buffer::create(size_t size)
+{
+  // Whole pages, and never an empty mapping
+  long page_size = sysconf(_SC_PAGESIZE);
+  size_t capacity = ((size + page_size - 1) / page_size) * page_size;
+  if(capacity == 0)
+  {
+    capacity = page_size;
+  }
+
+  int fd = open_anonymous_file();
+  if(fd < 0)
+  {
+    throw_errno("memfd_create");
+  }
+
+  if(ftruncate(fd, capacity) != 0)
+  {
+    close(fd);
+    throw_errno("ftruncate");
+  }
+
+  void * map = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if(map == MAP_FAILED)
+  {
+    close(fd);
+    throw_errno("mmap");
+  }
+
+  return boost::make_shared<shm_buffer>(fd, static_cast<char*>(map), capacity, 0);
+}
+
+shared_shm_buffer shm_buffer::map(int fd, size_t data_size)
+{
+  struct stat st;
+  if(fstat(fd, &st) != 0)
+  {
+    throw_errno("fstat");
+  }
+  size_t capacity = st.st_size;
+  if(data_size > capacity)
+  {
+    // The size comes from the peer that sent the fd
+    throw shm_exception()
+      << shm_exception::operation("map")
+      << shm_exception::error_number(EINVAL);
+  }
+
+  int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if(own_fd < 0)
+  {
+    throw_errno("dup");
+  }
+
+  void * map = mmap(0, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, own_fd, 0);
+  if(map == MAP_FAILED)
+  {
+    close(own_fd);
+    throw_errno("mmap");
+  }
+
+  return boost::make_shared<shm_buffer>(own_fd, static_cast<char*>(map), capacity, data_size);
+}
+
+}
+}
+
+#endif
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/compression/compression_stage.hpp>
+#include <darc/compression/compression_header_packet.hpp>
+#include <darc/compression/flatten.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/network/inbound_data.hpp>
+#include <cassert>
+#include <vector>
+
+namespace darc
+{
+namespace compression
+{
+
+compression_stage::compression_stage(const compression_config& config) :
+  config_(config),
+  backoff_left_(0)
+{
+}
+
+void compression_stage::configure(const compression_config& config)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  config_ = config;
+  backoff_left_ = 0;
+}
+
+compression_config compression_stage::config()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return config_;
+}
+
+compression_stats compression_stage::stats()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_;
+}
+
+bool compression_stage::compress(const outbound_data_base& msg, darc::buffer::shared_buffer& out)
+{
+  // Without a cheap size hint the threshold is checked on the packed message,
+  // rather than on a dry run of the serialization
+  size_t size = msg.size_hint();
+  darc::buffer::shared_buffer packed;
+  if(size == 0)
+  {
+    packed = darc::buffer::chain_buffer::create(darc::buffer::chain_buffer::default_chunk_size, 0);
+    msg.pack(packed);
+    size = packed->len();
+  }
+
+  compression_config config;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stats_.messages++;
+    if(config_.codec_id == codec::none || size < config_.threshold)
+    {
+      stats_.below_threshold += config_.codec_id == codec::none ? 0 : 1;
+      out = packed;
+      return false;
+    }
+    if(backoff_left_ > 0)
+    {
+      backoff_left_--;
+      stats_.backed_off++;
+      out = packed;
+      return false;
+    }
+    config = config_;
+  }
+
+  const codec * c = codec::get(config.codec_id);
+  assert(c != 0);
+
+  if(packed.get() == 0)
+  {
+    packed = darc::buffer::chain_buffer::create(size, 0);
+    msg.pack(packed);
+  }
+
+  std::vector<char> storage;
+  const char * src = 0;
+  size_t src_len = flatten(packed, storage, src);
+
+  size_t header_size = serializer::raw_layout<compression_header_packet>::size;
+  darc::buffer::shared_buffer compressed = darc::buffer::chain_buffer::create(0, 0);
+  char * dst = compressed->prepare(header_size + c->bound(src_len));
+  size_t compressed_len = c->compress(src, src_len, dst + header_size);
+
+  bool poor = compressed_len == 0 ||
+    (double)src_len < config.min_ratio * compressed_len;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if(poor)
+    {
+      stats_.poor_ratio++;
+      if(config.adaptive)
+      {
+        backoff_left_ = config.backoff;
+      }
+    }
+    else
+    {
+      stats_.compressed++;
+      stats_.bytes_in += src_len;
+      stats_.bytes_out += compressed_len;
+    }
+  }
+
+  if(poor)
+  {
+    out = packed;
+    return false;
+  }
+
+  compression_header_packet header;
+  header.codec = c->id();
+  header.original_size = src_len;
+  serializer::raw_oarchive oarchive(dst);
+  header.serialize(oarchive, 0);
+  compressed->commit(header_size + compressed_len);
+
+  out = compressed;
+  return true;
+}
+
+darc::buffer::shared_buffer compression_stage::decompress(darc::buffer::shared_buffer data)
+{
+  if(data->len() < serializer::raw_layout<compression_header_packet>::size)
+  {
+    return darc::buffer::shared_buffer();
+  }
+  inbound_data<serializer::raw_serializer, compression_header_packet> header_i(data);
+
+  const codec * c = codec::get(header_i.get().codec);
+  size_t original_size = header_i.get().original_size;
+  if(c == 0 || original_size > max_original_size)
+  {
+    return darc::buffer::shared_buffer();
+  }
+
+  std::vector<char> storage;
+  const char * src = 0;
+  size_t src_len = flatten(data, storage, src);
+
+  darc::buffer::shared_buffer expanded = darc::buffer::chain_buffer::create(0, 0);
+  char * dst = original_size == 0 ? 0 : expanded->prepare(original_size);
+  if(!c->decompress(src, src_len, dst, original_size))
+  {
+    return darc::buffer::shared_buffer();
+  }
+  expanded->commit(original_size);
+  return expanded;
+}
+
+}
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/compression/delta_stage.hpp>
+#include <darc/compression/delta_header_packet.hpp>
+#include <darc/compression/flatten.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <cstring>
+
+namespace darc
+{
+namespace compression
+{
+
+namespace
+{
+
+// Shorter runs of unchanged bytes are cheaper to send as changed
+const size_t min_skip = 4;
+
+const size_t header_size = serializer::raw_layout<delta_header_packet>::size;
+
+void write_varint(std::vector<char>& out, size_t value)
+{
+  while(value >= 0x80)
+  {
+    out.push_back((char)(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back((char)value);
+}
+
+bool read_varint(const uint8_t *& ip, const uint8_t * iend, size_t& value)
+{
+  value = 0;
+  for(size_t shift = 0; shift < 64; shift += 7)
+  {
+    if(ip == iend)
+    {
+      return false;
+    }
+    uint8_t byte = *ip++;
+    value |= (size_t)(byte & 0x7f) << shift;
+    if((byte & 0x80) == 0)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+darc::buffer::shared_buffer make_payload(const delta_header_packet& header, const char * data, size_t len)
+{
+  darc::buffer::shared_buffer out = darc::buffer::chain_buffer::create(0, 0);
+  char * dst = out->prepare(header_size + len);
+  serializer::raw_oarchive oarchive(dst);
+  const_cast<delta_header_packet&>(header).serialize(oarchive, 0);
+  if(len > 0)
+  {
+    memcpy(dst + header_size, data, len);
+  }
+  out->commit(header_size + len);
+  return out;
+}
+
+}
+
+void delta_encode(const char * prev, const char * cur, size_t len, std::vector<char>& out)
+{
+  size_t i = 0;
+  while(i < len)
+  {
+    size_t skip_begin = i;
+    while(i < len && prev[i] == cur[i])
+    {
+      i++;
+    }
+    if(i == len)
+    {
+      break; // the rest is unchanged
+    }
+
+    size_t changed_begin = i;
+    while(i < len)
+    {
+      if(prev[i] != cur[i])
+      {
+        i++;
+        continue;
+      }
+      size_t run = 0;
+      while(i + run < len && run < min_skip && prev[i + run] == cur[i + run])
+      {
+        run++;
+      }
+      if(run >= min_skip || i + run == len)
+      {
+        break;
+      }
+      i += run;
+    }
+
+    write_varint(out, changed_begin - skip_begin);
+    write_varint(out, i - changed_begin);
+    for(size_t n = changed_begin; n < i; n++)
+    {
+      out.push_back(prev[n] ^ cur[n]);
+    }
+  }
+}
+
+bool delta_apply(const char * delta, size_t delta_len, char * data, size_t len)
+{
+  const uint8_t * ip = (const uint8_t *)delta;
+  const uint8_t * iend = ip + delta_len;
+  size_t pos = 0;
+  while(ip < iend)
+  {
+    size_t skip;
+    size_t changed;
+    if(!read_varint(ip, iend, skip) || !read_varint(ip, iend, changed))
+    {
+      return false;
+    }
+    if(skip > len - pos || changed > len - pos - skip || changed > (size_t)(iend - ip))
+    {
+      return false;
+    }
+    pos += skip;
+    for(size_t n = 0; n < changed; n++)
+    {
+      data[pos++] ^= *ip++;
+    }
+  }
+  return true;
+}
+
+delta_encoder::delta_encoder(const delta_config& config) :
+  config_(config),
+  sequence_(0),
+  since_keyframe_(0),
+  keyframe_requested_(true)
+{
+}
+
+void delta_encoder::configure(const delta_config& config)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  config_ = config;
+  keyframe_requested_ = true;
+}
+
+delta_stats delta_encoder::stats()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return stats_;
+}
+
+void delta_encoder::request_keyframe()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  keyframe_requested_ = true;
+  stats_.keyframe_requests++;
+}
+
+darc::buffer::shared_buffer delta_encoder::encode(const outbound_data_base& msg)
+{
+  size_t hint = msg.size_hint();
+  darc::buffer::shared_buffer packed =
+    darc::buffer::chain_buffer::create(hint != 0 ? hint : darc::buffer::chain_buffer::default_chunk_size, 0);
+  msg.pack(packed);
+
+  std::vector<char> storage;
+  const char * cur = 0;
+  size_t len = flatten(packed, storage, cur);
+
+  // Held until last_ is updated, so deltas follow sequence order
+  boost::mutex::scoped_lock lock(mutex_);
+
+  bool keyframe = keyframe_requested_ ||
+    since_keyframe_ + 1 >= config_.keyframe_interval ||
+    len == 0 ||
+    len != last_.size();
+
+  std::vector<char> delta;
+  if(!keyframe)
+  {
+    delta_encode(&last_[0], cur, len, delta);
+    keyframe = delta.size() >= len;
+  }
+
+  delta_header_packet header;
+  header.sequence = ++sequence_;
+  header.size = len;
+
+  darc::buffer::shared_buffer out;
+  if(keyframe)
+  {
+    header.flags = delta_header_packet::keyframe;
+    out = make_payload(header, cur, len);
+    keyframe_requested_ = false;
+    since_keyframe_ = 0;
+    stats_.keyframes++;
+    stats_.bytes_out += len;
+  }
+  else
+  {
+    out = make_payload(header, delta.empty() ? 0 : &delta[0], delta.size());
+    since_keyframe_++;
+    stats_.bytes_out += delta.size();
+  }
+  stats_.messages++;
+  stats_.bytes_in += len;
+
+  last_.assign(cur, cur + len);
+  return out;
+}
+
+delta_decoder::delta_decoder() :
+  sequence_(0),
+  valid_(false),
+  keyframe_requested_(false)
+{
+}
+
+darc::buffer::shared_buffer delta_decoder::decode(darc::buffer::shared_buffer data, bool& request_keyframe)
+{
+  request_keyframe = false;
+
+  std::vector<char> storage;
+  const char * src = 0;
+  size_t src_len = flatten(data, storage, src);
+  if(src_len < header_size)
+  {
+    return darc::buffer::shared_buffer();
+  }
+
+  delta_header_packet header;
+  serializer::raw_iarchive iarchive(src);
+  header.serialize(iarchive, 0);
+  src += header_size;
+  src_len -= header_size;
+
+  if(header.flags & delta_header_packet::keyframe)
+  {
+    if(src_len != header.size)
+    {
+      return darc::buffer::shared_buffer();
+    }
+    last_.assign(src, src + src_len);
+    valid_ = true;
+    keyframe_requested_ = false;
+  }
+  else if(!valid_ ||
+          header.sequence != sequence_ + 1 ||
+          header.size != last_.size() ||
+          !delta_apply(src, src_len, last_.empty() ? 0 : &last_[0], last_.size()))
+  {
+    // Lost or out of order, wait for the next keyframe
+    valid_ = false;
+    request_keyframe = !keyframe_requested_;
+    keyframe_requested_ = true;
+    return darc::buffer::shared_buffer();
+  }
+  sequence_ = header.sequence;
+
+  darc::buffer::shared_buffer out = darc::buffer::chain_buffer::create(0, 0);
+  if(!last_.empty())
+  {
+    memcpy(out->prepare(last_.size()), &last_[0], last_.size());
+    out->commit(last_.size());
+  }
+  return out;
+}
+
+}
+}
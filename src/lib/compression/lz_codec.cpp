@@ -0,0 +1,231 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/compression/lz_codec.hpp>
+#include <cstring>
+
+namespace darc
+{
+namespace compression
+{
+
+namespace
+{
+
+const size_t min_match = 4;
+const size_t max_offset = 65535;
+const int hash_bits = 12;
+
+inline uint32_t read32(const uint8_t * p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+inline size_t hash(uint32_t sequence)
+{
+  return (sequence * 2654435761U) >> (32 - hash_bits);
+}
+
+inline uint8_t * write_length(uint8_t * op, size_t length)
+{
+  for(; length >= 255; length -= 255)
+  {
+    *op++ = 255;
+  }
+  *op++ = (uint8_t)length;
+  return op;
+}
+
+uint8_t * write_sequence(uint8_t * op,
+                         const uint8_t * literals, size_t literal_len,
+                         size_t offset, size_t match_len)
+{
+  uint8_t * token = op++;
+  *token = (uint8_t)((literal_len < 15 ? literal_len : 15) << 4);
+  if(literal_len >= 15)
+  {
+    op = write_length(op, literal_len - 15);
+  }
+  memcpy(op, literals, literal_len);
+  op += literal_len;
+
+  if(match_len == 0)
+  {
+    return op; // last sequence
+  }
+
+  *op++ = (uint8_t)offset;
+  *op++ = (uint8_t)(offset >> 8);
+  size_t code = match_len - min_match;
+  *token |= (uint8_t)(code < 15 ? code : 15);
+  if(code >= 15)
+  {
+    op = write_length(op, code - 15);
+  }
+  return op;
+}
+
+// Returns false when the input ends in the middle of a length
+inline bool read_length(const uint8_t *& ip, const uint8_t * iend, size_t& length)
+{
+  uint8_t byte;
+  do
+  {
+    if(ip == iend)
+    {
+      return false;
+    }
+    byte = *ip++;
+    length += byte;
+  }
+  while(byte == 255);
+  return true;
+}
+
+}
+
+size_t lz_codec::compress(const char * src, size_t len, char * dst) const
+{
+  const uint8_t * base = (const uint8_t *)src;
+  uint8_t * op = (uint8_t *)dst;
+
+  // positions + 1, so 0 means empty
+  uint32_t table[1 << hash_bits];
+  memset(table, 0, sizeof(table));
+
+  size_t anchor = 0;
+  size_t i = 0;
+  while(i + min_match <= len)
+  {
+    uint32_t sequence = read32(base + i);
+    size_t h = hash(sequence);
+    size_t ref = table[h];
+    table[h] = (uint32_t)(i + 1);
+
+    if(ref != 0 && i - (ref - 1) <= max_offset && read32(base + ref - 1) == sequence)
+    {
+      ref--;
+      size_t match_len = min_match;
+      while(i + match_len < len && base[ref + match_len] == base[i + match_len])
+      {
+        match_len++;
+      }
+      op = write_sequence(op, base + anchor, i - anchor, i - ref, match_len);
+      i += match_len;
+      anchor = i;
+    }
+    else
+    {
+      i++;
+    }
+  }
+
+  op = write_sequence(op, base + anchor, len - anchor, 0, 0);
+  return op - (uint8_t *)dst;
+}
+
+bool lz_codec::decompress(const char * src, size_t len, char * dst, size_t dst_len) const
+{
+  const uint8_t * ip = (const uint8_t *)src;
+  const uint8_t * iend = ip + len;
+  uint8_t * op = (uint8_t *)dst;
+  uint8_t * const ostart = op;
+  uint8_t * const oend = op + dst_len;
+
+  while(ip < iend)
+  {
+    uint8_t token = *ip++;
+
+    size_t literal_len = token >> 4;
+    if(literal_len == 15 && !read_length(ip, iend, literal_len))
+    {
+      return false;
+    }
+    if(literal_len > (size_t)(iend - ip) || literal_len > (size_t)(oend - op))
+    {
+      return false;
+    }
+    memcpy(op, ip, literal_len);
+    ip += literal_len;
+    op += literal_len;
+
+    if(ip == iend)
+    {
+      break; // last sequence
+    }
+
+    if(iend - ip < 2)
+    {
+      return false;
+    }
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    if(offset == 0 || offset > (size_t)(op - ostart))
+    {
+      return false;
+    }
+
+    size_t match_len = token & 15;
+    if(match_len == 15 && !read_length(ip, iend, match_len))
+    {
+      return false;
+    }
+    match_len += min_match;
+    if(match_len > (size_t)(oend - op))
+    {
+      return false;
+    }
+
+    const uint8_t * match = op - offset;
+    if(offset >= match_len)
+    {
+      memcpy(op, match, match_len);
+      op += match_len;
+    }
+    else
+    {
+      // overlapping, repeats the last offset bytes
+      for(size_t n = 0; n < match_len; n++)
+      {
+        *op++ = *match++;
+      }
+    }
+  }
+
+  return op == oend;
+}
+
+}
+}
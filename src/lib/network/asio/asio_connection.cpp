@@ -0,0 +1,397 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/asio/asio_connection.hpp>
+#include <darc/network/asio/asio_protocol_manager.hpp>
+
+#include <boost/bind.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/serializer/raw.hpp>
+#include <darc/id_arg.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace asio_tcp
+{
+
+namespace
+{
+
+const uint64_t hello_magic = 0x6f6c6c6568706374ULL; // "tcphello"
+const size_t hello_size = 8 + 16; // magic, peer id
+const size_t length_size = 4;
+
+size_t read_length(const char * p)
+{
+  uint32_t length;
+  darc::serializer::raw_iarchive iarchive(p);
+  iarchive & length;
+  return length;
+}
+
+}
+
+asio_connection::asio_connection(shared_asio_manager_ref manager,
+                                 boost::asio::io_service& io_service,
+                                 const ID& local_peer_id,
+                                 const asio_socket_options& options) :
+  manager_(manager),
+  outbound_id_(ID::create()),
+  remote_peer_id_(ID::null()),
+  socket_(io_service),
+  options_(options),
+  reconnect_(false),
+  closed_(false),
+  writing_(false),
+  hello_(hello_size),
+  dropped_(0),
+  hello_received_(false),
+  chunk_begin_(0),
+  chunk_end_(0),
+  frame_size_(0)
+{
+  darc::serializer::raw_oarchive oarchive(&hello_[0]);
+  oarchive & hello_magic;
+  oarchive & local_peer_id;
+}
+
+void asio_connection::configure()
+{
+  // Best effort, the connection works without
+  boost::system::error_code error;
+  socket_.set_option(boost::asio::ip::tcp::no_delay(options_.no_delay), error);
+  if(options_.send_buffer_size > 0)
+  {
+    socket_.set_option(boost::asio::socket_base::send_buffer_size(options_.send_buffer_size), error);
+  }
+  if(options_.receive_buffer_size > 0)
+  {
+    socket_.set_option(boost::asio::socket_base::receive_buffer_size(options_.receive_buffer_size), error);
+  }
+}
+
+void asio_connection::start()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    configure();
+    write(); // the hello
+  }
+  read();
+}
+
+bool asio_connection::send(buffer::shared_buffer data)
+{
+  buffer::buffer::segment_list_type segments;
+  data->segments(segments);
+  size_t size = 0;
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    size += boost::asio::buffer_size(*it);
+  }
+  if(size > max_frame_size)
+  {
+    slog<iris::Warning>("asio+tcp: dropped frame, too large",
+                        "size", iris::arg<int>(size));
+    return false;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if(closed_)
+  {
+    return false;
+  }
+  if(write_queue_.size() >= max_queued_frames)
+  {
+    dropped_++;
+    slog<iris::Warning>("asio+tcp: dropped frame, too many queued",
+                        "Out-ID", iris::arg<ID>(outbound_id_));
+    return false;
+  }
+
+  write_queue_.push_back(data);
+  if(!writing_)
+  {
+    write();
+  }
+  return true;
+}
+
+void asio_connection::close()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  closed_ = true;
+  boost::system::error_code error;
+  socket_.close(error);
+}
+
+uint64_t asio_connection::dropped()
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  return dropped_;
+}
+
+void asio_connection::read()
+{
+  // A frame begun in this chunk must fit in it, see parse() for larger ones
+  size_t pending = chunk_end_ - chunk_begin_;
+  bool partial_fits = !hello_received_ ||
+    pending < length_size ||
+    chunk_begin_ + length_size + read_length(chunk_->data() + chunk_begin_) <= read_chunk_size;
+
+  if(!chunk_ || read_chunk_size - chunk_end_ < min_read_size || !partial_fits)
+  {
+    // Slices of the old chunk may still be in use, so it is left as it is
+    buffer::shared_buffer chunk = buffer::pooled_buffer::create(read_chunk_size);
+    if(pending > 0)
+    {
+      memcpy(chunk->data(), chunk_->data() + chunk_begin_, pending);
+    }
+    chunk_ = chunk;
+    chunk_begin_ = 0;
+    chunk_end_ = pending;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  if(closed_)
+  {
+    return;
+  }
+  socket_.async_read_some(boost::asio::buffer(chunk_->data() + chunk_end_, read_chunk_size - chunk_end_),
+                          boost::bind(&asio_connection::handle_read, shared_from_this(), _1, _2));
+}
+
+void asio_connection::handle_read(const boost::system::error_code& error, size_t size)
+{
+  boost::shared_lock<boost::shared_mutex> ref_lock(manager_->mutex);
+  if(manager_->manager == 0)
+  {
+    return;
+  }
+  if(error)
+  {
+    failed(error);
+    return;
+  }
+
+  chunk_end_ += size;
+  if(parse())
+  {
+    read();
+  }
+}
+
+bool asio_connection::parse()
+{
+  char * data = chunk_->data();
+
+  if(!hello_received_)
+  {
+    if(chunk_end_ - chunk_begin_ < hello_size)
+    {
+      return true;
+    }
+
+    uint64_t magic;
+    darc::serializer::raw_iarchive iarchive(data + chunk_begin_);
+    iarchive & magic;
+    iarchive & remote_peer_id_;
+    if(magic != hello_magic)
+    {
+      slog<iris::Warning>("asio+tcp: not a darc peer",
+                          "Out-ID", iris::arg<ID>(outbound_id_));
+      failed(boost::asio::error::invalid_argument);
+      return false;
+    }
+    hello_received_ = true;
+    chunk_begin_ += hello_size;
+  }
+
+  while(chunk_end_ - chunk_begin_ >= length_size)
+  {
+    size_t size = read_length(data + chunk_begin_);
+    size_t available = chunk_end_ - chunk_begin_ - length_size;
+    if(size > max_frame_size)
+    {
+      slog<iris::Warning>("asio+tcp: frame too large",
+                          "Out-ID", iris::arg<ID>(outbound_id_),
+                          "size", iris::arg<int>(size));
+      failed(boost::asio::error::message_size);
+      return false;
+    }
+
+    if(available >= size)
+    {
+      buffer::shared_buffer frame = buffer::slice_buffer::create(chunk_, chunk_begin_ + length_size, size);
+      chunk_begin_ += length_size + size;
+      manager_->manager->packet_received(frame);
+      continue;
+    }
+
+    if(length_size + size > read_chunk_size)
+    {
+      // The rest goes directly where it is to be read from
+      frame_ = buffer::pooled_buffer::create(size);
+      frame_size_ = size;
+      memcpy(frame_->data(), data + chunk_begin_ + length_size, available);
+      chunk_begin_ = chunk_end_;
+
+      boost::mutex::scoped_lock lock(mutex_);
+      if(!closed_)
+      {
+        boost::asio::async_read(socket_,
+                                boost::asio::buffer(frame_->data() + available, size - available),
+                                boost::bind(&asio_connection::handle_frame_read, shared_from_this(), _1, _2));
+      }
+      return false;
+    }
+    break;
+  }
+  return true;
+}
+
+void asio_connection::handle_frame_read(const boost::system::error_code& error, size_t size)
+{
+  boost::shared_lock<boost::shared_mutex> ref_lock(manager_->mutex);
+  if(manager_->manager == 0)
+  {
+    return;
+  }
+  if(error)
+  {
+    failed(error);
+    return;
+  }
+
+  buffer::shared_buffer frame;
+  frame.swap(frame_);
+  frame->commit(frame_size_);
+  manager_->manager->packet_received(frame);
+  read();
+}
+
+void asio_connection::write()
+{
+  write_frames_.clear();
+  write_buffers_.clear();
+  if(!hello_.empty())
+  {
+    write_buffers_.push_back(boost::asio::buffer(hello_));
+  }
+
+  size_t count = std::min(write_queue_.size(), max_write_frames);
+  write_headers_.resize(count * length_size);
+  for(size_t i = 0; i < count; i++)
+  {
+    buffer::shared_buffer frame = write_queue_.front();
+    write_queue_.pop_front();
+
+    // The length goes in front of the segments once they are counted
+    size_t first = write_buffers_.size();
+    write_buffers_.push_back(boost::asio::const_buffer());
+    frame->segments(write_buffers_);
+    size_t size = 0;
+    for(size_t j = first + 1; j < write_buffers_.size(); j++)
+    {
+      size += boost::asio::buffer_size(write_buffers_[j]);
+    }
+
+    char * length = &write_headers_[i * length_size];
+    darc::serializer::raw_oarchive oarchive(length);
+    oarchive & static_cast<uint32_t>(size);
+    write_buffers_[first] = boost::asio::buffer(length, length_size);
+
+    write_frames_.push_back(frame);
+  }
+
+  if(write_buffers_.empty())
+  {
+    return;
+  }
+  writing_ = true;
+  boost::asio::async_write(socket_,
+                           write_buffers_,
+                           boost::bind(&asio_connection::handle_write, shared_from_this(), _1, _2));
+}
+
+void asio_connection::handle_write(const boost::system::error_code& error, size_t size)
+{
+  boost::shared_lock<boost::shared_mutex> ref_lock(manager_->mutex);
+  if(manager_->manager == 0)
+  {
+    return;
+  }
+  if(error)
+  {
+    failed(error);
+    return;
+  }
+
+  boost::mutex::scoped_lock lock(mutex_);
+  writing_ = false;
+  hello_.clear();
+  write_frames_.clear();
+  if(!closed_ && !write_queue_.empty())
+  {
+    write();
+  }
+}
+
+void asio_connection::failed(const boost::system::error_code& error)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if(closed_)
+    {
+      return;
+    }
+    closed_ = true;
+    boost::system::error_code ignored;
+    socket_.close(ignored);
+  }
+
+  slog<iris::Info>("asio+tcp connection closed",
+                   "Out-ID", iris::arg<ID>(outbound_id_),
+                   "reason", iris::arg<std::string>(error.message()));
+  manager_->manager->connection_closed(shared_from_this());
+}
+
+}
+}
+}
@@ -0,0 +1,422 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/asio/asio_protocol_manager.hpp>
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/regex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <darc/network/network_manager.hpp>
+#include <darc/network/address_in_use_exception.hpp>
+#include <darc/network/invalid_url_exception.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace asio_tcp
+{
+
+namespace
+{
+
+int url_number(const std::string& value, int min, int max)
+{
+  try
+  {
+    int number = boost::lexical_cast<int>(value);
+    if(number >= min && number <= max)
+    {
+      return number;
+    }
+  }
+  catch(boost::bad_lexical_cast&)
+  {
+  }
+  throw invalid_url_exception() << invalid_url_exception::problem("Invalid number: " + value);
+}
+
+// "host:port[?nodelay=0|1&sndbuf=bytes&rcvbuf=bytes]", IPv6 addresses in [],
+// "*" for any address
+boost::asio::ip::tcp::endpoint parse_url(boost::asio::io_service& io_service,
+                                         const std::string& url,
+                                         asio_socket_options& options)
+{
+  boost::smatch what;
+  if(!boost::regex_match(url, what, boost::regex("^(\\[([^\\]]+)\\]|([^:\\[\\]?]+)):([0-9]+)(\\?(.*))?$")))
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Expected host:port");
+  }
+
+  std::string options_string = what[6];
+  boost::sregex_token_iterator end;
+  for(boost::sregex_token_iterator it(options_string.begin(), options_string.end(), boost::regex("&"), -1);
+      it != end;
+      it++)
+  {
+    boost::smatch option;
+    std::string item = *it;
+    if(!boost::regex_match(item, option, boost::regex("^([a-z]+)=(.+)$")))
+    {
+      throw invalid_url_exception() << invalid_url_exception::problem("Invalid option: " + item);
+    }
+
+    if(option[1] == "nodelay")
+    {
+      options.no_delay = url_number(option[2], 0, 1) != 0;
+    }
+    else if(option[1] == "sndbuf")
+    {
+      options.send_buffer_size = url_number(option[2], 1, 1 << 30);
+    }
+    else if(option[1] == "rcvbuf")
+    {
+      options.receive_buffer_size = url_number(option[2], 1, 1 << 30);
+    }
+    else
+    {
+      throw invalid_url_exception() << invalid_url_exception::problem("Unknown option: " + item);
+    }
+  }
+
+  std::string host = what[2].matched ? what[2] : what[3];
+  int port = url_number(what[4], 0, 65535);
+  if(host == "*")
+  {
+    return boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port);
+  }
+
+  boost::asio::ip::tcp::resolver resolver(io_service);
+  boost::asio::ip::tcp::resolver::query query(host,
+                                              what[4],
+                                              boost::asio::ip::tcp::resolver::query::numeric_service);
+  boost::system::error_code error;
+  boost::asio::ip::tcp::resolver::iterator item = resolver.resolve(query, error);
+  if(error || item == boost::asio::ip::tcp::resolver::iterator())
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Could not resolve " + host);
+  }
+  return *item;
+}
+
+}
+
+asio_protocol_manager::asio_protocol_manager(class network_manager * manager,
+                                             peer& p,
+                                             boost::asio::io_service& io_service):
+  network::protocol_manager_base(),
+  network::inbound_link_base(manager, p),
+  peer_(p),
+  io_service_(io_service),
+  ref_(boost::make_shared<asio_manager_ref>(this))
+{
+}
+
+asio_protocol_manager::~asio_protocol_manager()
+{
+  {
+    boost::unique_lock<boost::shared_mutex> lock(ref_->mutex);
+    ref_->manager = 0;
+  }
+
+  // No handler is in the manager now, and none will get in. Their
+  // operations are aborted, and the handlers run whenever the io_service
+  // does.
+  boost::system::error_code error;
+  for(acceptor_list_type::iterator it = acceptor_list_.begin(); it != acceptor_list_.end(); it++)
+  {
+    (*it)->close(error);
+  }
+  for(timer_list_type::iterator it = timer_list_.begin(); it != timer_list_.end(); it++)
+  {
+    (*it)->cancel(error);
+  }
+  for(pending_list_type::iterator it = pending_list_.begin(); it != pending_list_.end(); it++)
+  {
+    (*it)->close();
+  }
+  for(connection_list_type::iterator it = connection_list_.begin(); it != connection_list_.end(); it++)
+  {
+    it->second->close();
+  }
+}
+
+void asio_protocol_manager::send_frame(const darc::ID& outbound_id,
+                                       const ID& topic_peer_id,
+                                       buffer::shared_buffer data)
+{
+  shared_asio_connection connection;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    connection_list_type::iterator item = connection_list_.find(outbound_id);
+    if(item != connection_list_.end())
+    {
+      connection = item->second;
+    }
+  }
+
+  if(!connection)
+  {
+    slog<iris::Warning>("Attempting to send to unknown outbound connection",
+                        "outbound id", iris::arg<ID>(outbound_id));
+    return;
+  }
+  connection->send(data);
+}
+
+void asio_protocol_manager::send_frame_to_all(const ID& topic_peer_id,
+                                              buffer::shared_buffer data)
+{
+  std::vector<shared_asio_connection> connections;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(connection_list_type::iterator it = connection_list_.begin(); it != connection_list_.end(); it++)
+    {
+      connections.push_back(it->second);
+    }
+  }
+
+  for(std::vector<shared_asio_connection>::iterator it = connections.begin(); it != connections.end(); it++)
+  {
+    (*it)->send(data);
+  }
+}
+
+void asio_protocol_manager::accept(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "asio+tcp");
+
+  asio_socket_options options;
+  boost::asio::ip::tcp::endpoint endpoint = parse_url(io_service_, url, options);
+
+  // The receive buffer size is inherited by accepted sockets, and must be
+  // set before listening to affect the window scale
+  shared_acceptor acceptor(new boost::asio::ip::tcp::acceptor(io_service_));
+  boost::system::error_code error;
+  acceptor->open(endpoint.protocol(), error);
+  if(!error)
+  {
+    acceptor->set_option(boost::asio::socket_base::reuse_address(true), error);
+  }
+  if(!error && options.receive_buffer_size > 0)
+  {
+    acceptor->set_option(boost::asio::socket_base::receive_buffer_size(options.receive_buffer_size), error);
+  }
+  if(!error)
+  {
+    acceptor->bind(endpoint, error);
+  }
+  if(!error)
+  {
+    acceptor->listen(boost::asio::socket_base::max_connections, error);
+  }
+
+  if(error == boost::asio::error::address_in_use)
+  {
+    throw address_in_use_exception() << address_in_use_exception::address(url);
+  }
+  else if(error)
+  {
+    throw boost::system::system_error(error);
+  }
+
+  slog<iris::Info>("asio+tcp accept",
+                   "url", iris::arg<std::string>(url));
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    acceptor_list_.push_back(acceptor);
+  }
+  start_accept(acceptor, options);
+}
+
+void asio_protocol_manager::connect(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "asio+tcp");
+
+  asio_socket_options options;
+  boost::asio::ip::tcp::endpoint endpoint = parse_url(io_service_, url, options);
+
+  slog<iris::Info>("asio+tcp connect",
+                   "url", iris::arg<std::string>(url));
+
+  start_connect(endpoint, options);
+}
+
+void asio_protocol_manager::start_accept(shared_acceptor acceptor, const asio_socket_options& options)
+{
+  shared_asio_connection connection =
+    boost::make_shared<asio_connection>(ref_, boost::ref(io_service_), peer_.id(), options);
+  acceptor->async_accept(connection->socket(),
+                         boost::bind(&asio_protocol_manager::handle_accept, ref_, acceptor, connection, _1));
+}
+
+void asio_protocol_manager::start_connect(const boost::asio::ip::tcp::endpoint& endpoint,
+                                          const asio_socket_options& options)
+{
+  shared_asio_connection connection =
+    boost::make_shared<asio_connection>(ref_, boost::ref(io_service_), peer_.id(), options);
+  connection->set_reconnect(endpoint);
+
+  // Buffer sizes before the handshake
+  boost::system::error_code error;
+  connection->socket().open(endpoint.protocol(), error);
+  connection->configure();
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    pending_list_.insert(connection);
+  }
+  connection->socket().async_connect(endpoint,
+                                     boost::bind(&asio_protocol_manager::handle_connect, ref_, connection, _1));
+}
+
+void asio_protocol_manager::start_reconnect(const boost::asio::ip::tcp::endpoint& endpoint,
+                                            const asio_socket_options& options)
+{
+  shared_timer timer(new boost::asio::deadline_timer(io_service_,
+                                                     boost::posix_time::milliseconds(reconnect_interval_ms)));
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    timer_list_.insert(timer);
+  }
+  timer->async_wait(boost::bind(&asio_protocol_manager::handle_reconnect, ref_, timer, endpoint, options, _1));
+}
+
+void asio_protocol_manager::connection_started(shared_asio_connection connection)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    connection_list_.insert(connection_list_type::value_type(connection->outbound_id(), connection));
+  }
+  manager_->register_connection(connection->outbound_id(), this);
+
+  connection->start();
+  sendDiscover(connection->outbound_id());
+}
+
+void asio_protocol_manager::connection_closed(shared_asio_connection connection)
+{
+  manager_->unregister_connection(connection->outbound_id());
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    connection_list_.erase(connection->outbound_id());
+  }
+
+  if(connection->remote_peer_id() != ID::null())
+  {
+    manager_->neighbour_peer_disconnected(connection->remote_peer_id(), connection->outbound_id());
+  }
+
+  if(connection->reconnect())
+  {
+    start_reconnect(connection->endpoint(), connection->options());
+  }
+}
+
+void asio_protocol_manager::handle_accept(shared_asio_manager_ref ref,
+                                          shared_acceptor acceptor,
+                                          shared_asio_connection connection,
+                                          const boost::system::error_code& error)
+{
+  boost::shared_lock<boost::shared_mutex> lock(ref->mutex);
+  if(ref->manager == 0 || error == boost::asio::error::operation_aborted)
+  {
+    return;
+  }
+
+  if(error)
+  {
+    ref->manager->slog<iris::Warning>("asio+tcp accept failed",
+                                      "error", iris::arg<std::string>(error.message()));
+  }
+  else
+  {
+    ref->manager->connection_started(connection);
+  }
+  ref->manager->start_accept(acceptor, connection->options());
+}
+
+void asio_protocol_manager::handle_connect(shared_asio_manager_ref ref,
+                                           shared_asio_connection connection,
+                                           const boost::system::error_code& error)
+{
+  boost::shared_lock<boost::shared_mutex> lock(ref->mutex);
+  if(ref->manager == 0)
+  {
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(ref->manager->mutex_);
+    ref->manager->pending_list_.erase(connection);
+  }
+
+  if(error)
+  {
+    ref->manager->start_reconnect(connection->endpoint(), connection->options());
+  }
+  else
+  {
+    ref->manager->connection_started(connection);
+  }
+}
+
+void asio_protocol_manager::handle_reconnect(shared_asio_manager_ref ref,
+                                             shared_timer timer,
+                                             boost::asio::ip::tcp::endpoint endpoint,
+                                             asio_socket_options options,
+                                             const boost::system::error_code& error)
+{
+  boost::shared_lock<boost::shared_mutex> lock(ref->mutex);
+  if(ref->manager == 0)
+  {
+    return;
+  }
+
+  {
+    boost::mutex::scoped_lock lock(ref->manager->mutex_);
+    ref->manager->timer_list_.erase(timer);
+  }
+
+  if(!error)
+  {
+    ref->manager->start_connect(endpoint, options);
+  }
+}
+
+} // namespace asio_tcp
+} // namespace network
+} // namespace darc
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/crc32c.hpp>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define DARC_CRC32C_SSE42
+#include <nmmintrin.h>
+#endif
+
+namespace darc
+{
+namespace network
+{
+
+namespace
+{
+
+const uint32_t poly = 0x82f63b78; // reflected
+
+// The hardware version runs three streams in parallel over blocks of
+// these sizes and combines them with the zeros tables
+const size_t long_block = 8192;
+const size_t short_block = 256;
+
+uint32_t gf2_matrix_times(const uint32_t * mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+  while(vec)
+  {
+    if(vec & 1)
+    {
+      sum ^= *mat;
+    }
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+void gf2_matrix_square(uint32_t * square, const uint32_t * mat)
+{
+  for(int n = 0; n < 32; n++)
+  {
+    square[n] = gf2_matrix_times(mat, mat[n]);
+  }
+}
+
+// Operator appending len zero bytes, len a power of two
+void zeros_op(uint32_t * even, size_t len)
+{
+  uint32_t odd[32];
+
+  // one zero bit
+  odd[0] = poly;
+  uint32_t row = 1;
+  for(int n = 1; n < 32; n++)
+  {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  gf2_matrix_square(even, odd); // two zero bits
+  gf2_matrix_square(odd, even); // four zero bits
+
+  // Next square is one zero byte in even, then two in odd, and so on
+  do
+  {
+    gf2_matrix_square(even, odd);
+    len >>= 1;
+    if(len == 0)
+    {
+      return;
+    }
+    gf2_matrix_square(odd, even);
+    len >>= 1;
+  }
+  while(len);
+
+  memcpy(even, odd, sizeof(odd));
+}
+
+struct tables
+{
+  uint32_t slice[8][256];
+  uint32_t long_zeros[4][256];
+  uint32_t short_zeros[4][256];
+  bool hardware;
+
+  tables()
+  {
+    for(uint32_t n = 0; n < 256; n++)
+    {
+      uint32_t crc = n;
+      for(int k = 0; k < 8; k++)
+      {
+        crc = crc & 1 ? (crc >> 1) ^ poly : crc >> 1;
+      }
+      slice[0][n] = crc;
+    }
+    for(uint32_t n = 0; n < 256; n++)
+    {
+      uint32_t crc = slice[0][n];
+      for(int k = 1; k < 8; k++)
+      {
+        crc = slice[0][crc & 0xff] ^ (crc >> 8);
+        slice[k][n] = crc;
+      }
+    }
+
+    make_zeros(long_zeros, long_block);
+    make_zeros(short_zeros, short_block);
+
+#ifdef DARC_CRC32C_SSE42
+    __builtin_cpu_init();
+    hardware = __builtin_cpu_supports("sse4.2");
+#else
+    hardware = false;
+#endif
+  }
+
+  static void make_zeros(uint32_t zeros[][256], size_t len)
+  {
+    uint32_t op[32];
+    zeros_op(op, len);
+    for(uint32_t n = 0; n < 256; n++)
+    {
+      zeros[0][n] = gf2_matrix_times(op, n);
+      zeros[1][n] = gf2_matrix_times(op, n << 8);
+      zeros[2][n] = gf2_matrix_times(op, n << 16);
+      zeros[3][n] = gf2_matrix_times(op, n << 24);
+    }
+  }
+};
+
+const tables& get_tables()
+{
+  static const tables instance;
+  return instance;
+}
+
+// Forces the tables to be built before threads start using them
+const tables& init_tables = get_tables();
+
+inline uint32_t shift(const uint32_t zeros[][256], uint32_t crc)
+{
+  return zeros[0][crc & 0xff] ^ zeros[1][(crc >> 8) & 0xff] ^
+    zeros[2][(crc >> 16) & 0xff] ^ zeros[3][crc >> 24];
+}
+
+#ifdef DARC_CRC32C_SSE42
+
+#if defined(__x86_64__)
+typedef uint64_t word_type;
+#define DARC_CRC32_WORD _mm_crc32_u64
+#else
+typedef uint32_t word_type;
+#define DARC_CRC32_WORD _mm_crc32_u32
+#endif
+
+inline word_type load(const unsigned char * p)
+{
+  word_type value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+template<size_t Block>
+__attribute__((target("sse4.2")))
+inline void crc32c_3way(const uint32_t zeros[][256], word_type& crc0,
+                        const unsigned char *& next, size_t& len)
+{
+  while(len >= Block * 3)
+  {
+    word_type crc1 = 0;
+    word_type crc2 = 0;
+    const unsigned char * end = next + Block;
+    do
+    {
+      crc0 = DARC_CRC32_WORD(crc0, load(next));
+      crc1 = DARC_CRC32_WORD(crc1, load(next + Block));
+      crc2 = DARC_CRC32_WORD(crc2, load(next + 2 * Block));
+      next += sizeof(word_type);
+    }
+    while(next < end);
+    crc0 = shift(zeros, crc0) ^ crc1;
+    crc0 = shift(zeros, crc0) ^ crc2;
+    next += Block * 2;
+    len -= Block * 3;
+  }
+}
+
+__attribute__((target("sse4.2")))
+uint32_t crc32c_hw(uint32_t crc, const void * data, size_t len)
+{
+  const tables& t = get_tables();
+  const unsigned char * next = (const unsigned char *)data;
+  word_type crc0 = crc ^ 0xffffffff;
+
+  while(len > 0 && ((uintptr_t)next & (sizeof(word_type) - 1)) != 0)
+  {
+    crc0 = _mm_crc32_u8(crc0, *next);
+    next++;
+    len--;
+  }
+
+  crc32c_3way<long_block>(t.long_zeros, crc0, next, len);
+  crc32c_3way<short_block>(t.short_zeros, crc0, next, len);
+
+  while(len >= sizeof(word_type))
+  {
+    crc0 = DARC_CRC32_WORD(crc0, load(next));
+    next += sizeof(word_type);
+    len -= sizeof(word_type);
+  }
+  while(len > 0)
+  {
+    crc0 = _mm_crc32_u8(crc0, *next);
+    next++;
+    len--;
+  }
+  return (uint32_t)crc0 ^ 0xffffffff;
+}
+
+#endif
+
+}
+
+uint32_t crc32c_software(uint32_t crc, const void * data, size_t len)
+{
+  const tables& t = get_tables();
+  const unsigned char * next = (const unsigned char *)data;
+  crc ^= 0xffffffff;
+
+  while(len > 0 && ((uintptr_t)next & 7) != 0)
+  {
+    crc = t.slice[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  while(len >= 8)
+  {
+    uint32_t lo;
+    uint32_t hi;
+    memcpy(&lo, next, 4);
+    memcpy(&hi, next + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    lo = __builtin_bswap32(lo);
+    hi = __builtin_bswap32(hi);
+#endif
+    lo ^= crc;
+    crc = t.slice[7][lo & 0xff] ^ t.slice[6][(lo >> 8) & 0xff] ^
+      t.slice[5][(lo >> 16) & 0xff] ^ t.slice[4][lo >> 24] ^
+      t.slice[3][hi & 0xff] ^ t.slice[2][(hi >> 8) & 0xff] ^
+      t.slice[1][(hi >> 16) & 0xff] ^ t.slice[0][hi >> 24];
+    next += 8;
+    len -= 8;
+  }
+  while(len > 0)
+  {
+    crc = t.slice[0][(crc ^ *next++) & 0xff] ^ (crc >> 8);
+    len--;
+  }
+  return crc ^ 0xffffffff;
+}
+
+bool crc32c_hardware()
+{
+  return get_tables().hardware;
+}
+
+uint32_t crc32c(uint32_t crc, const void * data, size_t len)
+{
+#ifdef DARC_CRC32C_SSE42
+  if(get_tables().hardware)
+  {
+    return crc32c_hw(crc, data, len);
+  }
+#endif
+  return crc32c_software(crc, data, len);
+}
+
+}
+}
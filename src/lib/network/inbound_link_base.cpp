@@ -1,28 +1,170 @@
 #include <darc/network/inbound_link_base.hpp>
 
 #include <darc/network/network_manager.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/network/data_header_packet.hpp>
+#include <darc/network/crc32c.hpp>
 
 namespace darc
 {
 namespace network
 {
 
+void inbound_link_base::send_packet(const ID& outbound_id,
+                                    const ID& dest_peer_id,
+                                    const uint16_t packet_type,
+                                    buffer::shared_buffer data)
+{
+  prepend_link_header(peer_.id(), dest_peer_id, packet_type, data, manager_->link_checksum());
+  send_frame(outbound_id, dest_peer_id, data);
+}
+
+void inbound_link_base::send_packet_to_all(const ID& dest_peer_id,
+                                           const uint16_t packet_type,
+                                           buffer::shared_buffer data)
+{
+  prepend_link_header(peer_.id(), dest_peer_id, packet_type, data, manager_->link_checksum());
+  send_frame_to_all(dest_peer_id, data);
+}
+
+namespace
+{
+
+uint32_t link_crc(const link_header_packet& header, buffer::buffer::segment_list_type& segments)
+{
+  char bytes[darc::serializer::raw_layout<link_header_packet>::size];
+  darc::serializer::raw_oarchive oarchive(bytes);
+  const_cast<link_header_packet&>(header).serialize(oarchive, 0);
+
+  uint32_t crc = crc32c(0, bytes, sizeof(bytes));
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    crc = crc32c(crc,
+                 boost::asio::buffer_cast<const char*>(*it),
+                 boost::asio::buffer_size(*it));
+  }
+  return crc;
+}
+
+}
+
+void inbound_link_base::prepend_link_header(const ID& src_peer_id,
+                                            const ID& dest_peer_id,
+                                            const uint16_t packet_type,
+                                            buffer::shared_buffer& data,
+                                            bool checksum)
+{
+  link_header_packet lhp;
+  lhp.packet_type = packet_type;
+  lhp.dest_peer_id = dest_peer_id;
+  lhp.src_peer_id = src_peer_id;
+
+  if(checksum)
+  {
+    lhp.packet_type |= link_header_packet::CHECKSUM;
+
+    buffer::buffer::segment_list_type segments;
+    data->segments(segments);
+    link_checksum_packet lcp;
+    lcp.crc = link_crc(lhp, segments);
+    outbound_data<darc::serializer::raw_serializer, link_checksum_packet> o_lcp(lcp);
+    o_lcp.prepend(data);
+  }
+
+  outbound_data<darc::serializer::raw_serializer, link_header_packet> o_lhp(lhp);
+  o_lhp.prepend(data);
+}
+
+bool inbound_link_base::verify_link_checksum(link_header_packet& header,
+                                             buffer::shared_buffer& data)
+{
+  if((header.packet_type & link_header_packet::CHECKSUM) == 0)
+  {
+    return true;
+  }
+
+  buffer::buffer::segment_list_type segments;
+  data->unread_segments(segments);
+  size_t available = 0;
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    available += boost::asio::buffer_size(*it);
+  }
+  if(available < darc::serializer::raw_layout<link_checksum_packet>::size)
+  {
+    return false;
+  }
+
+  inbound_data<darc::serializer::raw_serializer, link_checksum_packet> lcp_i(data);
+  segments.clear();
+  data->unread_segments(segments);
+  return link_crc(header, segments) == lcp_i.get().crc;
+}
+
+void inbound_link_base::handle_discover_packet(const ID& src_peer_id, buffer::shared_buffer& data)
+{
+  inbound_data<darc::serializer::raw_serializer, discover_packet> dp_i(data);
+
+  slog<iris::Debug>("Received DISCOVER",
+                    "peer_id", iris::arg<ID>(src_peer_id),
+                    "remote outbound_id", iris::arg<ID>(dp_i.get().outbound_id));
+
+  manager_->neighbour_capabilities(src_peer_id, dp_i.get().capabilities);
+
+  discover_reply_packet drp;
+  drp.outbound_id = dp_i.get().outbound_id;
+  drp.capabilities = local_capabilities();
+  outbound_data<darc::serializer::raw_serializer, discover_reply_packet> o_drp(drp);
+
+  buffer::shared_buffer buffer = buffer::chain_buffer::create(o_drp.serialized_size());
+
+  o_drp.pack(buffer);
+
+  send_packet_to_all(src_peer_id, link_header_packet::DISCOVER_REPLY, buffer);
+}
+
 void inbound_link_base::handle_discover_reply_packet(const ID& src_peer_id, buffer::shared_buffer& data)
 {
-  inbound_data<darc::serializer::boost_serializer, discover_reply_packet> drp_i(data);
+  inbound_data<darc::serializer::raw_serializer, discover_reply_packet> drp_i(data);
 
   slog<iris::Debug>("Received DISCOVER_REPLY",
                     "peer_id", iris::arg<ID>(src_peer_id),
                     "outbound_id", iris::arg<ID>(drp_i.get().outbound_id));
 
+  manager_->neighbour_capabilities(src_peer_id, drp_i.get().capabilities);
   manager_->neighbour_peer_discovered(src_peer_id, drp_i.get().outbound_id);
 
 }
 
-void inbound_link_base::packet_received(buffer::shared_buffer header_data,
-                                        buffer::shared_buffer body_data)
+void inbound_link_base::packet_received(buffer::shared_buffer data)
 {
-  inbound_data<darc::serializer::boost_serializer, link_header_packet> header_i(header_data);
+  try
+  {
+    dispatch_packet(data);
+  }
+  catch(serializer::serializer_exception& e)
+  {
+    slog<iris::Warning>("NetworkManager: Dropped truncated frame",
+                        "expected", iris::arg<int>(*boost::get_error_info<serializer::serializer_exception::expected_size>(e)),
+                        "available", iris::arg<int>(*boost::get_error_info<serializer::serializer_exception::available_size>(e)));
+  }
+}
+
+void inbound_link_base::dispatch_packet(buffer::shared_buffer& data)
+{
+  inbound_data<darc::serializer::raw_serializer, link_header_packet> header_i(data);
+
+  // Checked before anything is decoded from the frame
+  if(!verify_link_checksum(header_i.get(), data))
+  {
+    manager_->link_checksum_failed(header_i.get().src_peer_id);
+    return;
+  }
+  header_i.get().packet_type &= ~link_header_packet::CHECKSUM;
 
   // Discard packages not to us, or from self, e.g. due to multicasting
   if((header_i.get().dest_peer_id != ID::null() &&
@@ -37,17 +179,26 @@ void inbound_link_base::packet_received(buffer::shared_buffer header_data,
   {
   case link_header_packet::SERVICE:
   {
-    manager_->service_packet_received(header_i.get().src_peer_id, body_data);
+    manager_->service_packet_received(header_i.get().src_peer_id,
+                                      buffer::slice_buffer::unread(data));
+    break;
+  }
+  case link_header_packet::DATA:
+  {
+    inbound_data<darc::serializer::raw_serializer, data_header_packet> data_header_i(data);
+    manager_->data_packet_received(header_i.get().src_peer_id,
+                                   data_header_i.get(),
+                                   buffer::slice_buffer::unread(data));
     break;
   }
   case link_header_packet::DISCOVER:
   {
-    handle_discover_packet(header_i.get().src_peer_id, body_data);
+    handle_discover_packet(header_i.get().src_peer_id, data);
     break;
   }
   case link_header_packet::DISCOVER_REPLY:
   {
-    handle_discover_reply_packet(header_i.get().src_peer_id, body_data);
+    handle_discover_reply_packet(header_i.get().src_peer_id, data);
     break;
   }
   case link_header_packet::DISCONNECT:
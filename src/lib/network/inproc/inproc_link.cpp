@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/inproc/inproc_link.hpp>
+
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/network/inbound_link_base.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace inproc
+{
+
+inproc_link::inproc_link(inbound_link_base * receiver) :
+  receiver_(receiver),
+  queue_(initial_capacity),
+  stop_(false),
+  waiting_(false)
+{
+  thread_ = boost::thread(boost::bind(&inproc_link::work, this));
+}
+
+inproc_link::~inproc_link()
+{
+  stop();
+
+  buffer::shared_buffer * data;
+  while(queue_.pop(data))
+  {
+    delete data;
+  }
+}
+
+void inproc_link::send(buffer::shared_buffer data)
+{
+  queue_.push(new buffer::shared_buffer(data));
+
+  // Pairs with the fence in work(), either the receiver finds the frame or
+  // we find it waiting
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  if(waiting_.load(boost::memory_order_relaxed))
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    condition_.notify_one();
+  }
+}
+
+void inproc_link::stop()
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stop_ = true;
+    condition_.notify_one();
+  }
+  if(thread_.joinable())
+  {
+    thread_.join();
+  }
+}
+
+void inproc_link::work()
+{
+  while(!stop_)
+  {
+    buffer::shared_buffer * data = 0;
+    if(!queue_.pop(data))
+    {
+      boost::mutex::scoped_lock lock(mutex_);
+      waiting_ = true;
+      boost::atomic_thread_fence(boost::memory_order_seq_cst);
+      while(!stop_ && !queue_.pop(data))
+      {
+        condition_.wait(lock);
+      }
+      waiting_ = false;
+    }
+
+    if(data == 0)
+    {
+      break; // stopped
+    }
+
+    // Own read position, the sender's buffer may be queued to others too
+    buffer::shared_buffer frame = buffer::slice_buffer::unread(*data);
+    delete data;
+    receiver_->packet_received(frame);
+  }
+}
+
+}
+}
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/inproc/inproc_protocol_manager.hpp>
+
+#include <vector>
+#include <darc/network/inproc/inproc_registry.hpp>
+#include <darc/network/network_manager.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace inproc
+{
+
+inproc_protocol_manager::inproc_protocol_manager(class network_manager * manager,
+                                                 peer& p):
+  network::protocol_manager_base(),
+  network::inbound_link_base(manager, p),
+  peer_(p)
+{
+}
+
+inproc_protocol_manager::~inproc_protocol_manager()
+{
+  inproc_registry::instance().remove(this);
+}
+
+void inproc_protocol_manager::send_frame(const darc::ID& outbound_id,
+                                         const ID& topic_peer_id,
+                                         buffer::shared_buffer data)
+{
+  shared_inproc_link link;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    link_list_type::iterator item = link_list_.find(outbound_id);
+    if(item != link_list_.end())
+    {
+      link = item->second;
+    }
+  }
+
+  if(!link)
+  {
+    slog<iris::Warning>("Attempting to send to unknown outbound connection",
+                        "outbound id", iris::arg<ID>(outbound_id));
+    return;
+  }
+  link->send(data);
+}
+
+void inproc_protocol_manager::send_frame_to_all(const ID& topic_peer_id,
+                                                buffer::shared_buffer data)
+{
+  std::vector<shared_inproc_link> links;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(link_list_type::iterator it = link_list_.begin(); it != link_list_.end(); it++)
+    {
+      links.push_back(it->second);
+    }
+  }
+
+  for(std::vector<shared_inproc_link>::iterator it = links.begin(); it != links.end(); it++)
+  {
+    (*it)->send(data);
+  }
+}
+
+void inproc_protocol_manager::accept(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "inproc");
+
+  slog<iris::Info>("inproc accept",
+                   "name", iris::arg<std::string>(url));
+  inproc_registry::instance().bind(url, this);
+}
+
+void inproc_protocol_manager::connect(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "inproc");
+
+  slog<iris::Info>("inproc connect",
+                   "name", iris::arg<std::string>(url));
+  inproc_registry::instance().connect(url, this);
+}
+
+void inproc_protocol_manager::add_connection(const ID& outbound_id, shared_inproc_link link)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    link_list_.insert(link_list_type::value_type(outbound_id, link));
+  }
+  manager_->register_connection(outbound_id, this);
+}
+
+void inproc_protocol_manager::remove_connection(const ID& outbound_id)
+{
+  manager_->unregister_connection(outbound_id);
+  boost::mutex::scoped_lock lock(mutex_);
+  link_list_.erase(outbound_id);
+}
+
+} // namespace inproc
+} // namespace network
+} // namespace darc
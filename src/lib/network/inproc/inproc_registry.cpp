@@ -0,0 +1,195 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/inproc/inproc_registry.hpp>
+
+#include <vector>
+#include <boost/make_shared.hpp>
+#include <darc/network/inproc/inproc_protocol_manager.hpp>
+#include <darc/network/network_manager.hpp>
+#include <darc/network/address_in_use_exception.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace inproc
+{
+
+namespace
+{
+
+struct disconnect_notice
+{
+  inproc_protocol_manager * manager;
+  ID peer_id;
+  ID outbound_id;
+};
+
+}
+
+void inproc_registry::bind(const std::string& name, inproc_protocol_manager * acceptor)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(!bound_list_.insert(bound_list_type::value_type(name, acceptor)).second)
+  {
+    throw address_in_use_exception() << address_in_use_exception::address(name);
+  }
+
+  std::pair<pending_list_type::iterator, pending_list_type::iterator> range = pending_list_.equal_range(name);
+  for(pending_list_type::iterator it = range.first; it != range.second; it++)
+  {
+    establish(name, acceptor, it->second);
+  }
+  pending_list_.erase(range.first, range.second);
+}
+
+void inproc_registry::connect(const std::string& name, inproc_protocol_manager * connector)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  bound_list_type::iterator item = bound_list_.find(name);
+  if(item != bound_list_.end())
+  {
+    establish(name, item->second, connector);
+  }
+  else
+  {
+    pending_list_.insert(pending_list_type::value_type(name, connector));
+  }
+}
+
+void inproc_registry::remove(inproc_protocol_manager * manager)
+{
+  std::vector<shared_inproc_link> closed;
+  std::vector<disconnect_notice> notices;
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+
+    for(bound_list_type::iterator it = bound_list_.begin(); it != bound_list_.end();)
+    {
+      if(it->second == manager)
+      {
+        bound_list_.erase(it++);
+      }
+      else
+      {
+        it++;
+      }
+    }
+
+    for(pending_list_type::iterator it = pending_list_.begin(); it != pending_list_.end();)
+    {
+      if(it->second == manager)
+      {
+        pending_list_.erase(it++);
+      }
+      else
+      {
+        it++;
+      }
+    }
+
+    for(connection_list_type::iterator it = connection_list_.begin(); it != connection_list_.end();)
+    {
+      if(it->acceptor != manager && it->connector != manager)
+      {
+        it++;
+        continue;
+      }
+
+      it->acceptor->remove_connection(it->acceptor_outbound_id);
+      it->connector->remove_connection(it->connector_outbound_id);
+      closed.push_back(it->to_acceptor);
+      closed.push_back(it->to_connector);
+
+      if(it->acceptor == manager && it->connector != manager)
+      {
+        disconnect_notice notice = {it->connector, manager->peer_id(), it->connector_outbound_id};
+        notices.push_back(notice);
+        // Connected again once somebody accepts on the name
+        pending_list_.insert(pending_list_type::value_type(it->name, it->connector));
+      }
+      else if(it->connector == manager && it->acceptor != manager)
+      {
+        disconnect_notice notice = {it->acceptor, manager->peer_id(), it->acceptor_outbound_id};
+        notices.push_back(notice);
+      }
+
+      connection_list_.erase(it++);
+    }
+  }
+
+  // Outside the lock, the link threads may be delivering
+  for(std::vector<shared_inproc_link>::iterator it = closed.begin(); it != closed.end(); it++)
+  {
+    (*it)->stop();
+  }
+
+  for(std::vector<disconnect_notice>::iterator it = notices.begin(); it != notices.end(); it++)
+  {
+    it->manager->network_manager()->neighbour_peer_disconnected(it->peer_id, it->outbound_id);
+  }
+}
+
+void inproc_registry::establish(const std::string& name,
+                                inproc_protocol_manager * acceptor,
+                                inproc_protocol_manager * connector)
+{
+  connection c;
+  c.name = name;
+  c.acceptor = acceptor;
+  c.connector = connector;
+  c.acceptor_outbound_id = ID::create();
+  c.connector_outbound_id = ID::create();
+  c.to_acceptor = boost::make_shared<inproc_link>(acceptor);
+  c.to_connector = boost::make_shared<inproc_link>(connector);
+  connection_list_.push_back(c);
+
+  acceptor->add_connection(c.acceptor_outbound_id, c.to_connector);
+  connector->add_connection(c.connector_outbound_id, c.to_acceptor);
+
+  acceptor->sendDiscover(c.acceptor_outbound_id);
+  connector->sendDiscover(c.connector_outbound_id);
+}
+
+inproc_registry& inproc_registry::instance()
+{
+  static inproc_registry * instance_ = new inproc_registry();
+  return *instance_;
+}
+
+}
+}
+}
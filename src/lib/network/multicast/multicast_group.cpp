@@ -0,0 +1,393 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/multicast/multicast_group.hpp>
+#include <darc/network/multicast/multicast_protocol_manager.hpp>
+
+#include <darc/network/network_manager.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
+#include <darc/id_arg.hpp>
+
+#include <errno.h>
+#include <poll.h>
+
+namespace darc
+{
+namespace network
+{
+namespace multicast
+{
+
+namespace
+{
+
+const size_t header_size = darc::serializer::raw_layout<multicast_fragment_packet>::size;
+const size_t max_datagram_size = 65536;
+const size_t max_drain = 256; // datagrams received per poll
+
+size_t ip_udp_overhead(const boost::asio::ip::udp::endpoint& endpoint)
+{
+  return (endpoint.address().is_v4() ? 20 : 40) + 8;
+}
+
+}
+
+multicast_group::multicast_group(multicast_protocol_manager * parent,
+                                 const boost::asio::ip::udp::endpoint& endpoint,
+                                 const boost::asio::ip::address& interface,
+                                 size_t mtu,
+                                 int ttl) :
+  parent_(parent),
+  outbound_id_(ID::create()),
+  endpoint_(endpoint),
+  max_payload_(mtu - ip_udp_overhead(endpoint) - header_size),
+  rx_socket_(io_service_),
+  tx_socket_(io_service_),
+  sequence_(0),
+  datagram_(max_datagram_size),
+  stop_(false),
+  sent_frames_(0),
+  sent_datagrams_(0),
+  received_frames_(0),
+  lost_frames_(0),
+  dropped_frames_(0)
+{
+  assert(mtu > ip_udp_overhead(endpoint) + header_size);
+  assert(interface.is_unspecified() || interface.is_v4());
+
+  using namespace boost::asio;
+
+  // Bound to the group address, so only datagrams to the group are received
+  // and other groups may share the port
+  rx_socket_.open(endpoint.protocol());
+  rx_socket_.set_option(socket_base::reuse_address(true));
+  rx_socket_.set_option(socket_base::receive_buffer_size(socket_buffer_size));
+  rx_socket_.bind(endpoint);
+  if(interface.is_unspecified())
+  {
+    rx_socket_.set_option(ip::multicast::join_group(endpoint.address()));
+  }
+  else
+  {
+    rx_socket_.set_option(ip::multicast::join_group(endpoint.address().to_v4(), interface.to_v4()));
+  }
+  rx_socket_.non_blocking(true);
+
+  tx_socket_.open(endpoint.protocol());
+  tx_socket_.set_option(socket_base::send_buffer_size(socket_buffer_size));
+  tx_socket_.set_option(ip::multicast::hops(ttl));
+  tx_socket_.set_option(ip::multicast::enable_loopback(true)); // peers on this host
+  if(!interface.is_unspecified())
+  {
+    tx_socket_.set_option(ip::multicast::outbound_interface(interface.to_v4()));
+  }
+}
+
+bool multicast_group::send(buffer::shared_buffer data)
+{
+  buffer::buffer::segment_list_type segments;
+  data->segments(segments);
+  size_t size = 0;
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    size += boost::asio::buffer_size(*it);
+  }
+
+  size_t fragment_count = std::max<size_t>((size + max_payload_ - 1) / max_payload_, 1);
+  if(size > max_frame_size || fragment_count > 0xffff)
+  {
+    dropped_frames_++;
+    slog<iris::Warning>("multicast: dropped frame, too large",
+                        "size", iris::arg<int>(size));
+    return false;
+  }
+
+  multicast_fragment_packet header;
+  header.src_peer_id = parent_->peer_id();
+  header.fragment_count = fragment_count;
+  char header_bytes[header_size];
+
+  // Header and the part of the frame it covers, gathered into one datagram
+  std::vector<boost::asio::const_buffer> datagram;
+  buffer::buffer::segment_list_type::iterator segment = segments.begin();
+  size_t offset = 0;
+
+  boost::mutex::scoped_lock lock(send_mutex_);
+  header.sequence = sequence_++;
+  for(size_t fragment = 0; fragment < fragment_count; fragment++)
+  {
+    header.fragment = fragment;
+    darc::serializer::raw_oarchive oarchive(header_bytes);
+    header.serialize(oarchive, 0);
+
+    datagram.clear();
+    datagram.push_back(boost::asio::buffer(header_bytes));
+    size_t remaining = std::min(max_payload_, size - fragment * max_payload_);
+    while(remaining > 0)
+    {
+      size_t n = std::min(remaining, boost::asio::buffer_size(*segment) - offset);
+      datagram.push_back(boost::asio::buffer(boost::asio::buffer_cast<const char*>(*segment) + offset, n));
+      remaining -= n;
+      offset += n;
+      if(offset == boost::asio::buffer_size(*segment))
+      {
+        segment++;
+        offset = 0;
+      }
+    }
+
+    boost::system::error_code error;
+    tx_socket_.send_to(datagram, endpoint_, 0, error);
+    if(error)
+    {
+      // The rest of the frame is of no use to the receivers
+      dropped_frames_++;
+      slog<iris::Warning>("multicast: dropped frame, send failed",
+                          "error", iris::arg<std::string>(error.message()));
+      return false;
+    }
+    sent_datagrams_++;
+  }
+  sent_frames_++;
+  return true;
+}
+
+void multicast_group::run()
+{
+  boost::posix_time::ptime next_discover =
+    boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(discover_interval_ms);
+
+  while(!stop_)
+  {
+    struct pollfd fd;
+    fd.fd = rx_socket_.native_handle();
+    fd.events = POLLIN;
+    fd.revents = 0;
+    int result = poll(&fd, 1, poll_interval_ms);
+    if(result < 0 && errno != EINTR)
+    {
+      slog<iris::Error>("multicast: poll failed",
+                        "errno", iris::arg<int>(errno));
+      break;
+    }
+
+    boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
+    for(size_t i = 0; result > 0 && i < max_drain && !stop_; i++)
+    {
+      boost::asio::ip::udp::endpoint sender_endpoint;
+      boost::system::error_code error;
+      size_t size = rx_socket_.receive_from(boost::asio::buffer(datagram_), sender_endpoint, 0, error);
+      if(error)
+      {
+        if(error != boost::asio::error::would_block)
+        {
+          slog<iris::Warning>("multicast: receive failed",
+                              "error", iris::arg<std::string>(error.message()));
+        }
+        break;
+      }
+      receive(size, now);
+    }
+
+    if(now >= next_discover)
+    {
+      parent_->sendDiscover(outbound_id_);
+      expire(now);
+      next_discover = now + boost::posix_time::milliseconds(discover_interval_ms);
+    }
+  }
+}
+
+void multicast_group::stop()
+{
+  stop_ = true;
+}
+
+multicast_group::statistics multicast_group::stats() const
+{
+  statistics s;
+  s.sent_frames = sent_frames_;
+  s.sent_datagrams = sent_datagrams_;
+  s.received_frames = received_frames_;
+  s.lost_frames = lost_frames_;
+  s.dropped_frames = dropped_frames_;
+  return s;
+}
+
+void multicast_group::receive(size_t size, const boost::posix_time::ptime& now)
+{
+  if(size < header_size)
+  {
+    return; // not from a darc peer
+  }
+
+  multicast_fragment_packet header;
+  darc::serializer::raw_iarchive iarchive(&datagram_[0]);
+  header.serialize(iarchive, 0);
+
+  // Our own, looped back
+  if(header.src_peer_id == parent_->peer_id() ||
+     header.fragment >= header.fragment_count)
+  {
+    return;
+  }
+
+  std::pair<sender_list_type::iterator, bool> item =
+    sender_list_.insert(sender_list_type::value_type(header.src_peer_id, sender_state()));
+  item.first->second.last_seen = now;
+  if(item.second)
+  {
+    // Let the new peer know about us now rather than at the next interval
+    parent_->sendDiscover(outbound_id_);
+  }
+
+  fragment_received(item.first->second, header, &datagram_[header_size], size - header_size);
+}
+
+void multicast_group::fragment_received(sender_state& sender,
+                                        const multicast_fragment_packet& header,
+                                        const char * payload,
+                                        size_t size)
+{
+  int32_t ahead = static_cast<int32_t>(header.sequence - sender.next_sequence);
+  if(sender.synchronized && ahead < 0)
+  {
+    // The rest of the frame being put together, or a late datagram
+    if(!sender.frame || header.sequence != sender.sequence)
+    {
+      return;
+    }
+
+    bool last = header.fragment + 1 == sender.fragment_count;
+    if(header.fragment != sender.next_fragment ||
+       header.fragment_count != sender.fragment_count ||
+       size > sender.fragment_size ||
+       (!last && size != sender.fragment_size))
+    {
+      sender.frame.reset();
+      frames_lost(header.src_peer_id, header.sequence, 1);
+      return;
+    }
+
+    sender.frame->streambuf()->sputn(payload, size);
+    sender.next_fragment++;
+    if(last)
+    {
+      buffer::shared_buffer frame;
+      frame.swap(sender.frame);
+      received_frames_++;
+      parent_->packet_received(frame);
+    }
+    return;
+  }
+
+  // A new frame, any before it which did not arrive in full are lost
+  bool synchronized = sender.synchronized;
+  if(sender.frame)
+  {
+    sender.frame.reset();
+    frames_lost(header.src_peer_id, sender.sequence, 1);
+  }
+  if(synchronized && ahead > 0)
+  {
+    frames_lost(header.src_peer_id, sender.next_sequence, ahead);
+  }
+  sender.synchronized = true;
+  sender.next_sequence = header.sequence + 1;
+
+  if(header.fragment != 0)
+  {
+    // Only a loss if we were receiving from the sender already
+    if(synchronized)
+    {
+      frames_lost(header.src_peer_id, header.sequence, 1);
+    }
+    return;
+  }
+
+  if(header.fragment_count * size > max_frame_size)
+  {
+    frames_lost(header.src_peer_id, header.sequence, 1);
+    return;
+  }
+
+  buffer::shared_buffer frame = buffer::pooled_buffer::create(header.fragment_count * size);
+  frame->streambuf()->sputn(payload, size);
+  if(header.fragment_count == 1)
+  {
+    received_frames_++;
+    parent_->packet_received(frame);
+    return;
+  }
+
+  sender.frame = frame;
+  sender.sequence = header.sequence;
+  sender.next_fragment = 1;
+  sender.fragment_count = header.fragment_count;
+  sender.fragment_size = size;
+}
+
+void multicast_group::frames_lost(const ID& src_peer_id, uint32_t sequence, uint32_t count)
+{
+  lost_frames_ += count;
+  slog<iris::Warning>("multicast: lost frames",
+                      "peer_id", iris::arg<ID>(src_peer_id),
+                      "sequence", iris::arg<int>(sequence),
+                      "count", iris::arg<int>(count));
+}
+
+void multicast_group::expire(const boost::posix_time::ptime& now)
+{
+  for(sender_list_type::iterator it = sender_list_.begin(); it != sender_list_.end();)
+  {
+    if(now - it->second.last_seen > boost::posix_time::milliseconds(peer_timeout_ms))
+    {
+      ID peer_id = it->first;
+      sender_list_.erase(it++);
+      slog<iris::Info>("multicast: peer timed out",
+                       "peer_id", iris::arg<ID>(peer_id));
+      parent_->network_manager()->neighbour_peer_disconnected(peer_id, outbound_id_);
+    }
+    else
+    {
+      it++;
+    }
+  }
+}
+
+}
+}
+}
@@ -0,0 +1,307 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#include <darc/network/multicast/multicast_protocol_manager.hpp>
+
+#include <vector>
+#include <boost/bind.hpp>
+#include <boost/regex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <darc/network/network_manager.hpp>
+#include <darc/network/address_in_use_exception.hpp>
+#include <darc/network/invalid_url_exception.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+
+namespace darc
+{
+namespace network
+{
+namespace multicast
+{
+
+namespace
+{
+
+struct group_url
+{
+  boost::asio::ip::udp::endpoint endpoint;
+  boost::asio::ip::address interface;
+  size_t mtu;
+  int ttl;
+};
+
+int url_number(const std::string& value, int min, int max)
+{
+  try
+  {
+    int number = boost::lexical_cast<int>(value);
+    if(number >= min && number <= max)
+    {
+      return number;
+    }
+  }
+  catch(boost::bad_lexical_cast&)
+  {
+  }
+  throw invalid_url_exception() << invalid_url_exception::problem("Invalid number: " + value);
+}
+
+boost::asio::ip::address url_address(const std::string& value)
+{
+  boost::system::error_code error;
+  boost::asio::ip::address address = boost::asio::ip::address::from_string(value, error);
+  if(error)
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Invalid address: " + value);
+  }
+  return address;
+}
+
+// "group:port[?interface=address&mtu=bytes&ttl=hops]", IPv6 groups in []
+group_url parse_url(const std::string& url)
+{
+  boost::smatch what;
+  if(!boost::regex_match(url, what, boost::regex("^(\\[([^\\]]+)\\]|([^:\\[\\]?]+)):([0-9]+)(\\?(.*))?$")))
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Expected group:port");
+  }
+
+  group_url result;
+  boost::asio::ip::address group = url_address(what[2].matched ? what[2] : what[3]);
+  if(!group.is_multicast())
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Not a multicast address");
+  }
+  result.endpoint = boost::asio::ip::udp::endpoint(group, url_number(what[4], 1, 65535));
+  result.mtu = multicast_group::default_mtu;
+  result.ttl = multicast_group::default_ttl;
+
+  std::string options = what[6];
+  boost::sregex_token_iterator end;
+  for(boost::sregex_token_iterator it(options.begin(), options.end(), boost::regex("&"), -1);
+      it != end;
+      it++)
+  {
+    boost::smatch option;
+    std::string item = *it;
+    if(!boost::regex_match(item, option, boost::regex("^([a-z]+)=(.+)$")))
+    {
+      throw invalid_url_exception() << invalid_url_exception::problem("Invalid option: " + item);
+    }
+
+    if(option[1] == "interface")
+    {
+      result.interface = url_address(option[2]);
+      if(!result.interface.is_v4() || !group.is_v4())
+      {
+        throw invalid_url_exception() << invalid_url_exception::problem("Interface only supported for IPv4");
+      }
+    }
+    else if(option[1] == "mtu")
+    {
+      result.mtu = url_number(option[2], 576, 65535);
+    }
+    else if(option[1] == "ttl")
+    {
+      result.ttl = url_number(option[2], 0, 255);
+    }
+    else
+    {
+      throw invalid_url_exception() << invalid_url_exception::problem("Unknown option: " + item);
+    }
+  }
+  return result;
+}
+
+}
+
+multicast_protocol_manager::multicast_protocol_manager(class network_manager * manager,
+                                                       peer& p):
+  network::protocol_manager_base(),
+  network::inbound_link_base(manager, p),
+  peer_(p),
+  stopping_(false)
+{
+}
+
+multicast_protocol_manager::~multicast_protocol_manager()
+{
+  group_list_type groups;
+  thread_list_type threads;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopping_ = true;
+    groups = group_list_;
+    threads.swap(thread_list_);
+  }
+
+  // Tell the others rather than have them wait for peer_timeout_ms
+  for(group_list_type::iterator it = groups.begin(); it != groups.end(); it++)
+  {
+    send_packet(it->first, ID::null(), link_header_packet::DISCONNECT, buffer::chain_buffer::create(0));
+    it->second->stop();
+  }
+
+  for(thread_list_type::iterator it = threads.begin(); it != threads.end(); it++)
+  {
+    (*it)->join();
+  }
+}
+
+// The network_manager only sends to one peer on a group when the peer has
+// no other link. The group gets the frame, and the others drop it by the
+// destination in the link header.
+void multicast_protocol_manager::send_frame(const darc::ID& outbound_id,
+                                            const ID& topic_peer_id,
+                                            buffer::shared_buffer data)
+{
+  shared_multicast_group group;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    group_list_type::iterator item = group_list_.find(outbound_id);
+    if(item != group_list_.end())
+    {
+      group = item->second;
+    }
+  }
+
+  if(!group)
+  {
+    slog<iris::Warning>("Attempting to send to unknown outbound connection",
+                        "outbound id", iris::arg<ID>(outbound_id));
+    return;
+  }
+  group->send(data);
+}
+
+void multicast_protocol_manager::send_frame_to_all(const ID& topic_peer_id,
+                                                   buffer::shared_buffer data)
+{
+  std::vector<shared_multicast_group> groups;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(group_list_type::iterator it = group_list_.begin(); it != group_list_.end(); it++)
+    {
+      groups.push_back(it->second);
+    }
+  }
+
+  for(std::vector<shared_multicast_group>::iterator it = groups.begin(); it != groups.end(); it++)
+  {
+    (*it)->send(data);
+  }
+}
+
+void multicast_protocol_manager::accept(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "udp+multicast");
+
+  group_url group_url = parse_url(url);
+
+  boost::mutex::scoped_lock lock(mutex_);
+  for(group_list_type::iterator it = group_list_.begin(); it != group_list_.end(); it++)
+  {
+    if(it->second->endpoint() == group_url.endpoint)
+    {
+      throw address_in_use_exception() << address_in_use_exception::address(url);
+    }
+  }
+
+  shared_multicast_group group;
+  try
+  {
+    group = boost::make_shared<multicast_group>(this,
+                                                group_url.endpoint,
+                                                group_url.interface,
+                                                group_url.mtu,
+                                                group_url.ttl);
+  }
+  catch(boost::system::system_error& e)
+  {
+    if(e.code() == boost::asio::error::address_in_use)
+    {
+      throw address_in_use_exception() << address_in_use_exception::address(url);
+    }
+    else
+    {
+      throw;
+    }
+  }
+
+  slog<iris::Info>("multicast join",
+                   "group", iris::arg<std::string>(url),
+                   "Out-ID", iris::arg<ID>(group->outbound_id()));
+
+  group_list_.insert(group_list_type::value_type(group->outbound_id(), group));
+  thread_list_.push_back(boost::make_shared<boost::thread>(boost::bind(&multicast_protocol_manager::group_work,
+                                                                       this,
+                                                                       group)));
+}
+
+void multicast_protocol_manager::connect(const std::string& protocol, const std::string& url)
+{
+  // There is no difference between the two sides of a group
+  accept(protocol, url);
+}
+
+multicast_group::statistics multicast_protocol_manager::stats()
+{
+  multicast_group::statistics result;
+  boost::mutex::scoped_lock lock(mutex_);
+  for(group_list_type::iterator it = group_list_.begin(); it != group_list_.end(); it++)
+  {
+    multicast_group::statistics s = it->second->stats();
+    result.sent_frames += s.sent_frames;
+    result.sent_datagrams += s.sent_datagrams;
+    result.received_frames += s.received_frames;
+    result.lost_frames += s.lost_frames;
+    result.dropped_frames += s.dropped_frames;
+  }
+  return result;
+}
+
+void multicast_protocol_manager::group_work(shared_multicast_group group)
+{
+  // One copy of a broadcast reaches every peer in the group
+  manager_->register_connection(group->outbound_id(), this, true);
+
+  sendDiscover(group->outbound_id());
+  group->run();
+
+  manager_->unregister_connection(group->outbound_id());
+}
+
+} // namespace multicast
+} // namespace network
+} // namespace darc
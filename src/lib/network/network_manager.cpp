@@ -37,10 +37,16 @@
 #include <darc/serializer/boost.hpp>
 #include <darc/network/protocol_manager_base.hpp>
 #include <darc/network/link_header_packet.hpp>
+#include <darc/network/inbound_link_base.hpp>
+#include <darc/network/discover_packet.hpp>
 #include <darc/network/invalid_url_exception.hpp>
 #include <iris/glog.hpp>
 #include <darc/id_arg.hpp>
 #include <darc/network/zmq/zmq_protocol_manager.hpp>
+#include <darc/network/shm/shm_protocol_manager.hpp>
+#include <darc/network/inproc/inproc_protocol_manager.hpp>
+#include <darc/network/multicast/multicast_protocol_manager.hpp>
+#include <darc/network/asio/asio_protocol_manager.hpp>
 
 namespace darc
 {
@@ -48,23 +54,97 @@ namespace network
 {
 
 network_manager::network_manager(boost::asio::io_service &io_service, darc::peer& p) :
-  peer_(p)
+  peer_(p),
+  link_checksum_(false),
+  link_checksum_failures_(0)
 {
   peer_.set_send_to_function(boost::bind(&network_manager::sendPacket, this, _1, _2));
+  peer_.set_send_data_function(boost::bind(&network_manager::send_data, this, _1, _2, _3),
+                               boost::bind(&network_manager::data_header_supported, this, _1));
+  // One zmq context and set of workers for both transports
+  boost::shared_ptr<protocol_manager_base> zmq_manager =
+    boost::make_shared<zeromq::zmq_protocol_manager>(this, boost::ref(p));
+  manager_protocol_map_.insert(ManagerProtocolMapType::value_type(std::string("zmq+tcp"), zmq_manager));
+  manager_protocol_map_.insert(ManagerProtocolMapType::value_type(std::string("zmq+ipc"), zmq_manager));
   manager_protocol_map_.insert(
-    ManagerProtocolMapType::value_type(std::string("zmq+tcp"),
-                                       boost::make_shared<zeromq::zmq_protocol_manager>(this, boost::ref(p))));
+    ManagerProtocolMapType::value_type(std::string("inproc"),
+                                       boost::make_shared<inproc::inproc_protocol_manager>(this, boost::ref(p))));
+  manager_protocol_map_.insert(
+    ManagerProtocolMapType::value_type(std::string("asio+tcp"),
+                                       boost::make_shared<asio_tcp::asio_protocol_manager>(this, boost::ref(p), boost::ref(io_service))));
+  manager_protocol_map_.insert(
+    ManagerProtocolMapType::value_type(std::string("udp+multicast"),
+                                       boost::make_shared<multicast::multicast_protocol_manager>(this, boost::ref(p))));
+#ifdef __linux__
+  manager_protocol_map_.insert(
+    ManagerProtocolMapType::value_type(std::string("shm"),
+                                       boost::make_shared<shm::shm_protocol_manager>(this, boost::ref(p))));
+#endif
+}
+
+network_manager::~network_manager()
+{
+  // Stop the managers' threads while the maps they call into are still here
+  manager_protocol_map_.clear();
 }
 
 void network_manager::sendPacket(const darc::ID& recv_node_id, buffer::shared_buffer data)
+{
+  send(recv_node_id, link_header_packet::SERVICE, data);
+}
+
+void network_manager::send_data(const darc::ID& recv_node_id, const data_header_packet& header, buffer::shared_buffer data)
+{
+  outbound_data<darc::serializer::raw_serializer, data_header_packet> o_header(header);
+  o_header.prepend(data);
+  send(recv_node_id, link_header_packet::DATA, data);
+}
+
+bool network_manager::data_header_supported(const darc::ID& recv_node_id)
+{
+  boost::mutex::scoped_lock lock(manager_connection_mutex_);
+  if( recv_node_id == ID::null() )
+  {
+    // A broadcast is written once, so everyone must understand it
+    for( NeighbourNodesType::iterator it = neighbour_nodes_.begin(); it != neighbour_nodes_.end(); it++ )
+    {
+      if(!has_capability(it->first, discover_packet::DATA_HEADER))
+      {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  return has_capability(recv_node_id, discover_packet::DATA_HEADER);
+}
+
+bool network_manager::has_capability(const darc::ID& node_id, uint32_t capability)
+{
+  NeighbourCapabilitiesType::iterator item = neighbour_capabilities_.find(node_id);
+  return item != neighbour_capabilities_.end() &&
+    (item->second & capability) != 0;
+}
+
+void network_manager::send(const darc::ID& recv_node_id, uint16_t packet_type, buffer::shared_buffer data)
 {
   // ID::null means we send to all nodes
   if( recv_node_id == ID::null() )
   {
+    // Same link header for everyone, written once into the headroom
+    inbound_link_base::prepend_link_header(peer_.id(), ID::null(), packet_type, data, link_checksum());
+    std::set<darc::ID> shared_sent;
     for( NeighbourNodesType::iterator it = neighbour_nodes_.begin(); it != neighbour_nodes_.end(); it++ )
     {
-      // TODO: find correct protocol manager
-      manager_protocol_map_.begin()->second->send_packet(it->second, it->first, link_header_packet::SERVICE, data);
+      NeighbourNodesType::iterator shared = neighbour_shared_nodes_.find(it->first);
+      if(shared == neighbour_shared_nodes_.end())
+      {
+        send_frame(it->second, it->first, data);
+      }
+      else if(shared_sent.insert(shared->second).second)
+      {
+        send_frame(shared->second, ID::null(), data);
+      }
     }
   }
   else
@@ -72,8 +152,8 @@ void network_manager::sendPacket(const darc::ID& recv_node_id, buffer::shared_bu
     NeighbourNodesType::iterator item = neighbour_nodes_.find(recv_node_id);
     if(item != neighbour_nodes_.end())
     {
-      // TODO: find correct protocol manager
-      manager_protocol_map_.begin()->second->send_packet(item->second, recv_node_id, link_header_packet::SERVICE, data);
+      inbound_link_base::prepend_link_header(peer_.id(), recv_node_id, packet_type, data, link_checksum());
+      send_frame(item->second, recv_node_id, data);
     }
     else
     {
@@ -83,6 +163,52 @@ void network_manager::sendPacket(const darc::ID& recv_node_id, buffer::shared_bu
   }
 }
 
+void network_manager::send_frame(const darc::ID& connection_id, const darc::ID& recv_node_id, buffer::shared_buffer data)
+{
+  protocol_manager_base * manager = 0;
+  {
+    boost::mutex::scoped_lock lock(manager_connection_mutex_);
+    ManagerConnectionMapType::iterator item = manager_connection_map_.find(connection_id);
+    if(item != manager_connection_map_.end())
+    {
+      manager = item->second;
+    }
+  }
+
+  if(manager != 0)
+  {
+    manager->send_frame(connection_id, recv_node_id, data);
+  }
+  else
+  {
+    iris::glog<iris::Warning>("network_manager: sending on unknown connection",
+                              "connection_id", iris::arg<ID>(connection_id));
+  }
+}
+
+bool network_manager::shared_connection(const darc::ID& connection_id)
+{
+  boost::mutex::scoped_lock lock(manager_connection_mutex_);
+  return shared_connections_.count(connection_id) != 0;
+}
+
+void network_manager::register_connection(const ID& connection_id, protocol_manager_base * manager, bool shared)
+{
+  boost::mutex::scoped_lock lock(manager_connection_mutex_);
+  manager_connection_map_[connection_id] = manager;
+  if(shared)
+  {
+    shared_connections_.insert(connection_id);
+  }
+}
+
+void network_manager::unregister_connection(const ID& connection_id)
+{
+  boost::mutex::scoped_lock lock(manager_connection_mutex_);
+  manager_connection_map_.erase(connection_id);
+  shared_connections_.erase(connection_id);
+}
+
 void network_manager::accept(const std::string& url)
 {
   try
@@ -139,23 +265,77 @@ void network_manager::connect(const std::string& url)
 
 void network_manager::neighbour_peer_discovered(const ID& src_peer_id, const ID& connection_id)
 {
-  //todo: check if it exists already
-  neighbour_nodes_.insert(NeighbourNodesType::value_type(src_peer_id, connection_id));
-  peer_.peer_connected(src_peer_id);
+  // The peer gets our broadcasts on the shared connection anyway, and must
+  // not get them twice
+  bool shared = shared_connection(connection_id);
+  if(shared)
+  {
+    neighbour_shared_nodes_.insert(NeighbourNodesType::value_type(src_peer_id, connection_id));
+  }
+
+  // The first connection to a peer is used, further ones are not announced.
+  // A link of its own replaces a shared connection.
+  std::pair<NeighbourNodesType::iterator, bool> item =
+    neighbour_nodes_.insert(NeighbourNodesType::value_type(src_peer_id, connection_id));
+  if(item.second)
+  {
+    peer_.peer_connected(src_peer_id);
+  }
+  else if(!shared && shared_connection(item.first->second))
+  {
+    neighbour_nodes_.erase(item.first);
+    neighbour_nodes_.insert(NeighbourNodesType::value_type(src_peer_id, connection_id));
+  }
 }
 
 void network_manager::neighbour_peer_disconnected(const ID& src_peer_id, const ID& connection_id)
 {
-  // todo: verify we have the node
-  neighbour_nodes_.erase(src_peer_id);
+  // A null connection_id is the peer saying goodbye on any connection
+  NeighbourNodesType::iterator shared = neighbour_shared_nodes_.find(src_peer_id);
+  if(shared != neighbour_shared_nodes_.end() &&
+     (connection_id == ID::null() || shared->second == connection_id))
+  {
+    neighbour_shared_nodes_.erase(shared);
+    shared = neighbour_shared_nodes_.end();
+  }
+
+  NeighbourNodesType::iterator item = neighbour_nodes_.find(src_peer_id);
+  if(item == neighbour_nodes_.end() ||
+     (connection_id != ID::null() && item->second != connection_id))
+  {
+    return;
+  }
+  neighbour_nodes_.erase(item);
+
+  // Still reachable on the shared connection
+  if(shared != neighbour_shared_nodes_.end())
+  {
+    neighbour_nodes_.insert(NeighbourNodesType::value_type(src_peer_id, shared->second));
+    return;
+  }
+  {
+    boost::mutex::scoped_lock lock(manager_connection_mutex_);
+    neighbour_capabilities_.erase(src_peer_id);
+  }
   peer_.peer_disconnected(src_peer_id);
 }
 
+void network_manager::neighbour_capabilities(const ID& src_peer_id, uint32_t capabilities)
+{
+  boost::mutex::scoped_lock lock(manager_connection_mutex_);
+  neighbour_capabilities_[src_peer_id] = capabilities;
+}
+
 void network_manager::service_packet_received(const ID& src_peer_id, buffer::shared_buffer data)
 {
   peer_.recv(src_peer_id, data);
 }
 
+void network_manager::data_packet_received(const ID& src_peer_id, const data_header_packet& header, buffer::shared_buffer data)
+{
+  peer_.recv_data(src_peer_id, header, data);
+}
+
 boost::shared_ptr<protocol_manager_base>& network_manager::getManager(const std::string& protocol)
 {
   ManagerProtocolMapType::iterator elem = manager_protocol_map_.find(protocol);
@@ -169,5 +349,12 @@ boost::shared_ptr<protocol_manager_base>& network_manager::getManager(const std:
   }
 }
 
+void network_manager::link_checksum_failed(const ID& src_peer_id)
+{
+  link_checksum_failures_++;
+  iris::glog<iris::Warning>("network_manager: dropped frame with bad checksum",
+                            "peer_id", iris::arg<ID>(src_peer_id));
+}
+
 }
 }
@@ -0,0 +1,565 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#ifdef __linux__
+
+#include <darc/network/shm/shm_link.hpp>
+#include <darc/network/shm/shm_protocol_manager.hpp>
+
+#include <boost/make_shared.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <darc/buffer/raw_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/shm_buffer.hpp>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/eventfd.h>
+
+namespace darc
+{
+namespace network
+{
+namespace shm
+{
+
+namespace
+{
+
+const uint64_t hello_magic = 0x6f6c6c65686d6873ULL; // "shmhello"
+const int spin_count = 1000; // empty polls of the ring before sleeping
+
+// First message in each direction, carries the ring and eventfd of the sender
+struct link_hello
+{
+  uint64_t magic;
+  uint64_t capacity;
+  uint8_t peer_id[16];
+};
+
+// A frame read where it is in the ring, the space is released with the
+// last reference
+class shm_frame_buffer : public buffer::raw_buffer
+{
+protected:
+  shared_shm_ring ring_;
+  uint64_t sequence_;
+
+public:
+  shm_frame_buffer(shared_shm_ring ring, uint64_t sequence, char * data, size_t size) :
+    raw_buffer(data, size, size),
+    ring_(ring),
+    sequence_(sequence)
+  {
+  }
+
+  ~shm_frame_buffer()
+  {
+    ring_->release(sequence_);
+  }
+
+};
+
+bool send_fds(int socket, const void * data, size_t size, const int * fds, size_t count)
+{
+  struct iovec iov;
+  iov.iov_base = const_cast<void*>(data);
+  iov.iov_len = size;
+
+  char control[CMSG_SPACE(sizeof(int) * 2)];
+  assert(count <= 2);
+  memset(control, 0, sizeof(control));
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = CMSG_SPACE(sizeof(int) * count);
+
+  struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(int) * count);
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * count);
+
+  return sendmsg(socket, &msg, MSG_NOSIGNAL) == (ssize_t)size;
+}
+
+// Number of fds received, or -1 if the message was not exactly size bytes.
+// Received fds are closed on error.
+int recv_fds(int socket, void * data, size_t size, int * fds, size_t count, int flags)
+{
+  struct iovec iov;
+  iov.iov_base = data;
+  iov.iov_len = size;
+
+  char control[CMSG_SPACE(sizeof(int) * 2)];
+  assert(count <= 2);
+
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+
+  ssize_t received = recvmsg(socket, &msg, flags | MSG_CMSG_CLOEXEC);
+
+  int n = 0;
+  for(struct cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); received >= 0 && cmsg != 0; cmsg = CMSG_NXTHDR(&msg, cmsg))
+  {
+    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+    {
+      continue;
+    }
+    size_t cmsg_count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for(size_t i = 0; i < cmsg_count; i++)
+    {
+      int fd;
+      memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      if((size_t)n < count)
+      {
+        fds[n++] = fd;
+      }
+      else
+      {
+        close(fd);
+      }
+    }
+  }
+
+  if(received != (ssize_t)size || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) != 0)
+  {
+    for(int i = 0; i < n; i++)
+    {
+      close(fds[i]);
+    }
+    return -1;
+  }
+  return n;
+}
+
+}
+
+shm_link::shm_link(shm_protocol_manager * parent, int socket) :
+  parent_(parent),
+  socket_(socket),
+  outbound_id_(ID::create()),
+  rx_event_(-1),
+  tx_event_(-1),
+  stop_(false),
+  broken_(false),
+  dropped_(0)
+{
+}
+
+shm_link::~shm_link()
+{
+  close(socket_);
+  if(rx_event_ >= 0)
+  {
+    close(rx_event_);
+  }
+  if(tx_event_ >= 0)
+  {
+    close(tx_event_);
+  }
+}
+
+shared_shm_link shm_link::handshake(shm_protocol_manager * parent, int socket)
+{
+  shared_shm_link link(new shm_link(parent, socket));
+
+  // Bounded, so a stray connection can not hold up the listener
+  struct timeval timeout = {2, 0};
+  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  try
+  {
+    link->rx_ = shm_ring::create();
+  }
+  catch(buffer::shm_exception& e)
+  {
+    link->slog<iris::Warning>("shm: could not create ring",
+                              "errno", iris::arg<int>(*boost::get_error_info<buffer::shm_exception::error_number>(e)));
+    return shared_shm_link();
+  }
+
+  link->rx_event_ = eventfd(0, EFD_CLOEXEC);
+  if(link->rx_event_ < 0)
+  {
+    link->slog<iris::Warning>("shm: could not create eventfd",
+                              "errno", iris::arg<int>(errno));
+    return shared_shm_link();
+  }
+
+  link_hello hello;
+  hello.magic = hello_magic;
+  hello.capacity = link->rx_->capacity();
+  memcpy(hello.peer_id, parent->peer_id().data, sizeof(hello.peer_id));
+  int fds[2] = {link->rx_->fd(), link->rx_event_};
+  if(!send_fds(socket, &hello, sizeof(hello), fds, 2))
+  {
+    link->slog<iris::Warning>("shm: handshake failed, could not send",
+                              "errno", iris::arg<int>(errno));
+    return shared_shm_link();
+  }
+
+  link_hello remote;
+  int remote_fds[2] = {-1, -1};
+  if(recv_fds(socket, &remote, sizeof(remote), remote_fds, 2, 0) != 2 ||
+     remote.magic != hello_magic)
+  {
+    link->slog<iris::Warning>("shm: handshake failed, not a darc shm link");
+    close(remote_fds[0]);
+    close(remote_fds[1]);
+    return shared_shm_link();
+  }
+
+  link->tx_event_ = remote_fds[1];
+  try
+  {
+    link->tx_ = shm_ring::map(buffer::shm_buffer::map(remote_fds[0], 0));
+  }
+  catch(buffer::shm_exception& e)
+  {
+  }
+  close(remote_fds[0]);
+  if(!link->tx_)
+  {
+    link->slog<iris::Warning>("shm: handshake failed, invalid ring");
+    return shared_shm_link();
+  }
+
+  memcpy(link->remote_peer_id_.data, remote.peer_id, sizeof(remote.peer_id));
+
+  timeout.tv_sec = 0;
+  setsockopt(socket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+  link->slog<iris::Info>("shm link established",
+                         "Out-ID", iris::arg<ID>(link->outbound_id_),
+                         "Remote peer", iris::arg<ID>(link->remote_peer_id_));
+  return link;
+}
+
+bool shm_link::send(buffer::shared_buffer data)
+{
+  buffer::buffer::segment_list_type segments;
+  data->segments(segments);
+  size_t size = 0;
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    size += boost::asio::buffer_size(*it);
+  }
+
+  boost::mutex::scoped_lock lock(send_mutex_);
+
+  // Already shared memory, the receiver maps the same pages. The frame
+  // starts after the headroom.
+  buffer::shm_buffer * segment = dynamic_cast<buffer::shm_buffer*>(data.get());
+  if(segment != 0 && size >= reference_threshold)
+  {
+    return send_reference(segment->fd(), segment->headroom(), size);
+  }
+
+  if(size > tx_->max_record_size())
+  {
+    buffer::shared_shm_buffer copy;
+    try
+    {
+      copy = buffer::shm_buffer::create(size);
+    }
+    catch(buffer::shm_exception& e)
+    {
+      dropped_++;
+      slog<iris::Warning>("shm: dropped frame, could not create segment",
+                          "size", iris::arg<int>(size));
+      return false;
+    }
+    for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+        it != segments.end();
+        it++)
+    {
+      copy->streambuf()->sputn(boost::asio::buffer_cast<const char*>(*it), boost::asio::buffer_size(*it));
+    }
+    return send_reference(copy->fd(), 0, size);
+  }
+
+  char * dest = prepare(size);
+  if(dest == 0)
+  {
+    return false;
+  }
+  for(buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    memcpy(dest, boost::asio::buffer_cast<const char*>(*it), boost::asio::buffer_size(*it));
+    dest += boost::asio::buffer_size(*it);
+  }
+  tx_->commit(shm_ring::FRAME, size);
+
+  if(tx_->consumer_waiting())
+  {
+    wake(tx_event_);
+  }
+  return true;
+}
+
+char * shm_link::prepare(size_t size)
+{
+  char * dest = tx_->prepare(size);
+  if(dest != 0)
+  {
+    return dest;
+  }
+
+  // The receiver is behind, or holds on to frames in the ring
+  boost::posix_time::ptime deadline =
+    boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(send_timeout_ms);
+  for(int i = 0; dest == 0; i++)
+  {
+    if(stop_ || boost::posix_time::microsec_clock::universal_time() > deadline)
+    {
+      dropped_++;
+      slog<iris::Warning>("shm: dropped frame, receiver ring full",
+                          "Out-ID", iris::arg<ID>(outbound_id_),
+                          "size", iris::arg<int>(size));
+      return 0;
+    }
+    if(i < 100)
+    {
+      boost::this_thread::yield();
+    }
+    else
+    {
+      usleep(50);
+    }
+    dest = tx_->prepare(size);
+  }
+  return dest;
+}
+
+bool shm_link::send_reference(int fd, uint64_t offset, uint64_t size)
+{
+  // Room for the record first, the fd must not be sent without one
+  char * dest = prepare(sizeof(shm_reference));
+  if(dest == 0)
+  {
+    return false;
+  }
+
+  char byte = 'r';
+  if(!send_fds(socket_, &byte, sizeof(byte), &fd, 1))
+  {
+    dropped_++;
+    return false;
+  }
+
+  shm_reference reference;
+  reference.offset = offset;
+  reference.size = size;
+  memcpy(dest, &reference, sizeof(reference));
+  tx_->commit(shm_ring::REFERENCE, sizeof(reference));
+
+  if(tx_->consumer_waiting())
+  {
+    wake(tx_event_);
+  }
+  return true;
+}
+
+buffer::shared_buffer shm_link::map_reference(const shm_reference& reference)
+{
+  char byte;
+  int fd = -1;
+  if(recv_fds(socket_, &byte, sizeof(byte), &fd, 1, MSG_DONTWAIT) != 1)
+  {
+    return buffer::shared_buffer();
+  }
+
+  buffer::shared_shm_buffer segment;
+  struct stat st;
+  if(fstat(fd, &st) == 0 &&
+     reference.offset <= (uint64_t)st.st_size &&
+     reference.size <= (uint64_t)st.st_size - reference.offset)
+  {
+    try
+    {
+      segment = buffer::shm_buffer::map(fd, reference.offset + reference.size);
+      segment->consume(reference.offset);
+    }
+    catch(buffer::shm_exception& e)
+    {
+    }
+  }
+  close(fd);
+  return segment;
+}
+
+bool shm_link::receive()
+{
+  shm_ring::record_type type;
+  char * data;
+  size_t size;
+  uint64_t sequence;
+  if(!rx_->pop(type, data, size, sequence))
+  {
+    broken_ = broken_ || rx_->corrupt();
+    return false;
+  }
+
+  buffer::shared_buffer frame;
+  if(type == shm_ring::FRAME && size < copy_threshold)
+  {
+    // Small frames do not hold up the ring while they are queued
+    frame = buffer::chain_buffer::create(size, 0);
+    frame->streambuf()->sputn(data, size);
+    rx_->release(sequence);
+  }
+  else if(type == shm_ring::FRAME)
+  {
+    frame = boost::make_shared<shm_frame_buffer>(rx_, sequence, data, size);
+  }
+  else if(type == shm_ring::REFERENCE && size == sizeof(shm_reference))
+  {
+    shm_reference reference;
+    memcpy(&reference, data, sizeof(reference));
+    rx_->release(sequence);
+
+    frame = map_reference(reference);
+    if(!frame)
+    {
+      broken_ = true;
+      return false;
+    }
+  }
+  else
+  {
+    rx_->release(sequence);
+    broken_ = true;
+    return false;
+  }
+
+  parent_->packet_received(frame);
+  return true;
+}
+
+bool shm_link::run()
+{
+  while(!stop_)
+  {
+    if(receive())
+    {
+      continue;
+    }
+    if(broken_)
+    {
+      slog<iris::Warning>("shm: invalid data from remote, closing link",
+                          "Remote peer", iris::arg<ID>(remote_peer_id_));
+      return true;
+    }
+
+    // Short spin before sleeping, frames often come back to back
+    for(int i = 0; i < spin_count && rx_->empty(); i++)
+    {
+    }
+    if(!rx_->empty() || !rx_->prepare_wait())
+    {
+      continue;
+    }
+
+    struct pollfd fds[2];
+    fds[0].fd = rx_event_;
+    fds[0].events = POLLIN;
+    fds[1].fd = socket_;
+    fds[1].events = POLLRDHUP;
+    int n = poll(fds, 2, -1);
+    rx_->end_wait();
+
+    if(n < 0)
+    {
+      if(errno == EINTR)
+      {
+        continue;
+      }
+      slog<iris::Error>("shm: poll failed",
+                        "errno", iris::arg<int>(errno));
+      return false;
+    }
+
+    if(fds[0].revents & POLLIN)
+    {
+      uint64_t count;
+      ssize_t result = read(rx_event_, &count, sizeof(count));
+      (void)result;
+    }
+
+    if(fds[1].revents & (POLLRDHUP | POLLHUP | POLLERR))
+    {
+      // Frames committed before the other side went away
+      while(!stop_ && receive())
+      {
+      }
+      return !stop_;
+    }
+  }
+  return false;
+}
+
+void shm_link::stop()
+{
+  stop_ = true;
+  wake(rx_event_);
+}
+
+void shm_link::wake(int event_fd)
+{
+  uint64_t one = 1;
+  ssize_t result = write(event_fd, &one, sizeof(one));
+  (void)result;
+}
+
+}
+}
+}
+
+#endif
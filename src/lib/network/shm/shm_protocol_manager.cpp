@@ -0,0 +1,340 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#ifdef __linux__
+
+#include <darc/network/shm/shm_protocol_manager.hpp>
+
+#include <boost/bind.hpp>
+#include <darc/network/network_manager.hpp>
+#include <darc/network/address_in_use_exception.hpp>
+#include <darc/network/invalid_url_exception.hpp>
+#include <darc/buffer/shm_exception.hpp>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+namespace darc
+{
+namespace network
+{
+namespace shm
+{
+
+namespace
+{
+
+struct sockaddr_un unix_address(const std::string& path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(path.empty() || path.size() >= sizeof(address.sun_path))
+  {
+    throw invalid_url_exception() << invalid_url_exception::problem("Invalid unix socket path");
+  }
+  memcpy(address.sun_path, path.data(), path.size());
+  return address;
+}
+
+int unix_socket()
+{
+  int s = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+  if(s < 0)
+  {
+    throw buffer::shm_exception()
+      << buffer::shm_exception::operation("socket")
+      << buffer::shm_exception::error_number(errno);
+  }
+  return s;
+}
+
+// Somebody is listening, as opposed to a socket file left behind
+bool listening(const struct sockaddr_un& address)
+{
+  int s = unix_socket();
+  bool result = ::connect(s, (const struct sockaddr*)&address, sizeof(address)) == 0;
+  close(s);
+  return result;
+}
+
+}
+
+shm_protocol_manager::shm_protocol_manager(class network_manager * manager,
+                                           peer& p):
+  network::protocol_manager_base(),
+  network::inbound_link_base(manager, p),
+  peer_(p),
+  stopping_(false)
+{
+}
+
+shm_protocol_manager::~shm_protocol_manager()
+{
+  thread_list_type threads;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    stopping_ = true;
+    for(listen_list_type::iterator it = listen_list_.begin(); it != listen_list_.end(); it++)
+    {
+      shutdown(it->first, SHUT_RDWR); // wakes up accept()
+    }
+    for(link_list_type::iterator it = link_list_.begin(); it != link_list_.end(); it++)
+    {
+      it->second->stop();
+    }
+    threads.swap(thread_list_);
+  }
+
+  for(thread_list_type::iterator it = threads.begin(); it != threads.end(); it++)
+  {
+    (*it)->interrupt(); // connect threads waiting to retry
+    (*it)->join();
+  }
+
+  for(listen_list_type::iterator it = listen_list_.begin(); it != listen_list_.end(); it++)
+  {
+    close(it->first);
+    unlink(it->second.c_str());
+  }
+}
+
+void shm_protocol_manager::send_frame(const darc::ID& outbound_id,
+                                      const ID& topic_peer_id,
+                                      buffer::shared_buffer data)
+{
+  shared_shm_link link;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    link_list_type::iterator item = link_list_.find(outbound_id);
+    if(item != link_list_.end())
+    {
+      link = item->second;
+    }
+  }
+
+  if(!link)
+  {
+    slog<iris::Warning>("Attempting to send to unknown outbound connection",
+                        "outbound id", iris::arg<ID>(outbound_id));
+    return;
+  }
+  link->send(data);
+}
+
+void shm_protocol_manager::send_frame_to_all(const ID& topic_peer_id,
+                                             buffer::shared_buffer data)
+{
+  std::vector<shared_shm_link> links;
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    for(link_list_type::iterator it = link_list_.begin(); it != link_list_.end(); it++)
+    {
+      links.push_back(it->second);
+    }
+  }
+
+  for(std::vector<shared_shm_link>::iterator it = links.begin(); it != links.end(); it++)
+  {
+    (*it)->send(data);
+  }
+}
+
+void shm_protocol_manager::accept(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "shm");
+
+  struct sockaddr_un address = unix_address(url);
+  int s = unix_socket();
+
+  int result = bind(s, (const struct sockaddr*)&address, sizeof(address));
+  if(result != 0 && errno == EADDRINUSE && !listening(address))
+  {
+    unlink(url.c_str());
+    result = bind(s, (const struct sockaddr*)&address, sizeof(address));
+  }
+  if(result != 0 || listen(s, 16) != 0)
+  {
+    int error = errno;
+    close(s);
+    if(error == EADDRINUSE)
+    {
+      throw address_in_use_exception() << address_in_use_exception::address(url);
+    }
+    throw buffer::shm_exception()
+      << buffer::shm_exception::operation("bind")
+      << buffer::shm_exception::error_number(error);
+  }
+
+  slog<iris::Info>("shm accept",
+                   "path", iris::arg<std::string>(url));
+
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    listen_list_.push_back(listen_list_type::value_type(s, url));
+  }
+  start_thread(boost::bind(&shm_protocol_manager::listen_work, this, s));
+}
+
+void shm_protocol_manager::connect(const std::string& protocol, const std::string& url)
+{
+  assert(protocol == "shm");
+
+  unix_address(url); // throws if invalid
+
+  slog<iris::Info>("shm connect",
+                   "path", iris::arg<std::string>(url));
+
+  start_thread(boost::bind(&shm_protocol_manager::connect_work, this, url));
+}
+
+bool shm_protocol_manager::start_thread(boost::function<void()> function)
+{
+  boost::mutex::scoped_lock lock(mutex_);
+  if(stopping_)
+  {
+    return false;
+  }
+
+  // Threads of closed links
+  for(thread_list_type::iterator it = thread_list_.begin(); it != thread_list_.end();)
+  {
+    if((*it)->get_id() != boost::this_thread::get_id() &&
+       (*it)->timed_join(boost::posix_time::seconds(0)))
+    {
+      it = thread_list_.erase(it);
+    }
+    else
+    {
+      it++;
+    }
+  }
+
+  thread_list_.push_back(boost::make_shared<boost::thread>(function));
+  return true;
+}
+
+void shm_protocol_manager::listen_work(int socket)
+{
+  while(true)
+  {
+    int client = accept4(socket, 0, 0, SOCK_CLOEXEC);
+    if(client < 0)
+    {
+      if(errno == EINTR || errno == ECONNABORTED)
+      {
+        continue;
+      }
+      break; // shut down
+    }
+
+    shared_shm_link link = shm_link::handshake(this, client);
+    if(link && !start_thread(boost::bind(&shm_protocol_manager::link_work, this, link)))
+    {
+      break;
+    }
+  }
+}
+
+void shm_protocol_manager::connect_work(const std::string& path)
+{
+  struct sockaddr_un address = unix_address(path);
+  try
+  {
+    while(true)
+    {
+      {
+        boost::mutex::scoped_lock lock(mutex_);
+        if(stopping_)
+        {
+          return;
+        }
+      }
+
+      int s = unix_socket();
+      if(::connect(s, (const struct sockaddr*)&address, sizeof(address)) == 0)
+      {
+        shared_shm_link link = shm_link::handshake(this, s);
+        if(link)
+        {
+          link_work(link);
+        }
+      }
+      else
+      {
+        close(s);
+      }
+
+      boost::this_thread::sleep(boost::posix_time::milliseconds(reconnect_interval_ms));
+    }
+  }
+  catch(boost::thread_interrupted&)
+  {
+  }
+}
+
+void shm_protocol_manager::link_work(shared_shm_link link)
+{
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    if(stopping_)
+    {
+      return;
+    }
+    link_list_.insert(link_list_type::value_type(link->outbound_id(), link));
+  }
+  manager_->register_connection(link->outbound_id(), this);
+
+  sendDiscover(link->outbound_id());
+  bool remote_closed = link->run();
+
+  manager_->unregister_connection(link->outbound_id());
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    link_list_.erase(link->outbound_id());
+  }
+
+  if(remote_closed)
+  {
+    manager_->neighbour_peer_disconnected(link->remote_peer_id(), link->outbound_id());
+  }
+}
+
+} // namespace shm
+} // namespace network
+} // namespace darc
+
+#endif
@@ -0,0 +1,258 @@
+/*
+ * Copyright (c) 2013, Prevas A/S
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in the
+ *       documentation and/or other materials provided with the distribution.
+ *     * Neither the name of Prevas A/S nor the names of its
+ *       contributors may be used to endorse or promote products derived from
+ *       this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+/**
+ * \author Morten Kjaergaard
+ */
+
+#ifdef __linux__
+
+#include <darc/network/shm/shm_ring.hpp>
+
+#include <new>
+
+namespace darc
+{
+namespace network
+{
+namespace shm
+{
+
+namespace
+{
+
+const uint64_t ring_magic = 0x676e697263726164ULL; // "darcring"
+
+size_t record_size(size_t size)
+{
+  return (shm_ring::record_header_size + size + 7) & ~(size_t)7;
+}
+
+}
+
+shm_ring::shm_ring(buffer::shared_shm_buffer memory) :
+  memory_(memory),
+  control_(reinterpret_cast<control*>(memory->data())),
+  data_(memory->data() + control_size),
+  capacity_(control_->capacity),
+  prepared_padding_(0),
+  prepared_size_(0),
+  read_(control_->tail.load()),
+  pending_base_(0),
+  corrupt_(false)
+{
+}
+
+shared_shm_ring shm_ring::create(size_t capacity)
+{
+  size_t size = 4096;
+  while(size < capacity)
+  {
+    size *= 2;
+  }
+
+  buffer::shared_shm_buffer memory = buffer::shm_buffer::create(control_size + size);
+
+  control * c = new(memory->data()) control();
+  c->magic = ring_magic;
+  c->capacity = size;
+  c->head = 0;
+  c->tail = 0;
+  c->waiting = 0;
+
+  return shared_shm_ring(new shm_ring(memory));
+}
+
+shared_shm_ring shm_ring::map(buffer::shared_shm_buffer memory)
+{
+  if(memory->capacity() < control_size)
+  {
+    return shared_shm_ring();
+  }
+
+  control * c = reinterpret_cast<control*>(memory->data());
+  if(c->magic != ring_magic ||
+     c->capacity < 4096 ||
+     (c->capacity & (c->capacity - 1)) != 0 ||
+     c->capacity > memory->capacity() - control_size)
+  {
+    return shared_shm_ring();
+  }
+  return shared_shm_ring(new shm_ring(memory));
+}
+
+char * shm_ring::prepare(size_t size)
+{
+  assert(size <= max_record_size());
+
+  uint64_t head = control_->head.load(boost::memory_order_relaxed);
+  uint64_t tail = control_->tail.load(boost::memory_order_acquire);
+  uint64_t offset = head & (capacity_ - 1);
+  size_t needed = record_size(size);
+
+  // Records are contiguous, so a record which would cross the end is put at
+  // the start, behind padding
+  size_t padding = 0;
+  if(offset + needed > capacity_)
+  {
+    padding = capacity_ - offset;
+  }
+
+  if(capacity_ - (head - tail) < padding + needed)
+  {
+    return 0;
+  }
+
+  if(padding > 0)
+  {
+    record_header * pad = reinterpret_cast<record_header*>(data_ + offset);
+    pad->size = padding - record_header_size;
+    pad->type = PADDING;
+    offset = 0;
+  }
+
+  prepared_padding_ = padding;
+  prepared_size_ = size;
+  return data_ + offset + record_header_size;
+}
+
+void shm_ring::commit(record_type type, size_t size)
+{
+  assert(size <= prepared_size_);
+
+  uint64_t head = control_->head.load(boost::memory_order_relaxed) + prepared_padding_;
+  uint64_t offset = head & (capacity_ - 1);
+
+  record_header * header = reinterpret_cast<record_header*>(data_ + offset);
+  header->size = size;
+  header->type = type;
+
+  control_->head.store(head + record_size(size), boost::memory_order_release);
+  prepared_padding_ = 0;
+  prepared_size_ = 0;
+}
+
+bool shm_ring::consumer_waiting()
+{
+  // Pairs with the fence in prepare_wait(), either the consumer sees the new
+  // head or we see it waiting
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  return control_->waiting.load(boost::memory_order_relaxed) != 0 &&
+    control_->waiting.exchange(0) != 0;
+}
+
+bool shm_ring::pop(record_type& type, char *& data, size_t& size, uint64_t& sequence)
+{
+  while(true)
+  {
+    uint64_t head = control_->head.load(boost::memory_order_acquire);
+    if(read_ == head)
+    {
+      return false;
+    }
+
+    uint64_t offset = read_ & (capacity_ - 1);
+    const record_header * header = reinterpret_cast<const record_header*>(data_ + offset);
+    size_t total = record_size(header->size);
+
+    // The producer is another process, do not trust it with our memory
+    if(offset + total > capacity_ || read_ + total > head)
+    {
+      corrupt_ = true;
+      return false;
+    }
+
+    {
+      boost::mutex::scoped_lock lock(release_mutex_);
+      pending_record record = {read_ + total, false};
+      pending_.push_back(record);
+      sequence = pending_base_ + pending_.size() - 1;
+    }
+    read_ += total;
+
+    if(header->type == PADDING)
+    {
+      release(sequence);
+      continue;
+    }
+
+    type = static_cast<record_type>(header->type);
+    data = data_ + offset + record_header_size;
+    size = header->size;
+    return true;
+  }
+}
+
+void shm_ring::release(uint64_t sequence)
+{
+  boost::mutex::scoped_lock lock(release_mutex_);
+  assert(sequence >= pending_base_ && sequence - pending_base_ < pending_.size());
+  pending_[sequence - pending_base_].released = true;
+
+  uint64_t tail = 0;
+  while(!pending_.empty() && pending_.front().released)
+  {
+    tail = pending_.front().end;
+    pending_.pop_front();
+    pending_base_++;
+  }
+  if(tail != 0)
+  {
+    control_->tail.store(tail, boost::memory_order_release);
+  }
+}
+
+bool shm_ring::prepare_wait()
+{
+  control_->waiting.store(1, boost::memory_order_relaxed);
+  boost::atomic_thread_fence(boost::memory_order_seq_cst);
+  if(!empty())
+  {
+    control_->waiting.store(0, boost::memory_order_relaxed);
+    return false;
+  }
+  return true;
+}
+
+void shm_ring::end_wait()
+{
+  control_->waiting.store(0, boost::memory_order_relaxed);
+}
+
+bool shm_ring::empty()
+{
+  return control_->head.load(boost::memory_order_acquire) == read_;
+}
+
+}
+}
+}
+
+#endif
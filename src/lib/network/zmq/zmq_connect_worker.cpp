@@ -34,6 +34,7 @@
 #include <darc/network/zmq/zmq_connect_worker.hpp>
 #include <darc/network/zmq/zmq_protocol_manager.hpp>
 #include <darc/network/zmq/zmq_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
 
 namespace darc
 {
@@ -60,27 +61,38 @@ zmq_connect_worker::zmq_connect_worker(zmq_protocol_manager * parent,
 
 void zmq_connect_worker::work_receive()
 {
-  zmq::message_t topic_msg;
-  boost::shared_ptr<zmq_buffer> header_msg = boost::make_shared<zmq_buffer>();
-  boost::shared_ptr<zmq_buffer> body_msg = boost::make_shared<zmq_buffer>();
+  boost::shared_ptr<zmq_buffer> data_msg = buffer_cache_.acquire();
 
-  assert(socket_.recv(&topic_msg));
+  bool received = socket_.recv(&topic_msg_);
+  assert(received);
   assert(has_more());
 
-  assert(socket_.recv(header_msg.get()));
-  assert(has_more());
-
-  assert(socket_.recv(body_msg.get()));
-//  assert(!has_more());
+  received = socket_.recv(data_msg.get());
+  assert(received);
 
-  header_msg->update_buffer();
-  body_msg->update_buffer();
+  data_msg->update_buffer();
 
   slog<iris::Debug>("ZeroMQ message",
-                    "size1", iris::arg<int>(header_msg->size()),
-                    "size2", iris::arg<int>(body_msg->size()));
+                    "size", iris::arg<int>(data_msg->size()));
+
+  if(!has_more())
+  {
+    parent_->packet_received(data_msg);
+    return;
+  }
+
+  // Segmented data, chain the frames without copying
+  buffer::shared_chain_buffer data_chain = buffer::chain_buffer::create();
+  data_chain->append(data_msg);
+  while(has_more())
+  {
+    boost::shared_ptr<zmq_buffer> segment_msg = buffer_cache_.acquire();
+    socket_.recv(segment_msg.get());
+    segment_msg->update_buffer();
+    data_chain->append(segment_msg);
+  }
 
-  parent_->packet_received(header_msg, body_msg);
+  parent_->packet_received(data_chain);
 }
 
 }
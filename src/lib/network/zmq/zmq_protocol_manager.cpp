@@ -44,8 +44,14 @@
 #include <darc/network/network_manager.hpp>
 #include <darc/network/address_in_use_exception.hpp>
 
+#include <darc/network/invalid_url_exception.hpp>
+
 #include <iris/glog.hpp>
 
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
 using namespace boost::asio;
 
 namespace darc
@@ -55,6 +61,47 @@ namespace network
 namespace zeromq
 {
 
+namespace
+{
+
+// zmq endpoint for a darc protocol and address
+std::string zmq_endpoint(const std::string& protocol, const std::string& url)
+{
+  if(protocol == "zmq+ipc")
+  {
+    struct sockaddr_un address;
+    if(url.empty() || url.size() >= sizeof(address.sun_path))
+    {
+      throw invalid_url_exception() << invalid_url_exception::problem("Invalid ipc path");
+    }
+    return std::string("ipc://").append(url);
+  }
+
+  assert(protocol == "zmq+tcp");
+  return std::string("tcp://").append(url);
+}
+
+// zmq removes an existing ipc socket file when binding, also if it belongs
+// to a running peer, so check first
+bool ipc_in_use(const std::string& path)
+{
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  memcpy(address.sun_path, path.data(), path.size());
+
+  int s = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if(s < 0)
+  {
+    return false;
+  }
+  bool result = ::connect(s, (const struct sockaddr*)&address, sizeof(address)) == 0;
+  close(s);
+  return result;
+}
+
+}
+
 zmq_protocol_manager::zmq_protocol_manager(class network_manager * manager,
                          peer& p):
   network::protocol_manager_base(),
@@ -68,77 +115,64 @@ zmq_protocol_manager::~zmq_protocol_manager()
 {
 }
 
-void zmq_protocol_manager::send_packet(const darc::ID& outbound_id,
-                             const ID& dest_peer_id,
-                             const uint16_t packet_type,
-                             buffer::shared_buffer data)
+void zmq_protocol_manager::send_frame(const darc::ID& outbound_id,
+                                      const ID& topic_peer_id,
+                                      buffer::shared_buffer data)
 {
-  // Create the Link Header Packet: do it somewhere else Base Class
-  //
-  link_header_packet lhp;
-  lhp.packet_type = packet_type;
-  lhp.dest_peer_id = dest_peer_id;
-  lhp.src_peer_id = peer_.id();
-  outbound_data<darc::serializer::boost_serializer, link_header_packet> o_lhp(lhp);
-
-  buffer::shared_buffer header_data = boost::make_shared<buffer::const_size_buffer>(1024); // todo
-
-  o_lhp.pack(header_data);
-
-  //
-  zmq::message_t topic_msg(dest_peer_id.size());
-  memcpy(topic_msg.data(), dest_peer_id.data, dest_peer_id.size());
+  listen_list_type::iterator item = listen_list_.find(outbound_id);
+  if(item == listen_list_.end())
+  {
+    slog<iris::Warning>("Attempting to send to unknown outbound connection",
+                        "outbound id", iris::arg<ID>(outbound_id));
+    return;
+  }
 
   //
-  buffer::shared_buffer * keep_alive1 = new buffer::shared_buffer(header_data);
-  zmq::message_t message1((void*)header_data->data(),
-                          1024,//data->len(),
-                          &zmq_buffer::free_func,
-                          keep_alive1);
-  //
-
-  buffer::shared_buffer * keep_alive2 = new buffer::shared_buffer(data);
-  zmq::message_t message2((void*)data->data(),
-                          1024,//data->len(),
-                          &zmq_buffer::free_func,
-                          keep_alive2);
-
-  listen_list_type::iterator item = listen_list_.find(outbound_id);
-  if(item != listen_list_.end())
+  zmq::message_t topic_msg(topic_peer_id.size());
+  memcpy(topic_msg.data(), topic_peer_id.data, topic_peer_id.size());
+  item->second->socket().send(topic_msg, ZMQ_SNDMORE);
+
+  // One frame per segment, each keeping the whole buffer alive. Headers are
+  // prepended in place, so normally this is a single frame.
+  buffer::buffer::segment_list_type segments;
+  data->segments(segments);
+  if(segments.empty())
   {
-    item->second->socket().send(topic_msg, ZMQ_SNDMORE);
-    item->second->socket().send(message1, ZMQ_SNDMORE);
-    item->second->socket().send(message2);
+    segments.push_back(boost::asio::const_buffer());
   }
-  else
+
+  for(size_t i = 0; i < segments.size(); i++)
   {
-    slog<iris::Warning>("Attempting to send to unknown outbound connection",
-                        "outbound id", iris::arg<ID>(outbound_id));
+    buffer::shared_buffer * keep_alive = new buffer::shared_buffer(data);
+    zmq::message_t message((void*)boost::asio::buffer_cast<const char*>(segments[i]),
+                           boost::asio::buffer_size(segments[i]),
+                           &zmq_buffer::free_func,
+                           keep_alive);
+    item->second->socket().send(message, (i + 1 < segments.size()) ? ZMQ_SNDMORE : 0);
   }
 }
 
-void zmq_protocol_manager::send_packet_to_all(const ID& dest_peer_id,
-                                         const uint16_t packet_type,
-                                         buffer::shared_buffer data)
+void zmq_protocol_manager::send_frame_to_all(const ID& topic_peer_id,
+                                             buffer::shared_buffer data)
 {
-  // todo, only create the packet once and send to all
   for(listen_list_type::iterator it = listen_list_.begin();
       it != listen_list_.end();
       it++)
   {
-   send_packet(it->first,
-               dest_peer_id,
-               packet_type,
+    send_frame(it->first,
+               topic_peer_id,
                data);
   }
-
 }
 
 void zmq_protocol_manager::accept(const std::string& protocol, const std::string& url )
 {
-  assert(protocol == "zmq+tcp");
+  std::string zmq_url = zmq_endpoint(protocol, url);
 
-  std::string zmq_url = std::string("tcp://").append(url);
+  if(protocol == "zmq+ipc" && ipc_in_use(url))
+  {
+    throw address_in_use_exception() << address_in_use_exception::address(url);
+  }
 
   try
   {
@@ -146,6 +180,7 @@ void zmq_protocol_manager::accept(const std::string& protocol, const std::string
                                                                                         zmq_url,
                                                                                         boost::ref(*context_));
     listen_list_.insert(listen_list_type::value_type(worker->id(), worker));
+    network_manager()->register_connection(worker->id(), this);
   }
   catch(zmq::error_t& e)
   {
@@ -163,9 +198,7 @@ void zmq_protocol_manager::accept(const std::string& protocol, const std::string
 
 void zmq_protocol_manager::connect(const std::string& protocol, const std::string& url)
 {
-  assert(protocol == "zmq+tcp");
-
-  std::string zmq_url = std::string("tcp://").append(url);
+  std::string zmq_url = zmq_endpoint(protocol, url);
 
   boost::shared_ptr<zmq_connect_worker> worker = boost::make_shared<zmq_connect_worker>(this,
                                                                                         zmq_url,
@@ -33,9 +33,11 @@
 
 #include <darc/peer/peer.hpp>
 #include <darc/peer/peer_service.hpp>
-#include <darc/buffer/const_size_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/buffer/memory_accounting.hpp>
 #include <darc/network/inbound_data.hpp>
-#include <darc/serializer/boost.hpp>
+#include <darc/serializer/raw.hpp>
 
 #include <iris/glog.hpp>
 #include <darc/id_arg.hpp>
@@ -43,14 +45,32 @@
 namespace darc
 {
 
+namespace
+{
+
+// Bytes to allocate up front for data. Exact when the allocator can not
+// grow, otherwise only the hint, as serialized_size() may be a full dry
+// run of the serialization. Chains charge what they grow by beyond it.
+size_t payload_size(const outbound_data_base& data, buffer::buffer_allocator * allocator)
+{
+  if(allocator != 0 && allocator->exact_size())
+  {
+    return data.serialized_size();
+  }
+  size_t hint = data.size_hint();
+  return hint != 0 ? hint : buffer::chain_buffer::default_chunk_size;
+}
+
+}
+
 void peer::recv(const ID& src_peer_id, buffer::shared_buffer data)
 {
-  inbound_data<darc::serializer::boost_serializer, service_header_packet> header_i(data);
+  inbound_data<darc::serializer::raw_serializer, service_header_packet> header_i(data);
 
   service_list_type::iterator item = service_list_.find(header_i.get().service_type);
   if(item != service_list_.end())
   {
-    item->second->recv(src_peer_id, data);
+    item->second->recv(src_peer_id, buffer::slice_buffer::unread(data));
   }
   else
   {
@@ -59,16 +79,69 @@ void peer::recv(const ID& src_peer_id, buffer::shared_buffer data)
   }
 }
 
-void peer::send_to(const ID& peer_id, service_type service, const outbound_data_base& data)
+void peer::recv_data(const ID& src_peer_id, const data_header_packet& header, buffer::shared_buffer data)
+{
+  service_list_type::iterator item = service_list_.find(header.service_type);
+  if(item != service_list_.end())
+  {
+    item->second->recv_data(src_peer_id, header, data);
+  }
+  else
+  {
+    iris::glog<iris::Warning>("Received Data for unknown service id",
+                              "service", iris::arg<uint32_t>(header.service_type));
+  }
+}
+
+bool peer::data_header_supported(const ID& peer_id)
+{
+  return data_header_supported_function_ && data_header_supported_function_(peer_id);
+}
+
+void peer::send_data(const ID& peer_id, const data_header_packet& header, const outbound_data_base& data,
+                     buffer::buffer_allocator * allocator)
+{
+  assert(send_data_function_);
+
+  // The data header and the link header go in the default headroom
+  size_t size = payload_size(data, allocator);
+  buffer::shared_buffer buffer;
+  if(allocator != 0)
+  {
+    buffer = allocator->allocate(size, buffer::chain_buffer::default_headroom);
+  }
+  else
+  {
+    buffer::accounting_allocator accounting(buffer::memory_tag(header.service_type, header.tag_id, peer_id));
+    buffer = accounting.allocate(size, buffer::chain_buffer::default_headroom);
+  }
+  data.pack(buffer);
+
+  send_data_function_(peer_id, header, buffer);
+}
+
+void peer::send_to(const ID& peer_id, service_type service, const outbound_data_base& data,
+                   buffer::buffer_allocator * allocator)
 {
   service_header_packet header;
   header.service_type = service;
-  outbound_data<darc::serializer::boost_serializer, service_header_packet> o_header(header);
+  outbound_data<darc::serializer::raw_serializer, service_header_packet> o_header(header);
 
-  outbound_pair o_merge(o_header, data);
-
-  buffer::shared_buffer buffer = boost::make_shared<buffer::const_size_buffer>(1024*10); // todo
-  o_merge.pack(buffer);
+  // Room for the headers in front
+  size_t headroom = o_header.serialized_size() + buffer::chain_buffer::default_headroom;
+  size_t size = payload_size(data, allocator);
+  buffer::shared_buffer buffer;
+  if(allocator != 0)
+  {
+    buffer = allocator->allocate(size, headroom);
+  }
+  else
+  {
+    buffer::accounting_allocator accounting(buffer::memory_tag(service, ID::null(), peer_id));
+    buffer = accounting.allocate(size, headroom);
+  }
+  data.pack(buffer);
+  o_header.prepend(buffer);
 
   send_to_function_(peer_id, buffer);
 }
@@ -32,6 +32,8 @@
  */
 
 #include <darc/primitives/pubsub/message_service.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/buffer/memory_accounting.hpp>
 
 namespace darc
 {
@@ -57,25 +59,31 @@ message_service::message_service(peer& p, boost::asio::io_service& io_service, n
 void message_service::recv(const darc::ID& src_peer_id,
                            darc::buffer::shared_buffer data)
 {
-  darc::inbound_data<darc::serializer::boost_serializer,
+  darc::inbound_data<darc::serializer::raw_serializer,
                      payload_header_packet> payload_type_i(data);
+  darc::buffer::shared_buffer payload = darc::buffer::slice_buffer::unread(data);
   switch(payload_type_i.get().payload_type)
   {
   case subscribe_packet::payload_id:
   {
-    handle_subscribe_packet(src_peer_id, data);
+    handle_subscribe_packet(src_peer_id, payload);
   }
   break;
   case publish_packet::payload_id:
   {
-    handle_publish_packet(src_peer_id, data);
+    handle_publish_packet(src_peer_id, payload);
   }
   break;
   case message_packet::payload_id:
+  case message_packet::compressed_payload_id:
+  case message_packet::delta_payload_id:
   {
-
-    // Just send the buffer to the dispatcher. not the nicest way
-    handle_message_packet(src_peer_id, data);
+    handle_message_packet(src_peer_id, payload, payload_type_i.get().payload_type);
+  }
+  break;
+  case keyframe_request_packet::payload_id:
+  {
+    handle_keyframe_request_packet(src_peer_id, payload);
   }
   break;
   default:
@@ -92,18 +100,100 @@ void message_service::recv(const darc::ID& src_peer_id,
  * Callback from remote_dispatcher when a message is received.
  */
 void message_service::handle_message_packet(const ID& remote_peer_id,
-                                            darc::buffer::shared_buffer data)
+                                            darc::buffer::shared_buffer data,
+                                            uint32_t payload_type)
 {
-  inbound_data<serializer::boost_serializer, message_packet> msg_i(data);
-  const ID& tag_id = msg_i.get().tag_id;
+  inbound_data<serializer::raw_serializer, message_packet> msg_i(data);
+  dispatch_remote_message(remote_peer_id, msg_i.get().tag_id, darc::buffer::slice_buffer::unread(data),
+                          payload_type);
+}
 
+/**
+ * Messages sent with the compact data header, see send_msg.
+ */
+void message_service::recv_data(const ID& remote_peer_id,
+                                const data_header_packet& header,
+                                darc::buffer::shared_buffer data)
+{
+  if(header.payload_type == message_packet::payload_id ||
+     header.payload_type == message_packet::compressed_payload_id ||
+     header.payload_type == message_packet::delta_payload_id)
+  {
+    dispatch_remote_message(remote_peer_id, header.tag_id, data, header.payload_type);
+  }
+  else
+  {
+    iris::glog<iris::Warning>
+      ("Unknown payload in data header",
+       "payload_id:", iris::arg<int>(header.payload_type));
+  }
+}
+
+void message_service::dispatch_remote_message(const ID& remote_peer_id,
+                                              const ID& tag_id,
+                                              darc::buffer::shared_buffer msg_data,
+                                              uint32_t payload_type)
+{
   //boost::mutex::scoped_lock lock(mutex_);
 
   dispatcher_list_type::iterator elem =
     dispatcher_list_.find(tag_id);
   if(elem != dispatcher_list_.end())
   {
-    elem->second->remote_message_recv(tag_id, data);
+    bool verified = false;
+    {
+      boost::mutex::scoped_lock lock(remote_type_list_mutex_);
+      remote_type_list_type::iterator remote_type =
+        remote_type_list_.find(std::make_pair(remote_peer_id, tag_id));
+      if(remote_type != remote_type_list_.end())
+      {
+        if(!accept_remote_type(remote_type->second, *elem->second))
+        {
+          return;
+        }
+        verified = true;
+      }
+    }
+
+    // Not worth expanding what nobody will decode
+    if(payload_type == message_packet::compressed_payload_id)
+    {
+      if(!elem->second->has_subscribers())
+      {
+        return;
+      }
+      msg_data = darc::compression::compression_stage::decompress(msg_data);
+      if(msg_data.get() == 0)
+      {
+        iris::glog<iris::Warning>("message_service: dropping message that failed to decompress",
+                                  "peer_id", iris::arg<ID>(remote_peer_id),
+                                  "tag_id", iris::arg<ID>(tag_id));
+        return;
+      }
+    }
+    // Deltas are applied regardless, to keep up with the stream
+    else if(payload_type == message_packet::delta_payload_id)
+    {
+      bool request_keyframe = false;
+      {
+        boost::mutex::scoped_lock lock(delta_decoders_mutex_);
+        msg_data = delta_decoders_[std::make_pair(remote_peer_id, tag_id)].decode(msg_data, request_keyframe);
+      }
+      if(request_keyframe)
+      {
+        send_keyframe_request(remote_peer_id, tag_id);
+      }
+      if(msg_data.get() == 0)
+      {
+        return;
+      }
+    }
+
+    msg_data = darc::buffer::memory_accounting::instance().charge(
+      darc::buffer::memory_tag(service_id_, tag_id, remote_peer_id),
+      msg_data,
+      msg_data->len());
+    elem->second->remote_message_recv(tag_id, msg_data, verified);
   }
   else
   {
@@ -117,13 +207,63 @@ void message_service::handle_publish_packet(const ID& remote_peer_id,
                                             darc::buffer::shared_buffer data)
 {
   inbound_data<serializer::boost_serializer, publish_packet> pub_i(data);
+
+  // Peers that do not advertise a fingerprint are decoded checked
+  if(pub_i.get().type_fingerprint != 0)
+  {
+    boost::mutex::scoped_lock lock(remote_type_list_mutex_);
+    remote_type_record& record =
+      remote_type_list_[std::make_pair(remote_peer_id, pub_i.get().topic_id)];
+    record.type_fingerprint = pub_i.get().type_fingerprint;
+    record.type_name = pub_i.get().type_name;
+    record.rejected = false;
+
+    dispatcher_list_type::iterator elem =
+      dispatcher_list_.find(pub_i.get().topic_id);
+    if(elem != dispatcher_list_.end())
+    {
+      accept_remote_type(record, *elem->second);
+    }
+  }
+
   topic_change_signal_(true, pub_i.get().topic_id, pub_i.get().topic_name, pub_i.get().type_name);
 }
 
 void message_service::handle_subscribe_packet(const ID& remote_peer_id,
                                             darc::buffer::shared_buffer data)
 {
-  inbound_data<serializer::boost_serializer, subscribe_packet> sub_i(data);
+  inbound_data<serializer::raw_serializer, subscribe_packet> sub_i(data);
+
+  // The subscriber drops what it can not decode, this is just to tell
+  dispatcher_list_type::iterator elem =
+    dispatcher_list_.find(sub_i.get().topic_id);
+  if(elem != dispatcher_list_.end() &&
+     sub_i.get().type_fingerprint != 0 &&
+     sub_i.get().type_fingerprint != elem->second->type_fingerprint())
+  {
+    iris::glog<iris::Warning>("message_service: remote subscriber expects another type",
+                              "peer_id", iris::arg<ID>(remote_peer_id),
+                              "tag_id", iris::arg<ID>(sub_i.get().topic_id),
+                              "local", iris::arg<std::string>(elem->second->type_name()));
+  }
+}
+
+bool message_service::accept_remote_type(remote_type_record& record,
+                                         const local_dispatcher_base& dispatcher)
+{
+  if(record.type_fingerprint == dispatcher.type_fingerprint())
+  {
+    return true;
+  }
+
+  if(!record.rejected)
+  {
+    iris::glog<iris::Warning>("message_service: rejecting remote publisher with another type",
+                              "remote", iris::arg<std::string>(record.type_name),
+                              "local", iris::arg<std::string>(dispatcher.type_name()));
+    record.rejected = true;
+  }
+  return false;
 }
 
 void message_service::peer_connected_handler(const ID& peer_id)
@@ -138,30 +278,76 @@ void message_service::peer_connected_handler(const ID& peer_id)
 
 void message_service::peer_disconnected_handler(const ID& peer_id)
 {
+  {
+    boost::mutex::scoped_lock lock(remote_type_list_mutex_);
+    remote_type_list_type::iterator it =
+      remote_type_list_.lower_bound(std::make_pair(peer_id, ID::null()));
+    while(it != remote_type_list_.end() && it->first.first == peer_id)
+    {
+      remote_type_list_.erase(it++);
+    }
+  }
+
+  boost::mutex::scoped_lock lock(delta_decoders_mutex_);
+  delta_decoder_list_type::iterator delta_it =
+    delta_decoders_.lower_bound(std::make_pair(peer_id, ID::null()));
+  while(delta_it != delta_decoders_.end() && delta_it->first.first == peer_id)
+  {
+    delta_decoders_.erase(delta_it++);
+  }
 
 }
 
-void message_service::send_subscription(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name)
+void message_service::send_subscription(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name,
+                                        uint64_t type_fingerprint)
 {
   payload_header_packet hdr;
   hdr.payload_type = subscribe_packet::payload_id;
-  outbound_data<serializer::boost_serializer, payload_header_packet> o_hdr(hdr);
+  outbound_data<serializer::raw_serializer, payload_header_packet> o_hdr(hdr);
 
-  subscribe_packet sub(tag_id);//, tag_name, type_name);
-  outbound_data<serializer::boost_serializer, subscribe_packet> o_sub(sub);
+  subscribe_packet sub(tag_id, type_fingerprint);
+  outbound_data<serializer::raw_serializer, subscribe_packet> o_sub(sub);
 
   outbound_pair o_combined(o_hdr, o_sub);
 
   send_to(peer_id, o_combined);
 }
 
-void message_service::send_publish(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name)
+void message_service::send_keyframe_request(const ID& peer_id, const ID& tag_id)
+{
+  payload_header_packet hdr;
+  hdr.payload_type = keyframe_request_packet::payload_id;
+  outbound_data<serializer::raw_serializer, payload_header_packet> o_hdr(hdr);
+
+  keyframe_request_packet req(tag_id);
+  outbound_data<serializer::raw_serializer, keyframe_request_packet> o_req(req);
+
+  outbound_pair o_combined(o_hdr, o_req);
+
+  send_to(peer_id, o_combined);
+}
+
+void message_service::handle_keyframe_request_packet(const ID& remote_peer_id,
+                                                     darc::buffer::shared_buffer data)
+{
+  inbound_data<serializer::raw_serializer, keyframe_request_packet> req_i(data);
+
+  dispatcher_list_type::iterator elem =
+    dispatcher_list_.find(req_i.get().tag_id);
+  if(elem != dispatcher_list_.end())
+  {
+    elem->second->request_keyframe();
+  }
+}
+
+void message_service::send_publish(const ID& peer_id, const ID& tag_id, const std::string& tag_name, const std::string& type_name,
+                                   uint64_t type_fingerprint)
 {
   payload_header_packet hdr;
   hdr.payload_type = publish_packet::payload_id;
-  outbound_data<serializer::boost_serializer, payload_header_packet> o_hdr(hdr);
+  outbound_data<serializer::raw_serializer, payload_header_packet> o_hdr(hdr);
 
-  publish_packet pub(tag_id, tag_name, type_name);
+  publish_packet pub(tag_id, tag_name, type_name, type_fingerprint);
   outbound_data<serializer::boost_serializer, publish_packet> o_pub(pub);
 
   outbound_pair o_combined(o_hdr, o_pub);
@@ -169,25 +355,75 @@ void message_service::send_publish(const ID& peer_id, const ID& tag_id, const st
   send_to(peer_id, o_combined);
 }
 
-void message_service::send_msg(const ID& tag_id, const ID& peer_id, const outbound_data_base &msg_data)
+void message_service::send_msg(const ID& tag_id, const ID& peer_id, const outbound_data_base &msg_data,
+                               darc::buffer::buffer_allocator * allocator,
+                               darc::compression::compression_stage * compression,
+                               darc::compression::delta_encoder * delta)
+{
+  // Charged to the topic and destination for as long as the frame is held
+  darc::buffer::accounting_allocator accounting(darc::buffer::memory_tag(service_id_, tag_id, peer_id),
+                                                allocator);
+
+  // Deltas are small already and go without compression
+  if(delta != 0)
+  {
+    outbound_buffer o_delta(delta->encode(msg_data));
+    send_payload(tag_id, peer_id, message_packet::delta_payload_id, o_delta, &accounting);
+    return;
+  }
+
+  if(compression != 0)
+  {
+    // Sent from the packed buffer, also when it did not compress well
+    darc::buffer::shared_buffer packed;
+    bool compressed = compression->compress(msg_data, packed);
+    if(packed.get() != 0)
+    {
+      outbound_buffer o_packed(packed);
+      send_payload(tag_id, peer_id,
+                   compressed ? message_packet::compressed_payload_id : message_packet::payload_id,
+                   o_packed, &accounting);
+      return;
+    }
+  }
+
+  send_payload(tag_id, peer_id, message_packet::payload_id, msg_data, &accounting);
+}
+
+void message_service::send_payload(const ID& tag_id, const ID& peer_id, uint16_t payload_type,
+                                   const outbound_data_base& msg_data,
+                                   darc::buffer::buffer_allocator * allocator)
 {
+  // One compact header when the receivers understand it
+  if(data_header_supported(peer_id))
+  {
+    data_header_packet data_hdr;
+    data_hdr.payload_type = payload_type;
+    data_hdr.tag_id = tag_id;
+    send_data(peer_id, data_hdr, msg_data, allocator);
+    return;
+  }
+
   payload_header_packet hdr;
-  hdr.payload_type = message_packet::payload_id;
-  outbound_data<serializer::boost_serializer, payload_header_packet> o_hdr(hdr);
+  hdr.payload_type = payload_type;
+  outbound_data<serializer::raw_serializer, payload_header_packet> o_hdr(hdr);
 
   message_packet msg_hdr(tag_id);
-  outbound_data<serializer::boost_serializer, message_packet> o_msg_hdr(msg_hdr);
+  outbound_data<serializer::raw_serializer, message_packet> o_msg_hdr(msg_hdr);
 
 
   outbound_pair o_pair1(o_hdr, o_msg_hdr);
   outbound_pair o_pair2(o_pair1, msg_data);
 
-  send_to(peer_id, o_pair2);
+  send_to(peer_id, o_pair2, allocator);
 }
 
-void message_service::dispatch_remotely(const ID& tag_id, const outbound_data_base &msg_data)
+void message_service::dispatch_remotely(const ID& tag_id, const outbound_data_base &msg_data,
+                                        darc::buffer::buffer_allocator * allocator,
+                                        darc::compression::compression_stage * compression,
+                                        darc::compression::delta_encoder * delta)
 {
-  send_msg(tag_id, ID::null(), msg_data);
+  send_msg(tag_id, ID::null(), msg_data, allocator, compression, delta);
   /*
   remote_list_type::iterator item = list_.find(tag_id);
   if(item != list_.end())
@@ -0,0 +1,112 @@
+#include <iostream>
+#include <new>
+#include <cstdlib>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+
+#include <darc/buffer/const_size_buffer.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/serializer/boost.hpp>
+#include <darc/peer/peer.hpp>
+
+// Count every heap allocation made by the process
+static size_t allocation_count = 0;
+
+void * operator new(size_t size) throw(std::bad_alloc)
+{
+  allocation_count++;
+  void * p = malloc(size);
+  if(p == 0)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) throw()
+{
+  free(p);
+}
+
+const int iterations = 100000;
+
+void report(const std::string& name, size_t allocations, boost::posix_time::time_duration duration)
+{
+  std::cout << name
+            << ": " << (double)allocations / iterations << " allocations/publish, "
+            << (double)duration.total_nanoseconds() / iterations << " ns/publish"
+            << std::endl;
+}
+
+// What peer::send_to and zmq_protocol_manager::send_packet used to do per
+// message. Serialization is left out as boost archives do their own allocations.
+void run_heap()
+{
+  uint32_t value = 42;
+
+  size_t start_count = allocation_count;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    darc::buffer::shared_buffer body = boost::make_shared<darc::buffer::const_size_buffer>(1024*10);
+    body->streambuf()->sputn((char*)&value, sizeof(value));
+    darc::buffer::shared_buffer header = boost::make_shared<darc::buffer::const_size_buffer>(1024);
+    header->streambuf()->sputn((char*)&value, sizeof(value));
+  }
+  report("heap const_size_buffer",
+         allocation_count - start_count,
+         boost::posix_time::microsec_clock::universal_time() - start);
+}
+
+void run_pooled()
+{
+  uint32_t value = 42;
+
+  size_t start_count = allocation_count;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    darc::buffer::shared_buffer body = darc::buffer::pooled_buffer::create(1024*10);
+    body->streambuf()->sputn((char*)&value, sizeof(value));
+    darc::buffer::shared_buffer header = darc::buffer::pooled_buffer::create(1024);
+    header->streambuf()->sputn((char*)&value, sizeof(value));
+  }
+  report("pooled_buffer",
+         allocation_count - start_count,
+         boost::posix_time::microsec_clock::universal_time() - start);
+}
+
+void drop(const darc::ID& peer_id, darc::buffer::shared_buffer data)
+{
+}
+
+void run_peer()
+{
+  darc::peer p;
+  p.set_send_to_function(boost::bind(&drop, _1, _2));
+
+  uint32_t value = 42;
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_value(value);
+
+  size_t start_count = allocation_count;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    p.send_to(darc::ID::null(), 13, o_value);
+  }
+  report("peer::send_to (incl. boost archives)",
+         allocation_count - start_count,
+         boost::posix_time::microsec_clock::universal_time() - start);
+}
+
+int main()
+{
+  run_heap();
+  // warm up the pool before measuring
+  darc::buffer::pooled_buffer::create(1024*10);
+  darc::buffer::pooled_buffer::create(1024);
+  run_pooled();
+  run_peer();
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <vector>
+#include <sys/resource.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include <darc/buffer/huge_page_arena.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/serializer/boost.hpp>
+#include <darc/peer/peer.hpp>
+
+const int iterations = 300;
+const size_t message_size = 4 * 1024 * 1024; // a camera frame
+
+long minor_faults()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_minflt;
+}
+
+void drop(const darc::ID& peer_id, darc::buffer::shared_buffer data)
+{
+}
+
+void run(const std::string& name, darc::buffer::buffer_allocator * allocator)
+{
+  darc::peer p;
+  p.set_send_to_function(boost::bind(&drop, _1, _2));
+
+  std::vector<uint8_t> frame(message_size, 7);
+  darc::outbound_data<darc::serializer::boost_serializer, std::vector<uint8_t> > o_frame(frame);
+
+  long start_faults = minor_faults();
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    p.send_to(darc::ID::null(), 13, o_frame, allocator);
+  }
+  boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+  std::cout << name
+            << ": " << (double)(minor_faults() - start_faults) / iterations << " page faults/publish, "
+            << (double)duration.total_microseconds() / iterations << " us/publish"
+            << std::endl;
+}
+
+int main()
+{
+  run("heap (default)", 0);
+
+  darc::buffer::shared_huge_page_arena arena =
+    darc::buffer::huge_page_arena::create(message_size + 4096, 4);
+  run("huge_page_arena", arena.get());
+
+  darc::buffer::huge_page_arena::statistics stats = arena->stats();
+  std::cout << "arena: " << (stats.huge_pages ? "MAP_HUGETLB" : "MADV_HUGEPAGE")
+            << ", " << stats.fallbacks << "/" << stats.allocations << " fallbacks"
+            << std::endl;
+  return 0;
+}
@@ -0,0 +1,203 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/serialization/vector.hpp>
+#include <boost/serialization/string.hpp>
+
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/raw_buffer.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/network/inbound_data.hpp>
+#include <darc/network/payload_header_packet.hpp>
+#include <darc/serializer/boost.hpp>
+#include <darc/serializer/ros.hpp>
+#include <darc/serializer/pod.hpp>
+#include <darc/serializer/raw.hpp>
+
+// Pack and unpack cost per codec and payload, one result per line.
+//
+//   darc_benchmark_serialization [--csv]
+//
+// Prints JSON lines by default: codec, payload, op, ns_per_op, bytes and
+// iterations. Every case runs until it has taken at least min_duration.
+// Unpack times include creating the read view over the packed bytes.
+
+const boost::posix_time::time_duration min_duration = boost::posix_time::milliseconds(200);
+
+bool csv = false;
+
+struct pose
+{
+  double position[3];
+  double orientation[4];
+  uint64_t stamp;
+
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & position;
+    ar & orientation;
+    ar & stamp;
+  }
+};
+
+void report(const std::string& codec, const std::string& payload, const std::string& op,
+            double ns_per_op, size_t bytes, size_t iterations)
+{
+  if(csv)
+  {
+    std::cout << codec << "," << payload << "," << op << ","
+              << ns_per_op << "," << bytes << "," << iterations << std::endl;
+  }
+  else
+  {
+    std::cout << "{\"codec\": \"" << codec << "\", \"payload\": \"" << payload
+              << "\", \"op\": \"" << op << "\", \"ns_per_op\": " << ns_per_op
+              << ", \"bytes\": " << bytes << ", \"iterations\": " << iterations << "}" << std::endl;
+  }
+}
+
+// Doubles the iteration count until the run is long enough to measure
+template<typename Op>
+void measure(const std::string& codec, const std::string& payload, const std::string& name,
+             Op& op, size_t bytes)
+{
+  for(size_t iterations = 1; ; iterations *= 2)
+  {
+    boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+    for(size_t i = 0; i < iterations; i++)
+    {
+      op();
+    }
+    boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+    if(duration >= min_duration)
+    {
+      report(codec, payload, name, (double)duration.total_nanoseconds() / iterations, bytes, iterations);
+      return;
+    }
+  }
+}
+
+struct pack_op
+{
+  const darc::outbound_data_base& data_;
+  size_t bytes_;
+
+  pack_op(const darc::outbound_data_base& data) :
+    data_(data),
+    bytes_(0)
+  {
+  }
+
+  void operator()()
+  {
+    // Sized like peer::send_to sizes its frames
+    darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create(data_.serialized_size(), 0);
+    data_.pack(buffer);
+    bytes_ = buffer->len();
+  }
+};
+
+template<typename S, typename T>
+struct unpack_op
+{
+  std::vector<char>& packed_;
+
+  unpack_op(std::vector<char>& packed) :
+    packed_(packed)
+  {
+  }
+
+  void operator()()
+  {
+    darc::buffer::shared_buffer buffer =
+      boost::make_shared<darc::buffer::raw_buffer>(&packed_[0], packed_.size(), packed_.size());
+    darc::inbound_data<S, T> i_data(buffer);
+  }
+};
+
+std::vector<char> pack_flat(const darc::outbound_data_base& data)
+{
+  darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create(data.serialized_size(), 0);
+  data.pack(buffer);
+
+  std::vector<char> flat(buffer->len() + 1);
+  buffer->streambuf()->sgetn(&flat[0], buffer->len());
+  flat.resize(buffer->len());
+  return flat;
+}
+
+template<typename S, typename T>
+void run(const std::string& codec, const std::string& payload, const T& value)
+{
+  darc::outbound_data<S, T> o_data(value);
+
+  pack_op pack(o_data);
+  pack();
+  measure(codec, payload, "pack", pack, pack.bytes_);
+
+  std::vector<char> packed = pack_flat(o_data);
+  unpack_op<S, T> unpack(packed);
+  measure(codec, payload, "unpack", unpack, packed.size());
+}
+
+// Chains as the network layers build them, packing only
+void run_chains(const std::vector<uint8_t>& blob, const std::vector<uint32_t>& values)
+{
+  darc::payload_header_packet hdr;
+  hdr.payload_type = 2;
+  darc::outbound_data<darc::serializer::raw_serializer, darc::payload_header_packet> o_hdr(hdr);
+  darc::outbound_data<darc::serializer::boost_serializer, std::vector<uint8_t> > o_blob(blob);
+  darc::outbound_pair o_pair(o_hdr, o_blob);
+
+  pack_op pair(o_pair);
+  pair();
+  measure("outbound_pair", "header+vector_1m", "pack", pair, pair.bytes_);
+
+  typedef std::vector<uint32_t>::const_iterator iterator_type;
+  darc::outbound_list<darc::serializer::pod_serializer, iterator_type> o_list(values.begin(), values.end());
+  pack_op list(o_list);
+  list();
+  measure("outbound_list", "uint32_x1024", "pack", list, list.bytes_);
+}
+
+int main(int argc, char ** argv)
+{
+  for(int i = 1; i < argc; i++)
+  {
+    if(strcmp(argv[i], "--csv") == 0)
+    {
+      csv = true;
+    }
+  }
+  if(csv)
+  {
+    std::cout << "codec,payload,op,ns_per_op,bytes,iterations" << std::endl;
+  }
+
+  uint32_t scalar = 42;
+  pose p = {{1.0, 2.0, 3.0}, {0.0, 0.0, 0.0, 1.0}, 1234567};
+  std::string text(1024, 'x');
+  std::vector<uint8_t> blob(1024 * 1024, 7);
+  std::vector<uint32_t> values(1024, 3);
+
+  run<darc::serializer::boost_serializer>("boost", "scalar", scalar);
+  run<darc::serializer::pod_serializer>("pod", "scalar", scalar);
+  run<darc::serializer::ros_serializer>("ros", "scalar", scalar);
+
+  run<darc::serializer::boost_serializer>("boost", "struct", p);
+  run<darc::serializer::pod_serializer>("pod", "struct", p);
+
+  run<darc::serializer::boost_serializer>("boost", "string_1k", text);
+  run<darc::serializer::ros_serializer>("ros", "string_1k", text);
+
+  run<darc::serializer::boost_serializer>("boost", "vector_1m", blob);
+  run<darc::serializer::ros_serializer>("ros", "vector_1m", blob);
+
+  run_chains(blob, values);
+
+  return 0;
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/serialization/vector.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/serializer/serializer_selector.hpp>
+
+// Encode cost per message type, for the serializer serializer_selector
+// picks and for boost serialization which local_dispatcher used before
+
+const int iterations = 200000;
+
+struct pose
+{
+  double position[3];
+  double orientation[4];
+  uint64_t stamp;
+
+  // Only for the boost comparison, member functions keep it a POD
+  template<class Archive>
+  void serialize(Archive & ar, const unsigned int version)
+  {
+    ar & position;
+    ar & orientation;
+    ar & stamp;
+  }
+};
+
+template<typename S, typename T>
+void run(const std::string& type, const std::string& serializer, const T& value)
+{
+  size_t bytes = 0;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    darc::outbound_data<S, T> o_data(value);
+    darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create();
+    o_data.pack(buffer);
+    bytes = buffer->len();
+  }
+  boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+  std::cout << type << " (" << serializer << "): "
+            << bytes << " bytes, "
+            << (double)duration.total_nanoseconds() / iterations << " ns/msg"
+            << std::endl;
+}
+
+template<typename T>
+void run_type(const std::string& type, const T& value)
+{
+  typedef darc::serializer::serializer_selector<T> selector_type;
+  run<typename selector_type::type, T>(type, selector_type::name(), value);
+  if(std::string(selector_type::name()) != "boost")
+  {
+    run<darc::serializer::boost_serializer, T>(type, "boost", value);
+  }
+}
+
+int main()
+{
+  run_type("uint32", (uint32_t)42);
+
+  pose p = {{1.0, 2.0, 3.0}, {0.0, 0.0, 0.0, 1.0}, 1234567};
+  run_type("pose", p);
+
+  run_type("string 1k", std::string(1024, 'x'));
+
+  // ROS wire format for a plain vector, as a ROS message would carry it
+  std::vector<uint8_t> blob(64 * 1024, 7);
+  run_type("vector<uint8> 64k", blob);
+  run<darc::serializer::ros_serializer, std::vector<uint8_t> >("vector<uint8> 64k", "ros", blob);
+
+  return 0;
+}
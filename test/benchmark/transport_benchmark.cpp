@@ -0,0 +1,276 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <unistd.h>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/asio.hpp>
+
+#include <darc/peer/peer.hpp>
+#include <darc/peer/peer_service.hpp>
+#include <darc/network/network_manager.hpp>
+
+// Latency and throughput between two peers in this process, over each
+// transport in turn.
+//
+//   darc_benchmark_transport [name url_a url_b]...
+//
+// Peer 1 accepts on url_a and connects to url_b, peer 2 the other way
+// around. Without arguments inproc, shm, zmq+ipc, and zmq+tcp and asio+tcp
+// on loopback are compared.
+// Prints one JSON line per measurement.
+
+const darc::peer::service_type benchmark_service_id = 99;
+
+// Payload of a given size, copied in with one memcpy
+class bytes_data : public darc::outbound_data_base
+{
+protected:
+  const std::vector<char>& bytes_;
+
+public:
+  bytes_data(const std::vector<char>& bytes) :
+    bytes_(bytes)
+  {
+  }
+
+  void pack(darc::buffer::shared_buffer& buffer) const
+  {
+    char * dest = buffer->prepare(bytes_.size());
+    if(dest != 0)
+    {
+      memcpy(dest, &bytes_[0], bytes_.size());
+      buffer->commit(bytes_.size());
+    }
+    else
+    {
+      buffer->streambuf()->sputn(&bytes_[0], bytes_.size());
+    }
+  }
+
+  size_t serialized_size() const
+  {
+    return bytes_.size();
+  }
+};
+
+class benchmark_service : public darc::peer_service
+{
+protected:
+  boost::mutex mutex_;
+  boost::condition_variable condition_;
+  uint64_t received_;
+  bool echo_;
+  std::vector<char> reply_;
+
+public:
+  benchmark_service(darc::peer& p, bool echo) :
+    darc::peer_service(p, benchmark_service_id),
+    received_(0),
+    echo_(echo)
+  {
+  }
+
+  void recv(const darc::ID& src_peer_id, darc::buffer::shared_buffer data)
+  {
+    if(echo_)
+    {
+      reply_.resize(data->len() - (data->gptr() - data->data()));
+      send_to(src_peer_id, bytes_data(reply_));
+    }
+    boost::mutex::scoped_lock lock(mutex_);
+    received_++;
+    condition_.notify_all();
+  }
+
+  void reset()
+  {
+    boost::mutex::scoped_lock lock(mutex_);
+    received_ = 0;
+  }
+
+  // Number received when count was reached or the timeout expired
+  uint64_t wait_for(uint64_t count, const boost::posix_time::time_duration& timeout)
+  {
+    boost::system_time deadline = boost::get_system_time() + timeout;
+    boost::mutex::scoped_lock lock(mutex_);
+    while(received_ < count)
+    {
+      if(!condition_.timed_wait(lock, deadline))
+      {
+        break;
+      }
+    }
+    return received_;
+  }
+};
+
+void print(const std::string& transport, const std::string& test, size_t size,
+           const std::string& values)
+{
+  std::cout << "{\"transport\": \"" << transport << "\", \"test\": \"" << test
+            << "\", \"size\": " << size << ", " << values << "}" << std::endl;
+}
+
+void latency(const std::string& transport, const darc::ID& remote,
+             benchmark_service& local, size_t size, int iterations)
+{
+  std::vector<char> payload(size, 'x');
+  local.reset();
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    local.send_to(remote, bytes_data(payload));
+    if(local.wait_for(i + 1, boost::posix_time::seconds(1)) < (uint64_t)(i + 1))
+    {
+      print(transport, "latency", size, "\"error\": \"timeout\"");
+      return;
+    }
+  }
+  boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+  std::ostringstream values;
+  values << "\"one_way_us\": " << (double)duration.total_microseconds() / iterations / 2
+         << ", \"iterations\": " << iterations;
+  print(transport, "latency", size, values.str());
+}
+
+void throughput(const std::string& transport, const darc::ID& remote,
+                benchmark_service& local, benchmark_service& sink, size_t size, int messages)
+{
+  std::vector<char> payload(size, 'x');
+  sink.reset();
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < messages; i++)
+  {
+    local.send_to(remote, bytes_data(payload));
+  }
+  uint64_t received = sink.wait_for(messages, boost::posix_time::seconds(10));
+  boost::posix_time::time_duration duration = boost::posix_time::microsec_clock::universal_time() - start;
+
+  double seconds = duration.total_microseconds() / 1e6;
+  std::ostringstream values;
+  values << "\"msgs_per_s\": " << received / seconds
+         << ", \"mb_per_s\": " << received * size / seconds / (1024 * 1024)
+         << ", \"sent\": " << messages
+         << ", \"received\": " << received;
+  print(transport, "throughput", size, values.str());
+}
+
+// Runs an io_service on a thread of its own until destroyed, which is after
+// the network managers using it have closed their connections
+class io_service_runner
+{
+protected:
+  boost::scoped_ptr<boost::asio::io_service::work> work_;
+  boost::thread thread_;
+
+public:
+  io_service_runner(boost::asio::io_service& io_service) :
+    work_(new boost::asio::io_service::work(io_service)),
+    thread_(boost::bind(&boost::asio::io_service::run, &io_service))
+  {
+  }
+
+  ~io_service_runner()
+  {
+    work_.reset();
+    thread_.join();
+  }
+};
+
+void run(const std::string& transport, const std::string& url_a, const std::string& url_b)
+{
+  boost::asio::io_service io1; // only used by asio+tcp
+  boost::asio::io_service io2;
+  darc::peer p1;
+  darc::peer p2;
+  // Outlive the network managers, which may still be delivering
+  benchmark_service ping(p1, false);
+  benchmark_service pong(p2, true);
+  io_service_runner r1(io1);
+  io_service_runner r2(io2);
+  darc::network::network_manager n1(io1, p1);
+  darc::network::network_manager n2(io2, p2);
+
+  n1.accept(url_a);
+  n2.accept(url_b);
+  n1.connect(url_b);
+  n2.connect(url_a);
+  usleep(1000*1000); // discovery
+
+  size_t sizes[] = {64, 4096, 64 * 1024, 1024 * 1024};
+  for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    latency(transport, p2.id(), ping, sizes[i], sizes[i] >= 1024 * 1024 ? 100 : 2000);
+  }
+}
+
+void run_throughput(const std::string& transport, const std::string& url_a, const std::string& url_b)
+{
+  boost::asio::io_service io1;
+  boost::asio::io_service io2;
+  darc::peer p1;
+  darc::peer p2;
+  benchmark_service source(p1, false);
+  benchmark_service sink(p2, false);
+  io_service_runner r1(io1);
+  io_service_runner r2(io2);
+  darc::network::network_manager n1(io1, p1);
+  darc::network::network_manager n2(io2, p2);
+
+  n1.accept(url_a);
+  n2.accept(url_b);
+  n1.connect(url_b);
+  n2.connect(url_a);
+  usleep(1000*1000);
+
+  size_t sizes[] = {64, 4096, 64 * 1024, 1024 * 1024};
+  for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+  {
+    throughput(transport, p2.id(), source, sink, sizes[i], sizes[i] >= 1024 * 1024 ? 200 : 20000);
+  }
+}
+
+int main(int argc, char ** argv)
+{
+  std::vector<std::string> transports;
+  for(int i = 1; i + 2 < argc; i += 3)
+  {
+    transports.push_back(argv[i]);
+    transports.push_back(argv[i + 1]);
+    transports.push_back(argv[i + 2]);
+  }
+  if(transports.empty())
+  {
+    transports.push_back("inproc");
+    transports.push_back("inproc://benchmark_a");
+    transports.push_back("inproc://benchmark_b");
+    std::string shm_path = "shm:///tmp/darc_benchmark_transport";
+    transports.push_back("shm");
+    transports.push_back(shm_path);
+    transports.push_back(shm_path + "_b");
+    transports.push_back("zmq+ipc");
+    transports.push_back("zmq+ipc:///tmp/darc_benchmark_transport_ipc_a");
+    transports.push_back("zmq+ipc:///tmp/darc_benchmark_transport_ipc_b");
+    transports.push_back("zmq+tcp");
+    transports.push_back("zmq+tcp://127.0.0.1:5590");
+    transports.push_back("zmq+tcp://127.0.0.1:5591");
+    transports.push_back("asio+tcp");
+    transports.push_back("asio+tcp://127.0.0.1:5592");
+    transports.push_back("asio+tcp://127.0.0.1:5593");
+  }
+
+  for(size_t i = 0; i < transports.size(); i += 3)
+  {
+    run(transports[i], transports[i + 1], transports[i + 2]);
+    run_throughput(transports[i], transports[i + 1], transports[i + 2]);
+  }
+  return 0;
+}
@@ -0,0 +1,101 @@
+#include <iostream>
+#include <new>
+#include <cstdlib>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/make_shared.hpp>
+
+#include <darc/network/zmq/zmq_buffer_cache.hpp>
+
+using darc::network::zeromq::zmq_buffer;
+using darc::network::zeromq::zmq_buffer_cache;
+
+// Count every heap allocation made by the process
+static size_t allocation_count = 0;
+
+void * operator new(size_t size) throw(std::bad_alloc)
+{
+  allocation_count++;
+  void * p = malloc(size);
+  if(p == 0)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void * p) throw()
+{
+  free(p);
+}
+
+const int iterations = 1000000;
+
+// Stands in for the dispatcher holding on to the last few packets
+const size_t in_flight = 16;
+darc::buffer::shared_buffer queue[in_flight];
+
+void packet_received(size_t i, darc::buffer::shared_buffer data)
+{
+  queue[i % in_flight] = data;
+}
+
+void report(const std::string& name, size_t allocations, boost::posix_time::time_duration duration)
+{
+  std::cout << name
+            << ": " << (double)allocations / iterations << " allocations/msg, "
+            << (double)iterations * 1000000 / duration.total_microseconds() << " msgs/s"
+            << std::endl;
+}
+
+// What zmq_connect_worker::work_receive used to do per packet, minus the socket
+void run_make_shared()
+{
+  size_t start_count = allocation_count;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    zmq::message_t topic_msg;
+    boost::shared_ptr<zmq_buffer> data_msg = boost::make_shared<zmq_buffer>();
+    data_msg->update_buffer();
+    packet_received(i, data_msg);
+  }
+  report("make_shared<zmq_buffer>",
+         allocation_count - start_count,
+         boost::posix_time::microsec_clock::universal_time() - start);
+}
+
+void run_cache()
+{
+  zmq_buffer_cache cache;
+  zmq::message_t topic_msg;
+
+  // warm up the cache and the buffer_pool before measuring
+  for(size_t i = 0; i < in_flight * 2; i++)
+  {
+    packet_received(i, cache.acquire());
+  }
+
+  size_t start_count = allocation_count;
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::universal_time();
+  for(int i = 0; i < iterations; i++)
+  {
+    boost::shared_ptr<zmq_buffer> data_msg = cache.acquire();
+    data_msg->update_buffer();
+    packet_received(i, data_msg);
+  }
+  report("zmq_buffer_cache",
+         allocation_count - start_count,
+         boost::posix_time::microsec_clock::universal_time() - start);
+
+  for(size_t i = 0; i < in_flight; i++)
+  {
+    queue[i].reset();
+  }
+}
+
+int main()
+{
+  run_make_shared();
+  run_cache();
+  return 0;
+}
@@ -3,6 +3,12 @@
 #include <darc/buffer/raw_buffer.hpp>
 #include <darc/buffer/const_size_buffer.hpp>
 #include <darc/buffer/shared_buffer.hpp>
+#include <darc/buffer/pooled_buffer.hpp>
+#include <darc/buffer/chain_buffer.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/buffer/shm_buffer.hpp>
+#include <darc/buffer/huge_page_arena.hpp>
+#include <darc/buffer/memory_accounting.hpp>
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
@@ -12,6 +18,11 @@
 #include <darc/network/outbound_data.hpp>
 #include <darc/network/inbound_data.hpp>
 #include <darc/serializer/boost.hpp>
+#include <darc/serializer/raw.hpp>
+#include <darc/serializer/ros.hpp>
+#include <darc/serializer/serializer_selector.hpp>
+#include <darc/peer/peer.hpp>
+#include <darc/network/link_header_packet.hpp>
 
 TEST(BufferTest, Raw)
 {
@@ -30,7 +41,7 @@ TEST(BufferTest, Raw)
   val_1 = 0;
 
   darc::buffer::shared_buffer buffer_2 =
-    boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024);
+    boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024, 1024);
 
   std::istream is_1(buffer_2->streambuf());
   boost::archive::binary_iarchive iarchive_1(is_1);
@@ -49,8 +60,8 @@ TEST(BufferTest, Stacked)
   uint32_t val_2 = 120;
 
   // Create data
-  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(99);
-  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(120);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
   darc::outbound_pair o_data(o_data_2, o_data_1);
 
   // Create buffer and pack data
@@ -68,6 +79,620 @@ TEST(BufferTest, Stacked)
 
 };
 
+TEST(BufferTest, Len)
+{
+  char data_1[1024];
+
+  darc::buffer::shared_buffer buffer =
+    boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024);
+  EXPECT_EQ(0, buffer->len());
+
+  buffer->streambuf()->sputn("abcd", 4);
+  EXPECT_EQ(4, buffer->len());
+
+  // Reading does not change the extent
+  char in[4];
+  EXPECT_EQ(4, buffer->streambuf()->sgetn(in, 4));
+  EXPECT_EQ(4, buffer->len());
+
+  // Wrapping received data
+  darc::buffer::shared_buffer received =
+    boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024, 100);
+  EXPECT_EQ(100, received->len());
+};
+
+void capture_len(size_t * len, const darc::ID& peer_id, darc::buffer::shared_buffer data)
+{
+  *len = data->len();
+
+  // Headers are prepended in place, the frame stays contiguous
+  darc::buffer::buffer::segment_list_type segments;
+  data->segments(segments);
+  EXPECT_EQ(1, segments.size());
+}
+
+TEST(BufferTest, FrameSize)
+{
+  darc::peer p;
+  size_t frame_len = 0;
+  p.set_send_to_function(boost::bind(&capture_len, &frame_len, _1, _2));
+
+  uint32_t small = 4;
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_small(small);
+  p.send_to(darc::ID::null(), 13, o_small);
+  size_t small_len = frame_len;
+  EXPECT_LT(small_len, 200);
+
+  std::string large(3000, 'x');
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_large(large);
+  p.send_to(darc::ID::null(), 13, o_large);
+  size_t large_len = frame_len;
+  EXPECT_GT(large_len, 3000);
+
+  // Frame size follows the payload
+  EXPECT_EQ(small_len - sizeof(uint32_t) + sizeof(uint64_t) + large.size(), large_len);
+};
+
+TEST(BufferTest, PoolRecycle)
+{
+  darc::buffer::buffer_pool pool;
+
+  char * first_data;
+  {
+    darc::buffer::shared_buffer buffer = darc::buffer::pooled_buffer::create(1024*10, pool);
+    first_data = buffer->data();
+  }
+
+  darc::buffer::buffer_pool::statistics before = pool.stats();
+  for(int i = 0; i < 100; i++)
+  {
+    darc::buffer::shared_buffer buffer = darc::buffer::pooled_buffer::create(1024*10, pool);
+    EXPECT_EQ(first_data, buffer->data());
+  }
+  darc::buffer::buffer_pool::statistics after = pool.stats();
+
+  // Both the storage and the buffer object itself are recycled
+  EXPECT_EQ(before.heap_allocations, after.heap_allocations);
+  EXPECT_EQ(before.allocations + 200, after.allocations);
+};
+
+TEST(BufferTest, PoolPack)
+{
+  darc::buffer::buffer_pool pool;
+
+  uint32_t val = 99;
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data(val);
+
+  darc::buffer::shared_buffer buffer = darc::buffer::pooled_buffer::create(1024, pool);
+  o_data.pack(buffer);
+
+  darc::buffer::shared_buffer read_buffer =
+    boost::make_shared<darc::buffer::raw_buffer>(buffer->data(), 1024, 1024);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_data(read_buffer);
+  EXPECT_EQ(in_data.get(), 99);
+};
+
+TEST(BufferTest, PoolOversize)
+{
+  darc::buffer::buffer_pool pool;
+
+  size_t large = 4*1024*1024;
+  EXPECT_EQ(large, darc::buffer::buffer_pool::block_size(large));
+  EXPECT_EQ(128, darc::buffer::buffer_pool::block_size(100));
+
+  void * block = pool.allocate(large);
+  pool.deallocate(block, large);
+  EXPECT_EQ(0, pool.stats().cached_blocks);
+};
+
+TEST(BufferTest, ChainGrow)
+{
+  std::string val_1(100*1024, 'x');
+  uint32_t val_2 = 120;
+
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+  darc::outbound_pair o_data(o_data_1, o_data_2);
+
+  darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create(1024);
+  darc::buffer::shared_buffer buffer = chain;
+  o_data.pack(buffer);
+
+  EXPECT_GT(chain->segment_count(), 1);
+  EXPECT_GT(buffer->len(), val_1.size());
+
+  darc::buffer::buffer::segment_list_type segments;
+  buffer->segments(segments);
+  size_t total = 0;
+  for(size_t i = 0; i < segments.size(); i++)
+  {
+    total += boost::asio::buffer_size(segments[i]);
+  }
+  EXPECT_EQ(buffer->len(), total);
+
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_1(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+  EXPECT_EQ(val_2, in_val_2.get());
+
+  // Written in place, chunks double as well: 1 MB in 4 KB pieces
+  darc::buffer::shared_chain_buffer prepared = darc::buffer::chain_buffer::create(4096, 0);
+  for(size_t i = 0; i < 256; i++)
+  {
+    char * dest = prepared->prepare(4096);
+    ASSERT_TRUE(dest != 0);
+    memset(dest, (char)i, 4096);
+    prepared->commit(4096);
+  }
+  EXPECT_EQ(256 * 4096, prepared->len());
+  EXPECT_LT(prepared->segment_count(), 16);
+};
+
+TEST(BufferTest, ChainAppend)
+{
+  std::string val(5000, 'y');
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data(val);
+
+  darc::buffer::shared_buffer packed = darc::buffer::pooled_buffer::create(8*1024);
+  o_data.pack(packed);
+
+  // Split into three received frames
+  size_t len = packed->len();
+  size_t split[] = {0, 100, 3000, len};
+  darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create();
+  for(int i = 0; i < 3; i++)
+  {
+    chain->append(boost::make_shared<darc::buffer::raw_buffer>(packed->data() + split[i],
+                                                               split[i+1] - split[i],
+                                                               split[i+1] - split[i]));
+  }
+  EXPECT_EQ(3, chain->segment_count());
+  EXPECT_EQ(len, chain->len());
+
+  darc::buffer::shared_buffer buffer = chain;
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val(buffer);
+  EXPECT_EQ(val, in_val.get());
+};
+
+TEST(BufferTest, RawHeadroom)
+{
+  char data_1[1024];
+
+  uint32_t val_1 = 99;
+  uint32_t val_2 = 120;
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+
+  boost::shared_ptr<darc::buffer::raw_buffer> raw =
+    boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024);
+  raw->reserve_headroom(128);
+  darc::buffer::shared_buffer buffer = raw;
+
+  // Body first, then the header in front of it
+  o_data_1.pack(buffer);
+  char * body = buffer->data();
+  size_t body_len = buffer->len();
+  o_data_2.prepend(buffer);
+
+  EXPECT_EQ(body, buffer->data() + (buffer->len() - body_len));
+  EXPECT_GT(128, buffer->headroom());
+
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+  EXPECT_EQ(val_2, in_val_2.get());
+
+  // No more room
+  char large[200];
+  EXPECT_FALSE(buffer->prepend(large, sizeof(large)));
+};
+
+TEST(BufferTest, PrependWithoutHeadroom)
+{
+  char data_1[1024];
+
+  uint32_t val_1 = 99;
+  std::string val_2(300, 'h');
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_2(val_2);
+
+  darc::buffer::shared_buffer raw = boost::make_shared<darc::buffer::raw_buffer>(&data_1[0], 1024);
+  darc::buffer::shared_buffer buffer = raw;
+  o_data_1.pack(buffer);
+
+  // Chained in front, the data stays where it is
+  o_data_2.prepend(buffer);
+  EXPECT_NE(raw, buffer);
+  darc::buffer::buffer::segment_list_type segments;
+  buffer->segments(segments);
+  ASSERT_EQ(2, segments.size());
+  EXPECT_EQ(&data_1[0], boost::asio::buffer_cast<const char*>(segments[1]));
+  EXPECT_LT(0, buffer->headroom());
+
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_2(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+  EXPECT_EQ(val_2, in_val_2.get());
+};
+
+TEST(BufferTest, ChainPrepend)
+{
+  std::string val_1(10*1024, 'z');
+  uint32_t val_2 = 120;
+  uint32_t val_3 = 7;
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_3(val_3);
+
+  darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create(1024, 64);
+  darc::buffer::shared_buffer buffer = chain;
+  o_data_1.pack(buffer);
+  size_t segments = chain->segment_count();
+
+  // Fits in the headroom
+  o_data_2.prepend(buffer);
+  EXPECT_EQ(segments, chain->segment_count());
+
+  // Does not fit, gets its own segment
+  o_data_3.prepend(buffer);
+  EXPECT_EQ(segments + 1, chain->segment_count());
+
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_3(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+  EXPECT_EQ(val_2, in_val_2.get());
+  EXPECT_EQ(val_3, in_val_3.get());
+};
+
+TEST(BufferTest, SerializedSize)
+{
+  std::string val_1(3000, 'x');
+  uint32_t val_2 = 120;
+  std::vector<uint32_t> val_3(10, 5);
+  darc::link_header_packet val_4;
+  val_4.packet_type = darc::link_header_packet::SERVICE;
+
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+  darc::outbound_list<darc::serializer::boost_serializer, std::vector<uint32_t>::const_iterator>
+    o_data_3(val_3.begin(), val_3.end());
+  darc::outbound_data<darc::serializer::boost_serializer, darc::link_header_packet> o_data_4(val_4);
+  darc::outbound_pair o_pair_1(o_data_1, o_data_2);
+  darc::outbound_pair o_pair_2(o_data_3, o_data_4);
+  darc::outbound_pair o_data(o_pair_1, o_pair_2);
+
+  darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create(16);
+  o_data.pack(buffer);
+  EXPECT_EQ(buffer->len(), o_data.serialized_size());
+
+  // Fixed size headers give the same answer the second time
+  EXPECT_EQ(o_data_4.serialized_size(), o_data_4.serialized_size());
+
+  // Only fixed size types give a size hint, others would need a dry run
+  EXPECT_EQ(o_data_4.serialized_size(), o_data_4.size_hint());
+  EXPECT_EQ(0u, o_data_1.size_hint());
+  EXPECT_EQ(0u, o_data.size_hint());
+
+  // An exactly sized chain is a single segment
+  darc::buffer::shared_chain_buffer exact = darc::buffer::chain_buffer::create(o_data.serialized_size());
+  buffer = exact;
+  o_data.pack(buffer);
+  EXPECT_EQ(1, exact->segment_count());
+};
+
+TEST(BufferTest, Slice)
+{
+  uint32_t val_1 = 99;
+  uint32_t val_2 = 120;
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+  darc::outbound_pair o_data(o_data_1, o_data_2);
+
+  darc::buffer::shared_buffer buffer = darc::buffer::pooled_buffer::create(1024);
+  o_data.pack(buffer);
+  char * frame = buffer->data();
+
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+
+  // Two views of the rest, sharing memory but not the read position
+  darc::buffer::shared_buffer slice_1 = darc::buffer::slice_buffer::unread(buffer);
+  darc::buffer::shared_buffer slice_2 = darc::buffer::slice_buffer::unread(buffer);
+  EXPECT_EQ(buffer->gptr(), slice_1->data());
+  EXPECT_EQ(buffer->len() - (buffer->gptr() - frame), slice_1->len());
+
+  // The slices keep the frame alive
+  buffer.reset();
+
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2a(slice_1);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2b(slice_2);
+  EXPECT_EQ(val_2, in_val_2a.get());
+  EXPECT_EQ(val_2, in_val_2b.get());
+  EXPECT_EQ(0, slice_1->pptr());
+};
+
+TEST(BufferTest, SliceChain)
+{
+  uint32_t val_1 = 99;
+  std::string val_2(5000, 'y');
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_2(val_2);
+  darc::outbound_pair o_data(o_data_1, o_data_2);
+
+  darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create(1024, 0);
+  darc::buffer::shared_buffer buffer = chain;
+  o_data.pack(buffer);
+  ASSERT_LT(1, chain->segment_count());
+
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+
+  darc::buffer::shared_buffer slice = darc::buffer::slice_buffer::unread(buffer);
+  EXPECT_EQ(o_data_2.serialized_size(), slice->len());
+
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_2(slice);
+  EXPECT_EQ(val_2, in_val_2.get());
+};
+
+#ifdef __linux__
+TEST(BufferTest, ShmMap)
+{
+  std::string val_1(10000, 'm');
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_1(val_1);
+
+  darc::buffer::shared_shm_buffer shm = darc::buffer::shm_buffer::create(o_data_1.serialized_size());
+  EXPECT_LE(o_data_1.serialized_size(), shm->capacity());
+
+  darc::buffer::shared_buffer buffer = shm;
+  o_data_1.pack(buffer);
+
+  // A second mapping of the same pages, as the receiving process would make
+  darc::buffer::shared_shm_buffer mapped = darc::buffer::shm_buffer::map(shm->fd(), shm->len());
+  EXPECT_NE(shm->data(), mapped->data());
+  EXPECT_EQ(shm->len(), mapped->len());
+
+  darc::buffer::shared_buffer in_buffer = mapped;
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_1(in_buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+
+  // Writes are seen through both mappings
+  shm->data()[shm->len() - 1] = 'n';
+  EXPECT_EQ('n', mapped->data()[mapped->len() - 1]);
+
+  // More data than the segment holds
+  EXPECT_THROW(darc::buffer::shm_buffer::map(shm->fd(), shm->capacity() + 1), darc::buffer::shm_exception);
+};
+#endif
+
+TEST(BufferTest, HugePageArena)
+{
+  darc::buffer::shared_huge_page_arena arena = darc::buffer::huge_page_arena::create(3*1024*1024, 2);
+  EXPECT_EQ(4*1024*1024, arena->slot_size());
+  EXPECT_EQ(2, arena->stats().free_slots);
+
+  std::string val_1(10000, 'h');
+  uint32_t val_2 = 120;
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, uint32_t> o_data_2(val_2);
+
+  darc::buffer::shared_buffer buffer = arena->allocate(o_data_1.serialized_size(), 64);
+  EXPECT_EQ(64, buffer->headroom());
+  darc::buffer::shared_buffer other = arena->allocate(100, 0);
+  EXPECT_EQ(0, arena->stats().free_slots);
+
+  // Arena exhausted, and too large
+  darc::buffer::shared_buffer fallback = arena->allocate(100, 0);
+  darc::buffer::shared_buffer large = arena->allocate(8*1024*1024, 0);
+  EXPECT_EQ(2, arena->stats().fallbacks);
+
+  o_data_1.pack(buffer);
+  o_data_2.prepend(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, uint32_t> in_val_2(buffer);
+  darc::inbound_data<darc::serializer::boost_serializer, std::string> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+  EXPECT_EQ(val_2, in_val_2.get());
+
+  // Buffers keep the arena alive and return their slot
+  arena.reset();
+  buffer.reset();
+};
+
+TEST(BufferTest, MemoryAccounting)
+{
+  darc::buffer::memory_accounting& accounting = darc::buffer::memory_accounting::instance();
+  darc::buffer::memory_tag tag(1000, darc::ID::create(), darc::ID::create());
+  darc::buffer::memory_accounting::counters& c = accounting.get(tag);
+
+  darc::buffer::shared_buffer data = darc::buffer::pooled_buffer::create(1024);
+  darc::buffer::shared_buffer charged_1 = accounting.charge(tag, data, 1024);
+  EXPECT_EQ(data.get(), charged_1.get());
+  darc::buffer::shared_buffer charged_2 = accounting.charge(tag, data, 1024);
+  EXPECT_EQ(2048, c.live);
+  EXPECT_EQ(2, c.buffers);
+
+  // Counted until the last copy is gone
+  darc::buffer::shared_buffer copy = charged_1;
+  charged_1.reset();
+  charged_2.reset();
+  EXPECT_EQ(1024, c.live);
+  copy.reset();
+  EXPECT_EQ(0, c.live);
+  EXPECT_EQ(2048, c.peak);
+
+  // Allocator charges size and headroom
+  darc::buffer::accounting_allocator allocator(tag);
+  darc::buffer::shared_buffer allocated = allocator.allocate(100, 28);
+  EXPECT_EQ(128, c.live);
+
+  darc::buffer::memory_accounting::entry_list_type list;
+  accounting.entries(list);
+  bool found = false;
+  for(darc::buffer::memory_accounting::entry_list_type::iterator it = list.begin();
+      it != list.end();
+      it++)
+  {
+    if(!(it->tag < tag) && !(tag < it->tag))
+    {
+      found = true;
+      EXPECT_EQ(128, it->live);
+      EXPECT_EQ(2048, it->peak);
+      EXPECT_EQ(1, it->buffers);
+    }
+  }
+  EXPECT_TRUE(found);
+
+  // Chunks a chain grows by past its size hint are charged as well
+  allocated.reset();
+  {
+    std::string large(1000000, 'a');
+    darc::outbound_data<darc::serializer::boost_serializer, std::string> o_large(large);
+    darc::buffer::shared_buffer grown = allocator.allocate(darc::buffer::chain_buffer::default_chunk_size, 256);
+    o_large.pack(grown);
+    EXPECT_LE(grown->len() + 256, c.live);
+    EXPECT_EQ(1, c.buffers);
+  }
+  EXPECT_EQ(0, c.live);
+};
+
+TEST(BufferTest, RawSerializer)
+{
+  darc::link_header_packet val_1;
+  val_1.dest_peer_id = darc::ID::create();
+  val_1.src_peer_id = darc::ID::create();
+  val_1.packet_type = 0x0102;
+
+  darc::outbound_data<darc::serializer::raw_serializer, darc::link_header_packet> o_data_1(val_1);
+  darc::outbound_data<darc::serializer::boost_serializer, darc::link_header_packet> o_boost(val_1);
+  EXPECT_EQ(34, o_data_1.serialized_size());
+  EXPECT_LT(o_data_1.serialized_size(), o_boost.serialized_size());
+
+  darc::buffer::shared_buffer buffer = darc::buffer::pooled_buffer::create(1024);
+  o_data_1.pack(buffer);
+  EXPECT_EQ(34, buffer->len());
+
+  // Little-endian, right after the two IDs
+  EXPECT_EQ(0x02, buffer->data()[32]);
+  EXPECT_EQ(0x01, buffer->data()[33]);
+
+  darc::inbound_data<darc::serializer::raw_serializer, darc::link_header_packet> in_val_1(buffer);
+  EXPECT_EQ(val_1.dest_peer_id, in_val_1.get().dest_peer_id);
+  EXPECT_EQ(val_1.src_peer_id, in_val_1.get().src_peer_id);
+  EXPECT_EQ(val_1.packet_type, in_val_1.get().packet_type);
+
+  // A truncated frame
+  buffer = darc::buffer::pooled_buffer::create(1024);
+  o_data_1.pack(buffer);
+  buffer->consume(1);
+  EXPECT_THROW((darc::inbound_data<darc::serializer::raw_serializer, darc::link_header_packet>(buffer)),
+               darc::serializer::serializer_exception);
+};
+
+TEST(BufferTest, RosSerializer)
+{
+  // Larger than the old 5 KB window
+  std::string val_1(20000, 'r');
+  darc::outbound_data<darc::serializer::ros_serializer, std::string> o_data_1(val_1);
+  EXPECT_EQ(4 + val_1.size(), o_data_1.serialized_size());
+
+  // Written in place into a new chunk of the exact size
+  darc::buffer::shared_chain_buffer chain = darc::buffer::chain_buffer::create(16, 0);
+  darc::buffer::shared_buffer buffer = chain;
+  o_data_1.pack(buffer);
+  EXPECT_EQ(o_data_1.serialized_size(), buffer->len());
+  EXPECT_EQ(1, chain->segment_count());
+
+  darc::inbound_data<darc::serializer::ros_serializer, std::string> in_val_1(buffer);
+  EXPECT_EQ(val_1, in_val_1.get());
+
+  // Received as several frames
+  darc::buffer::shared_chain_buffer received = darc::buffer::chain_buffer::create();
+  received->append(boost::make_shared<darc::buffer::raw_buffer>(chain->data(), 100, 100));
+  received->append(boost::make_shared<darc::buffer::raw_buffer>(chain->data() + 100,
+                                                                chain->len() - 100,
+                                                                chain->len() - 100));
+  buffer = received;
+  darc::inbound_data<darc::serializer::ros_serializer, std::string> in_val_2(buffer);
+  EXPECT_EQ(val_1, in_val_2.get());
+};
+
+struct pod_point
+{
+  double x, y, z;
+  uint32_t flags;
+};
+
+TEST(BufferTest, SerializerSelector)
+{
+  EXPECT_TRUE((boost::is_same<darc::serializer::serializer_selector<uint32_t>::type,
+               darc::serializer::pod_serializer>::value));
+  EXPECT_TRUE((boost::is_same<darc::serializer::serializer_selector<pod_point>::type,
+               darc::serializer::pod_serializer>::value));
+  EXPECT_TRUE((boost::is_same<darc::serializer::serializer_selector<std::string>::type,
+               darc::serializer::boost_serializer>::value));
+  EXPECT_TRUE((boost::is_same<darc::serializer::serializer_selector<const char*>::type,
+               darc::serializer::boost_serializer>::value));
+  EXPECT_EQ(std::string("pod"), darc::serializer::serializer_selector<pod_point>::name());
+  EXPECT_EQ(std::string("boost"), darc::serializer::serializer_selector<std::string>::name());
+
+  pod_point val_1 = {1.5, -2.5, 3.25, 7};
+  darc::outbound_data<darc::serializer::pod_serializer, pod_point> o_data_1(val_1);
+  EXPECT_EQ(sizeof(pod_point), o_data_1.serialized_size());
+
+  darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create(8, 0);
+  o_data_1.pack(buffer);
+  EXPECT_EQ(sizeof(pod_point), buffer->len());
+
+  darc::inbound_data<darc::serializer::pod_serializer, pod_point> in_val_1(buffer);
+  EXPECT_EQ(val_1.x, in_val_1.get().x);
+  EXPECT_EQ(val_1.y, in_val_1.get().y);
+  EXPECT_EQ(val_1.z, in_val_1.get().z);
+  EXPECT_EQ(val_1.flags, in_val_1.get().flags);
+};
+
+struct counting_serializer
+{
+  static int unpack_count;
+
+  template<typename T>
+  static void unpack(darc::buffer::shared_buffer& buffer, T& data)
+  {
+    unpack_count++;
+    darc::serializer::pod_serializer::unpack(buffer, data);
+  }
+};
+
+int counting_serializer::unpack_count = 0;
+
+TEST(BufferTest, LazyInboundData)
+{
+  uint32_t val_1 = 4711;
+  darc::outbound_data<darc::serializer::pod_serializer, uint32_t> o_data_1(val_1);
+  darc::buffer::shared_buffer buffer = darc::buffer::chain_buffer::create();
+  o_data_1.pack(buffer);
+
+  counting_serializer::unpack_count = 0;
+  {
+    // Never accessed, never decoded
+    darc::lazy_inbound_data<counting_serializer, uint32_t> unused(buffer);
+  }
+  EXPECT_EQ(0, counting_serializer::unpack_count);
+
+  darc::lazy_inbound_data<counting_serializer, uint32_t> lazy(buffer);
+  EXPECT_FALSE(lazy.decoded());
+  EXPECT_EQ(val_1, *lazy.get());
+  EXPECT_TRUE(lazy.decoded());
+  EXPECT_EQ(val_1, *lazy.get());
+  EXPECT_EQ(1, counting_serializer::unpack_count);
+
+  // A truncated frame from a sender with a matching type gives no value
+  darc::buffer::shared_buffer truncated = darc::buffer::chain_buffer::create();
+  truncated->streambuf()->sputn("ab", 2);
+  darc::lazy_inbound_data<darc::serializer::pod_serializer, uint32_t> corrupt(truncated, true);
+  EXPECT_TRUE(corrupt.get().get() == 0);
+  EXPECT_TRUE(corrupt.decoded());
+};
+
 /*
 
 #include <hns/distributed_header.hpp>
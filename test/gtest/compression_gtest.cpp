@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <vector>
+#include <string>
+
+#include <darc/compression/codec.hpp>
+#include <darc/compression/lz_codec.hpp>
+#include <darc/compression/zlib_codec.hpp>
+#include <darc/compression/compression_stage.hpp>
+#include <darc/compression/delta_stage.hpp>
+#include <darc/network/outbound_data.hpp>
+#include <darc/serializer/boost.hpp>
+#include <darc/serializer/pod.hpp>
+
+std::string round_trip(const darc::compression::codec& c, const std::string& input, size_t * compressed_len = 0)
+{
+  std::vector<char> compressed(c.bound(input.size()));
+  size_t len = c.compress(input.data(), input.size(), &compressed[0]);
+  EXPECT_GT(len, 0u);
+  EXPECT_LE(len, compressed.size());
+  if(compressed_len != 0)
+  {
+    *compressed_len = len;
+  }
+
+  std::string output(input.size(), '\0');
+  EXPECT_TRUE(c.decompress(&compressed[0], len, input.empty() ? 0 : &output[0], output.size()));
+  return output;
+}
+
+std::string random_string(size_t len)
+{
+  std::string s(len, '\0');
+  for(size_t i = 0; i < len; i++)
+  {
+    s[i] = (char)(rand() & 0xff);
+  }
+  return s;
+}
+
+TEST(CompressionTest, LzRoundTrip)
+{
+  darc::compression::lz_codec lz;
+
+  EXPECT_EQ(std::string(), round_trip(lz, ""));
+  EXPECT_EQ(std::string("abc"), round_trip(lz, "abc"));
+
+  std::string random = random_string(100000);
+  EXPECT_EQ(random, round_trip(lz, random));
+
+  // Long literal and match runs need the extra length bytes
+  std::string runs = random_string(1000) + std::string(70000, 'a') + random_string(20) + "abcabcabcabcabcabc";
+  size_t compressed_len = 0;
+  EXPECT_EQ(runs, round_trip(lz, runs, &compressed_len));
+  EXPECT_LT(compressed_len, runs.size() / 20);
+
+  std::string text;
+  for(int i = 0; i < 1000; i++)
+  {
+    text += "{\"x\": 1.0, \"y\": 2.0, \"frame\": \"base_link\"}\n";
+  }
+  EXPECT_EQ(text, round_trip(lz, text, &compressed_len));
+  EXPECT_LT(compressed_len, text.size() / 5);
+};
+
+TEST(CompressionTest, LzCorrupt)
+{
+  darc::compression::lz_codec lz;
+
+  std::string text(5000, 'x');
+  std::vector<char> compressed(lz.bound(text.size()));
+  size_t len = lz.compress(text.data(), text.size(), &compressed[0]);
+
+  std::string output(text.size(), '\0');
+  // Truncated, wrong size, and an offset in front of the output
+  EXPECT_FALSE(lz.decompress(&compressed[0], len / 2, &output[0], output.size()));
+  EXPECT_FALSE(lz.decompress(&compressed[0], len, &output[0], output.size() - 1));
+  const char bad_offset[] = {0x10, 'x', 0x05, 0x00};
+  EXPECT_FALSE(lz.decompress(bad_offset, sizeof(bad_offset), &output[0], output.size()));
+};
+
+TEST(CompressionTest, Zlib)
+{
+  darc::compression::zlib_codec zlib;
+  std::string text = std::string(10000, 'z') + random_string(100);
+  EXPECT_EQ(text, round_trip(zlib, text));
+  EXPECT_EQ(darc::compression::codec::zlib, darc::compression::codec::get(darc::compression::codec::zlib)->id());
+  EXPECT_TRUE(darc::compression::codec::get(darc::compression::codec::none) == 0);
+};
+
+TEST(CompressionTest, Stage)
+{
+  darc::compression::compression_stage stage(
+    darc::compression::compression_config(darc::compression::codec::lz, 256, true, 1.2, 2));
+
+  // Below the threshold, known from the size hint without packing
+  uint32_t value = 7;
+  darc::outbound_data<darc::serializer::pod_serializer, uint32_t> o_value(value);
+  darc::buffer::shared_buffer out;
+  EXPECT_FALSE(stage.compress(o_value, out));
+  EXPECT_TRUE(out.get() == 0);
+
+  // Below the threshold, only known once packed
+  std::string small(100, 'a');
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_small(small);
+  EXPECT_FALSE(stage.compress(o_small, out));
+  ASSERT_TRUE(out.get() != 0);
+  EXPECT_EQ(o_small.serialized_size(), out->len());
+
+  std::string text(10000, 'a');
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_text(text);
+  EXPECT_TRUE(stage.compress(o_text, out));
+  EXPECT_LT(out->len(), text.size() / 10);
+
+  darc::buffer::shared_buffer expanded = darc::compression::compression_stage::decompress(out);
+  ASSERT_TRUE(expanded.get() != 0);
+  EXPECT_EQ(o_text.serialized_size(), expanded->len());
+
+  // Poor ratio, sent packed and compression backs off for two messages
+  std::string random = random_string(10000);
+  darc::outbound_data<darc::serializer::boost_serializer, std::string> o_random(random);
+  EXPECT_FALSE(stage.compress(o_random, out));
+  ASSERT_TRUE(out.get() != 0);
+  EXPECT_EQ(o_random.serialized_size(), out->len());
+  EXPECT_FALSE(stage.compress(o_text, out));
+  EXPECT_FALSE(stage.compress(o_text, out));
+  EXPECT_TRUE(stage.compress(o_text, out));
+
+  darc::compression::compression_stats stats = stage.stats();
+  EXPECT_EQ(7u, stats.messages);
+  EXPECT_EQ(2u, stats.below_threshold);
+  EXPECT_EQ(1u, stats.poor_ratio);
+  EXPECT_EQ(2u, stats.backed_off);
+  EXPECT_EQ(2u, stats.compressed);
+};
+
+TEST(CompressionTest, DeltaEncode)
+{
+  std::string prev = random_string(4096);
+  std::string cur = prev;
+  cur[10] ^= 1;
+  cur[11] ^= 1;
+  cur[2000] ^= 0x40;
+  cur[4095] ^= 0x7f;
+
+  std::vector<char> delta;
+  darc::compression::delta_encode(prev.data(), cur.data(), cur.size(), delta);
+  EXPECT_LT(delta.size(), 20u);
+
+  std::string applied = prev;
+  EXPECT_TRUE(darc::compression::delta_apply(&delta[0], delta.size(), &applied[0], applied.size()));
+  EXPECT_EQ(cur, applied);
+
+  // Unchanged is an empty delta
+  delta.clear();
+  darc::compression::delta_encode(prev.data(), prev.data(), prev.size(), delta);
+  EXPECT_TRUE(delta.empty());
+
+  // Runs past the end
+  const char bad[] = {0x7f, 0x7f};
+  EXPECT_FALSE(darc::compression::delta_apply(bad, sizeof(bad), &applied[0], 100));
+};
+
+std::string decode_string(darc::buffer::shared_buffer data)
+{
+  std::string result(data->len(), '\0');
+  data->streambuf()->sgetn(&result[0], result.size());
+  return result;
+}
+
+TEST(CompressionTest, DeltaStream)
+{
+  darc::compression::delta_encoder encoder(darc::compression::delta_config(4));
+  darc::compression::delta_decoder decoder;
+
+  std::vector<uint32_t> values(256, 7);
+  typedef darc::outbound_list<darc::serializer::pod_serializer, std::vector<uint32_t>::iterator> o_values_type;
+  bool request_keyframe = false;
+
+  std::vector<darc::buffer::shared_buffer> sent;
+  for(int i = 0; i < 5; i++)
+  {
+    values[i] = i;
+    o_values_type o_values(values.begin(), values.end());
+    sent.push_back(encoder.encode(o_values));
+  }
+
+  // Keyframe, 3 deltas, keyframe
+  darc::compression::delta_stats stats = encoder.stats();
+  EXPECT_EQ(5u, stats.messages);
+  EXPECT_EQ(2u, stats.keyframes);
+  EXPECT_LT(stats.bytes_out, stats.bytes_in / 2);
+
+  darc::buffer::shared_buffer out = decoder.decode(sent[0], request_keyframe);
+  ASSERT_TRUE(out.get() != 0);
+  EXPECT_EQ(1024u, out->len());
+  EXPECT_FALSE(request_keyframe);
+
+  // sent[1] is lost
+  EXPECT_TRUE(decoder.decode(sent[2], request_keyframe).get() == 0);
+  EXPECT_TRUE(request_keyframe);
+  EXPECT_TRUE(decoder.decode(sent[3], request_keyframe).get() == 0);
+  EXPECT_FALSE(request_keyframe); // asked once
+
+  out = decoder.decode(sent[4], request_keyframe);
+  ASSERT_TRUE(out.get() != 0);
+  std::string last = decode_string(out);
+  EXPECT_EQ(4u, *(const uint32_t *)&last[16]);
+
+  // After a keyframe request the next message is whole
+  encoder.request_keyframe();
+  values[100] = 100;
+  o_values_type o_values(values.begin(), values.end());
+  encoder.encode(o_values);
+  EXPECT_EQ(3u, encoder.stats().keyframes);
+  EXPECT_EQ(1u, encoder.stats().keyframe_requests);
+};
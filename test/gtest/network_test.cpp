@@ -3,7 +3,22 @@
 #include <darc/test/event_list.hpp>
 
 #include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
 #include <darc/network/network_manager.hpp>
+#include <darc/network/zmq/zmq_buffer_cache.hpp>
+#include <darc/network/crc32c.hpp>
+#include <darc/network/inbound_link_base.hpp>
+#include <darc/network/inproc/inproc_protocol_manager.hpp>
+#include <darc/network/address_in_use_exception.hpp>
+#include <darc/network/invalid_url_exception.hpp>
+#include <darc/buffer/slice_buffer.hpp>
+#include <darc/peer/peer_service.hpp>
+#include <darc/network/shm/shm_ring.hpp>
+#include <darc/serializer/boost.hpp>
+#include <boost/thread/mutex.hpp>
+#include <unistd.h>
 
 void callback(darc::test::event_list* list, const std::string& event, const darc::ID& peer_id)
 {
@@ -73,3 +88,648 @@ TEST(NetworkTest, Connect)
   EXPECT_TRUE(events.is_empty());
 
 }
+
+TEST(NetworkTest, SharedMemoryRing)
+{
+  darc::network::shm::shared_shm_ring producer = darc::network::shm::shm_ring::create(4096);
+  darc::network::shm::shared_shm_ring consumer = darc::network::shm::shm_ring::map(
+    darc::buffer::shm_buffer::map(producer->fd(), 0));
+  ASSERT_TRUE(consumer);
+
+  // Wraps around many times, with a record held while others are released
+  uint64_t held = 0;
+  bool holding = false;
+  for(int i = 0; i < 1000; i++)
+  {
+    size_t size = 1 + (i * 37) % 900;
+    char * dest = producer->prepare(size);
+    ASSERT_TRUE(dest != 0);
+    memset(dest, (char)i, size);
+    producer->commit(darc::network::shm::shm_ring::FRAME, size);
+
+    darc::network::shm::shm_ring::record_type type;
+    char * data;
+    size_t received;
+    uint64_t sequence;
+    ASSERT_TRUE(consumer->pop(type, data, received, sequence));
+    EXPECT_EQ(darc::network::shm::shm_ring::FRAME, type);
+    ASSERT_EQ(size, received);
+    EXPECT_EQ((char)i, data[0]);
+    EXPECT_EQ((char)i, data[size - 1]);
+    uint64_t next;
+    EXPECT_FALSE(consumer->pop(type, data, received, next));
+
+    if(!holding)
+    {
+      held = sequence;
+      holding = true;
+    }
+    else
+    {
+      consumer->release(sequence);
+    }
+
+    // Until then the space of the records after it is not reused
+    if(i % 3 == 2)
+    {
+      consumer->release(held);
+      holding = false;
+    }
+  }
+  EXPECT_TRUE(consumer->empty());
+  EXPECT_FALSE(consumer->corrupt());
+};
+
+// Signals come from the link threads of both peers
+boost::mutex callback_mutex;
+
+void locked_callback(darc::test::event_list* list, const std::string& event, const darc::ID& peer_id)
+{
+  boost::mutex::scoped_lock lock(callback_mutex);
+  list->event_callback(event, peer_id.short_string(), "");
+}
+
+class string_service : public darc::peer_service
+{
+public:
+  boost::mutex mutex_;
+  std::vector<std::string> received_;
+
+  string_service(darc::peer& p) :
+    darc::peer_service(p, 77)
+  {
+  }
+
+  void recv(const darc::ID& src_peer_id, darc::buffer::shared_buffer data)
+  {
+    darc::inbound_data<darc::serializer::boost_serializer, std::string> i_data(data);
+    boost::mutex::scoped_lock lock(mutex_);
+    received_.push_back(i_data.get());
+  }
+};
+
+class data_service : public darc::peer_service
+{
+public:
+  boost::mutex mutex_;
+  std::vector<std::string> received_;
+
+  data_service(darc::peer& p) :
+    darc::peer_service(p, 78)
+  {
+  }
+
+  void recv(const darc::ID& src_peer_id, darc::buffer::shared_buffer data)
+  {
+  }
+
+  void recv_data(const darc::ID& src_peer_id, const darc::data_header_packet& header,
+                 darc::buffer::shared_buffer data)
+  {
+    darc::inbound_data<darc::serializer::boost_serializer, std::string> i_data(data);
+    boost::mutex::scoped_lock lock(mutex_);
+    received_.push_back(i_data.get());
+  }
+};
+
+// Keeps the last buffer, which the layers below write their headers into
+class keeping_allocator : public darc::buffer::buffer_allocator
+{
+public:
+  darc::buffer::shared_buffer last_;
+
+  darc::buffer::shared_buffer allocate(size_t size, size_t headroom)
+  {
+    last_ = darc::buffer::chain_buffer::create(size, headroom);
+    return last_;
+  }
+};
+
+TEST(NetworkTest, SharedMemory)
+{
+  darc::test::event_list events;
+  std::string path = "shm:///tmp/darc_gtest_shm_" + boost::lexical_cast<std::string>(getpid());
+
+  boost::asio::io_service io1;
+  darc::peer p1;
+  p1.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p1_connect", _1));
+  p1.peer_disconnected_signal().connect(boost::bind(&locked_callback, &events, "p1_disconnect", _1));
+  darc::network::network_manager n1(io1, p1);
+  string_service s1(p1);
+  n1.accept(path);
+
+  {
+    boost::asio::io_service io2;
+    darc::peer p2;
+    p2.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p2_connect", _1));
+    darc::network::network_manager n2(io2, p2);
+    string_service s2(p2);
+    n2.connect(path);
+
+    usleep(500*1000);
+    {
+      boost::mutex::scoped_lock lock(callback_mutex);
+      EXPECT_TRUE(events.pop_type("p1_connect"));
+      EXPECT_TRUE(events.pop_type("p2_connect"));
+      EXPECT_TRUE(events.is_empty());
+    }
+
+    // Copied out of the ring, read in place, and by memfd reference
+    std::string small(100, 's');
+    std::string medium(100 * 1000, 'm');
+    std::string large(3 * 1000 * 1000, 'l');
+    s1.send_to(p2.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small));
+    s1.send_to(p2.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(medium));
+    s1.send_to(p2.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(large));
+    s2.send_to(p1.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small));
+
+    usleep(200*1000);
+    {
+      boost::mutex::scoped_lock lock(s2.mutex_);
+      ASSERT_EQ(3, s2.received_.size());
+      EXPECT_EQ(small, s2.received_[0]);
+      EXPECT_EQ(medium, s2.received_[1]);
+      EXPECT_EQ(large, s2.received_[2]);
+    }
+    {
+      boost::mutex::scoped_lock lock(s1.mutex_);
+      ASSERT_EQ(1, s1.received_.size());
+      EXPECT_EQ(small, s1.received_[0]);
+    }
+  }
+
+  usleep(200*1000);
+  boost::mutex::scoped_lock lock(callback_mutex);
+  EXPECT_TRUE(events.pop_type("p1_disconnect"));
+  EXPECT_TRUE(events.is_empty());
+};
+
+TEST(NetworkTest, InProcess)
+{
+  darc::test::event_list events;
+
+  boost::asio::io_service io;
+  darc::peer p1;
+  darc::peer p2;
+  darc::peer p3;
+  p2.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p2_connect", _1));
+  p2.peer_disconnected_signal().connect(boost::bind(&locked_callback, &events, "p2_disconnect", _1));
+  p3.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p3_connect", _1));
+  string_service s1(p1);
+  string_service s2(p2);
+  string_service s3(p3);
+  darc::network::network_manager n2(io, p2);
+  darc::network::network_manager n3(io, p3);
+
+  // Waits for somebody to accept
+  n2.connect("inproc://bus");
+  n3.connect("inproc://bus");
+
+  {
+    darc::network::network_manager n1(io, p1);
+    n1.accept("inproc://bus");
+    EXPECT_THROW(n1.accept("inproc://bus"), darc::network::address_in_use_exception);
+
+    usleep(100*1000);
+    {
+      boost::mutex::scoped_lock lock(callback_mutex);
+      EXPECT_TRUE(events.pop_type("p2_connect"));
+      EXPECT_TRUE(events.pop_type("p3_connect"));
+      EXPECT_TRUE(events.is_empty());
+    }
+
+    // One buffer, read by both
+    std::string text(10000, 'i');
+    s1.send_to(darc::ID::null(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+    s2.send_to(p1.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+
+    usleep(100*1000);
+    {
+      boost::mutex::scoped_lock lock2(s2.mutex_);
+      boost::mutex::scoped_lock lock3(s3.mutex_);
+      boost::mutex::scoped_lock lock1(s1.mutex_);
+      ASSERT_EQ(1, s2.received_.size());
+      ASSERT_EQ(1, s3.received_.size());
+      ASSERT_EQ(1, s1.received_.size());
+      EXPECT_EQ(text, s2.received_[0]);
+      EXPECT_EQ(text, s3.received_[0]);
+      EXPECT_EQ(text, s1.received_[0]);
+    }
+  }
+
+  {
+    boost::mutex::scoped_lock lock(callback_mutex);
+    EXPECT_TRUE(events.pop_type("p2_disconnect"));
+    EXPECT_TRUE(events.is_empty());
+  }
+
+  // Connected again when the name is accepted on again
+  darc::network::network_manager n1(io, p1);
+  n1.accept("inproc://bus");
+  usleep(100*1000);
+  boost::mutex::scoped_lock lock(callback_mutex);
+  EXPECT_TRUE(events.pop_type("p2_connect"));
+  EXPECT_TRUE(events.pop_type("p3_connect"));
+  EXPECT_TRUE(events.is_empty());
+};
+
+TEST(NetworkTest, TruncatedFrame)
+{
+  boost::asio::io_service io;
+  darc::peer p1;
+  string_service s1(p1);
+  darc::network::network_manager n1(io, p1);
+  darc::network::inproc::inproc_protocol_manager manager(&n1, p1);
+  darc::network::inbound_link_base * link = &manager;
+
+  // Shorter than the link header
+  darc::buffer::shared_buffer frame = darc::buffer::chain_buffer::create();
+  frame->streambuf()->sputn("short", 5);
+  EXPECT_NO_THROW(link->packet_received(frame));
+
+  // A DATA link header without the data header behind it
+  darc::buffer::shared_buffer data = darc::buffer::chain_buffer::create();
+  data->streambuf()->sputn("x", 1);
+  darc::network::inbound_link_base::prepend_link_header(darc::ID::create(), darc::ID::null(),
+                                                        darc::link_header_packet::DATA, data);
+  EXPECT_NO_THROW(link->packet_received(data));
+
+  boost::mutex::scoped_lock lock(s1.mutex_);
+  EXPECT_TRUE(s1.received_.empty());
+};
+
+TEST(NetworkTest, Multicast)
+{
+  darc::test::event_list events;
+  std::string group = "udp+multicast://239.255.42.99:" + boost::lexical_cast<std::string>(20000 + getpid() % 10000);
+
+  boost::asio::io_service io1;
+  darc::peer p1;
+  p1.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p1_connect", _1));
+  p1.peer_disconnected_signal().connect(boost::bind(&locked_callback, &events, "p1_disconnect", _1));
+  darc::network::network_manager n1(io1, p1);
+  string_service s1(p1);
+  n1.accept(group);
+  EXPECT_THROW(n1.connect(group), darc::network::address_in_use_exception);
+  EXPECT_THROW(n1.accept("udp+multicast://10.0.0.1:5600"), darc::network::invalid_url_exception);
+
+  boost::asio::io_service io2;
+  darc::peer p2;
+  darc::network::network_manager n2(io2, p2);
+  string_service s2(p2);
+  n2.connect(group);
+
+  {
+    boost::asio::io_service io3;
+    darc::peer p3;
+    darc::network::network_manager n3(io3, p3);
+    string_service s3(p3);
+    n3.connect(group);
+
+    usleep(500*1000);
+    {
+      boost::mutex::scoped_lock lock(callback_mutex);
+      EXPECT_TRUE(events.pop_type("p1_connect"));
+      EXPECT_TRUE(events.pop_type("p1_connect"));
+      EXPECT_TRUE(events.is_empty());
+    }
+
+    // Sent to the group once, the large one in fragments
+    std::string small(100, 's');
+    std::string large(200 * 1000, 'l');
+    s1.send_to(darc::ID::null(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small));
+    s1.send_to(darc::ID::null(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(large));
+    s2.send_to(p1.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small));
+
+    usleep(200*1000);
+    {
+      boost::mutex::scoped_lock lock(s2.mutex_);
+      ASSERT_EQ(2, s2.received_.size());
+      EXPECT_EQ(small, s2.received_[0]);
+      EXPECT_EQ(large, s2.received_[1]);
+    }
+    {
+      boost::mutex::scoped_lock lock(s3.mutex_);
+      ASSERT_EQ(2, s3.received_.size());
+      EXPECT_EQ(small, s3.received_[0]);
+      EXPECT_EQ(large, s3.received_[1]);
+    }
+    {
+      boost::mutex::scoped_lock lock(s1.mutex_);
+      ASSERT_EQ(1, s1.received_.size());
+      EXPECT_EQ(small, s1.received_[0]);
+    }
+  }
+
+  usleep(200*1000);
+  boost::mutex::scoped_lock lock(callback_mutex);
+  EXPECT_TRUE(events.pop_type("p1_disconnect"));
+  EXPECT_TRUE(events.is_empty());
+};
+
+// Records the frames the network_manager routes to it
+class recording_manager : public darc::network::protocol_manager_base
+{
+public:
+  std::vector<std::pair<darc::ID, darc::ID> > sent_; // outbound id, topic peer
+
+  void accept(const std::string& protocol, const std::string& url)
+  {
+  }
+
+  void connect(const std::string& protocol, const std::string& url)
+  {
+  }
+
+  void send_frame(const darc::ID& outbound_id, const darc::ID& topic_peer_id, darc::buffer::shared_buffer data)
+  {
+    sent_.push_back(std::make_pair(outbound_id, topic_peer_id));
+  }
+};
+
+TEST(NetworkTest, SharedGroupRouting)
+{
+  boost::asio::io_service io;
+  darc::peer p1;
+  string_service s1(p1);
+  darc::network::network_manager n1(io, p1);
+
+  recording_manager unicast;
+  recording_manager group;
+  darc::ID link = darc::ID::create();
+  darc::ID shared = darc::ID::create();
+  n1.register_connection(link, &unicast);
+  n1.register_connection(shared, &group, true);
+
+  darc::ID p2 = darc::ID::create();
+  darc::ID p3 = darc::ID::create();
+  n1.neighbour_peer_discovered(p2, link);
+  n1.neighbour_peer_discovered(p2, shared);
+  n1.neighbour_peer_discovered(p3, shared);
+
+  // To one peer on its own link, and on the group only without one
+  std::string text(100, 'r');
+  s1.send_to(p2, darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+  s1.send_to(p3, darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+  ASSERT_EQ(1, unicast.sent_.size());
+  EXPECT_EQ(link, unicast.sent_[0].first);
+  EXPECT_EQ(p2, unicast.sent_[0].second);
+  ASSERT_EQ(1, group.sent_.size());
+  EXPECT_EQ(p3, group.sent_[0].second);
+
+  // Broadcasts go on the group once, for both
+  s1.send_to(darc::ID::null(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+  EXPECT_EQ(1, unicast.sent_.size());
+  ASSERT_EQ(2, group.sent_.size());
+  EXPECT_EQ(darc::ID::null(), group.sent_[1].second);
+
+  // Still reached on the group once its own link is gone
+  n1.neighbour_peer_disconnected(p2, link);
+  s1.send_to(p2, darc::outbound_data<darc::serializer::boost_serializer, std::string>(text));
+  EXPECT_EQ(1, unicast.sent_.size());
+  ASSERT_EQ(3, group.sent_.size());
+  EXPECT_EQ(p2, group.sent_[2].second);
+};
+
+TEST(NetworkTest, AsioTcp)
+{
+  darc::test::event_list events;
+  std::string url = "asio+tcp://127.0.0.1:" + boost::lexical_cast<std::string>(30000 + getpid() % 10000);
+
+  // Everything runs on the io_service threads
+  boost::asio::io_service io1;
+  boost::scoped_ptr<boost::asio::io_service::work> work1(new boost::asio::io_service::work(io1));
+  boost::thread_group threads1;
+  threads1.create_thread(boost::bind(&boost::asio::io_service::run, &io1));
+  threads1.create_thread(boost::bind(&boost::asio::io_service::run, &io1));
+
+  {
+    darc::peer p1;
+    p1.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p1_connect", _1));
+    p1.peer_disconnected_signal().connect(boost::bind(&locked_callback, &events, "p1_disconnect", _1));
+    darc::network::network_manager n1(io1, p1);
+    string_service s1(p1);
+    n1.accept(url);
+    EXPECT_THROW(n1.accept(url), darc::network::address_in_use_exception);
+    EXPECT_THROW(n1.accept("asio+tcp://127.0.0.1:1?mtu=1"), darc::network::invalid_url_exception);
+
+    boost::asio::io_service io2;
+    boost::scoped_ptr<boost::asio::io_service::work> work2(new boost::asio::io_service::work(io2));
+    boost::thread thread2(boost::bind(&boost::asio::io_service::run, &io2));
+    {
+      darc::peer p2;
+      p2.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p2_connect", _1));
+      darc::network::network_manager n2(io2, p2);
+      string_service s2(p2);
+      n2.connect(url);
+
+      usleep(500*1000);
+      {
+        boost::mutex::scoped_lock lock(callback_mutex);
+        EXPECT_TRUE(events.pop_type("p1_connect"));
+        EXPECT_TRUE(events.pop_type("p2_connect"));
+        EXPECT_TRUE(events.is_empty());
+      }
+
+      // Slices of a read chunk, and a frame read on its own
+      std::string small(100, 's');
+      std::string large(3 * 1000 * 1000, 'l');
+      const int burst = 200;
+      for(int i = 0; i < burst; i++)
+      {
+        s1.send_to(p2.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small + boost::lexical_cast<std::string>(i)));
+      }
+      s1.send_to(p2.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(large));
+      s2.send_to(p1.id(), darc::outbound_data<darc::serializer::boost_serializer, std::string>(small));
+
+      usleep(200*1000);
+      {
+        boost::mutex::scoped_lock lock(s2.mutex_);
+        ASSERT_EQ(burst + 1, s2.received_.size());
+        for(int i = 0; i < burst; i++)
+        {
+          EXPECT_EQ(small + boost::lexical_cast<std::string>(i), s2.received_[i]);
+        }
+        EXPECT_EQ(large, s2.received_[burst]);
+      }
+      {
+        boost::mutex::scoped_lock lock(s1.mutex_);
+        ASSERT_EQ(1, s1.received_.size());
+        EXPECT_EQ(small, s1.received_[0]);
+      }
+    }
+    // The aborted operations complete, and run() returns
+    work2.reset();
+    thread2.join();
+
+    usleep(200*1000);
+    boost::mutex::scoped_lock lock(callback_mutex);
+    EXPECT_TRUE(events.pop_type("p1_disconnect"));
+    EXPECT_TRUE(events.is_empty());
+  }
+  work1.reset();
+  threads1.join_all();
+};
+
+TEST(NetworkTest, ConnectIpc)
+{
+  darc::test::event_list events;
+  std::string path = "/tmp/darc_gtest_ipc_" + boost::lexical_cast<std::string>(getpid());
+
+  boost::asio::io_service io1; // not used by zmq
+  darc::peer p1;
+  p1.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p1_connect", _1));
+  p1.peer_disconnected_signal().connect(boost::bind(&locked_callback, &events, "p1_disconnect", _1));
+  darc::network::network_manager n1(io1, p1);
+  n1.accept("zmq+ipc://" + path + "_1");
+  n1.connect("zmq+ipc://" + path + "_2");
+
+  {
+    boost::asio::io_service io2; // not used by zmq
+    darc::peer p2;
+    p2.peer_connected_signal().connect(boost::bind(&locked_callback, &events, "p2_connect", _1));
+    darc::network::network_manager n2(io2, p2);
+    EXPECT_THROW(n2.accept("zmq+ipc://" + path + "_1"), darc::network::address_in_use_exception);
+    n2.accept("zmq+ipc://" + path + "_2");
+    n2.connect("zmq+ipc://" + path + "_1");
+
+    usleep(1000*1000);
+    boost::mutex::scoped_lock lock(callback_mutex);
+    EXPECT_TRUE(events.pop_type("p1_connect"));
+    EXPECT_TRUE(events.pop_type("p2_connect"));
+    EXPECT_TRUE(events.is_empty());
+  }
+  usleep(1000*1000);
+  boost::mutex::scoped_lock lock(callback_mutex);
+  EXPECT_TRUE(events.pop_type("p1_disconnect"));
+  EXPECT_TRUE(events.is_empty());
+};
+
+TEST(NetworkTest, LinkChecksumEndToEnd)
+{
+  boost::asio::io_service io;
+  darc::peer p1;
+  darc::peer p2;
+  data_service s1(p1);
+  data_service s2(p2);
+  darc::network::network_manager n1(io, p1);
+  darc::network::network_manager n2(io, p2);
+  n1.set_link_checksum(true);
+  n2.set_link_checksum(true);
+
+  n1.accept("inproc://checksum");
+  n2.connect("inproc://checksum");
+  usleep(100*1000);
+  ASSERT_TRUE(s2.data_header_supported(p1.id()));
+
+  std::string text(3000, 'c');
+  keeping_allocator allocator;
+  s2.send_data(p1.id(), darc::data_header_packet(),
+               darc::outbound_data<darc::serializer::boost_serializer, std::string>(text), &allocator);
+  usleep(100*1000);
+  {
+    boost::mutex::scoped_lock lock(s1.mutex_);
+    ASSERT_EQ(1, s1.received_.size());
+    EXPECT_EQ(text, s1.received_[0]);
+  }
+  EXPECT_EQ(0u, n1.link_checksum_failures());
+
+  // The frame as it was sent, link header first
+  darc::buffer::shared_chain_buffer frame = darc::buffer::chain_buffer::create();
+  darc::buffer::buffer::segment_list_type segments;
+  allocator.last_->segments(segments);
+  for(darc::buffer::buffer::segment_list_type::iterator it = segments.begin();
+      it != segments.end();
+      it++)
+  {
+    frame->sputn(boost::asio::buffer_cast<const char*>(*it), boost::asio::buffer_size(*it));
+  }
+  {
+    darc::buffer::shared_buffer sent = darc::buffer::slice_buffer::unread(frame);
+    darc::inbound_data<darc::serializer::raw_serializer, darc::link_header_packet> header_i(sent);
+    EXPECT_EQ(darc::link_header_packet::DATA | darc::link_header_packet::CHECKSUM, header_i.get().packet_type);
+  }
+
+  // The same frame with one flipped bit in the payload is dropped
+  frame->data()[frame->len() - 1] ^= 0x10;
+  darc::network::inproc::inproc_protocol_manager receiver(&n1, p1);
+  receiver.packet_received(frame);
+  EXPECT_EQ(1u, n1.link_checksum_failures());
+  boost::mutex::scoped_lock lock(s1.mutex_);
+  EXPECT_EQ(1, s1.received_.size());
+};
+
+TEST(NetworkTest, BufferCache)
+{
+  darc::network::zeromq::zmq_buffer_cache cache(2);
+
+  boost::shared_ptr<darc::network::zeromq::zmq_buffer> b1 = cache.acquire();
+  boost::shared_ptr<darc::network::zeromq::zmq_buffer> b2 = cache.acquire();
+  EXPECT_NE(b1, b2);
+  EXPECT_EQ(2, cache.size());
+
+  // Full, and everything in use
+  boost::shared_ptr<darc::network::zeromq::zmq_buffer> b3 = cache.acquire();
+  EXPECT_EQ(2, cache.size());
+
+  // Reused once dropped by everyone else
+  darc::network::zeromq::zmq_buffer * p1 = b1.get();
+  b1.reset();
+  boost::shared_ptr<darc::network::zeromq::zmq_buffer> b4 = cache.acquire();
+  EXPECT_EQ(p1, b4.get());
+
+  // The message is closed as soon as the buffer goes back, not when it is
+  // received into again
+  darc::network::zeromq::zmq_buffer * p2 = b2.get();
+  b2->rebuild(100);
+  b2.reset();
+  EXPECT_EQ(0u, p2->size());
+};
+
+TEST(NetworkTest, Crc32c)
+{
+  EXPECT_EQ(0xe3069283, darc::network::crc32c(0, "123456789", 9));
+  EXPECT_EQ(0xe3069283, darc::network::crc32c_software(0, "123456789", 9));
+
+  // Long enough for the three way hardware path, at an odd offset
+  std::vector<char> data(100000);
+  for(size_t i = 0; i < data.size(); i++)
+  {
+    data[i] = (char)(i * 31 + (i >> 8));
+  }
+  uint32_t crc = darc::network::crc32c(0, &data[1], data.size() - 1);
+  EXPECT_EQ(darc::network::crc32c_software(0, &data[1], data.size() - 1), crc);
+  EXPECT_EQ(crc, darc::network::crc32c(darc::network::crc32c(0, &data[1], 30000),
+                                       &data[30001], data.size() - 30001));
+};
+
+TEST(NetworkTest, LinkChecksum)
+{
+  std::string payload(5000, 'p');
+  darc::buffer::shared_chain_buffer frame = darc::buffer::chain_buffer::create();
+  frame->streambuf()->sputn(payload.data(), payload.size());
+  darc::buffer::shared_buffer data = frame;
+
+  darc::ID src = darc::ID::create();
+  darc::network::inbound_link_base::prepend_link_header(src, darc::ID::null(),
+                                                        darc::link_header_packet::SERVICE,
+                                                        data, true);
+  EXPECT_EQ(34 + 4 + payload.size(), data->len());
+
+  // Intact
+  {
+    darc::buffer::shared_buffer received = darc::buffer::slice_buffer::unread(data);
+    darc::inbound_data<darc::serializer::raw_serializer, darc::link_header_packet> header_i(received);
+    EXPECT_TRUE(header_i.get().packet_type & darc::link_header_packet::CHECKSUM);
+    EXPECT_TRUE(darc::network::inbound_link_base::verify_link_checksum(header_i.get(), received));
+    EXPECT_EQ(payload.size(), received->len() - 38);
+  }
+
+  // One flipped bit in the payload
+  data->data()[38 + 1234] ^= 0x10;
+  {
+    darc::buffer::shared_buffer received = darc::buffer::slice_buffer::unread(data);
+    darc::inbound_data<darc::serializer::raw_serializer, darc::link_header_packet> header_i(received);
+    EXPECT_FALSE(darc::network::inbound_link_base::verify_link_checksum(header_i.get(), received));
+  }
+};
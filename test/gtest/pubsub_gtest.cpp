@@ -4,6 +4,7 @@
 #include <darc/primitives/pubsub/publisher.hpp>
 #include <darc/primitives/pubsub/subscriber.hpp>
 #include <darc/primitives/pubsub/message_service.hpp>
+#include <darc/buffer/memory_accounting.hpp>
 
 #include <darc/id.hpp>
 
@@ -62,3 +63,210 @@ TEST_F(PubSubTest, PubSub)
   io_service.run();
 
 };
+
+void string_handler(std::string * result, const std::string& data)
+{
+  *result = data;
+}
+
+TEST_F(PubSubTest, LargeMessage)
+{
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<std::string> MySub;
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("id1");
+  test_sub.attach("id1");
+
+  std::string received;
+  test_sub.addCallback(boost::bind(&string_handler, &received, _1));
+
+  // Larger than the old fixed 1024 byte frames and 10 KB send buffer
+  std::string data(100*1024, 'x');
+  test_pub.publish(data);
+  io_service.run();
+
+  EXPECT_EQ(data, received);
+};
+
+TEST_F(PubSubTest, MemoryAccounting)
+{
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<std::string> MySub;
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("accounting");
+  test_sub.attach("accounting");
+
+  std::string received;
+  test_sub.addCallback(boost::bind(&string_handler, &received, _1));
+
+  // Many times the chunk the send buffer starts with
+  std::string data(1000*1000, 'm');
+  test_pub.publish(data);
+  io_service.run();
+  EXPECT_EQ(data, received);
+
+  // Charged in full to the topic while it was sent, to all peers
+  darc::buffer::memory_accounting::entry_list_type list;
+  darc::buffer::memory_accounting::instance().entries(list);
+  bool found = false;
+  for(darc::buffer::memory_accounting::entry_list_type::iterator it = list.begin();
+      it != list.end();
+      it++)
+  {
+    if(it->tag.service == 13 && it->tag.peer == darc::ID::null() && it->peak >= data.size())
+    {
+      found = true;
+      EXPECT_EQ(0, it->live);
+    }
+  }
+  EXPECT_TRUE(found);
+};
+
+TEST_F(PubSubTest, DataHeader)
+{
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<std::string> MySub;
+
+  enable_data_header();
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("id1");
+  test_sub.attach("id1");
+
+  std::string received;
+  test_sub.addCallback(boost::bind(&string_handler, &received, _1));
+
+  std::string data("data header");
+  test_pub.publish(data);
+  io_service.run();
+
+  EXPECT_EQ(data, received);
+};
+
+void count_handler(int * count, const uint32_t& data)
+{
+  (*count)++;
+}
+
+TEST_F(PubSubTest, TypeMismatch)
+{
+  EXPECT_NE(0u, darc::serializer::type_fingerprint<uint32_t>::value());
+  EXPECT_NE(darc::serializer::type_fingerprint<uint32_t>::value(),
+            darc::serializer::type_fingerprint<std::string>::value());
+
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<uint32_t> MySub;
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("id1");
+  test_sub.attach("id1");
+
+  int count = 0;
+  test_sub.addCallback(boost::bind(&count_handler, &count, _1));
+
+  // Would decode as garbage, the publish packet fingerprint rejects it
+  test_pub.publish(std::string("not a uint32"));
+  io_service.run();
+
+  EXPECT_EQ(0, count);
+};
+
+TEST_F(PubSubTest, Compression)
+{
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<std::string> MySub;
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("id1");
+  test_sub.attach("id1");
+  test_pub.set_compression(darc::compression::compression_config(darc::compression::codec::lz));
+
+  std::string received;
+  test_sub.addCallback(boost::bind(&string_handler, &received, _1));
+
+  std::string data(100*1024, 'c');
+  test_pub.publish(data);
+  io_service.run();
+
+  EXPECT_EQ(data, received);
+  EXPECT_EQ(1u, test_pub.compression_stats().compressed);
+  EXPECT_LT(test_pub.compression_stats().bytes_out, data.size() / 10);
+};
+
+void string_count_handler(std::string * result, int * count, const std::string& data)
+{
+  *result = data;
+  (*count)++;
+}
+
+TEST_F(PubSubTest, Delta)
+{
+  typedef darc::pubsub::publisher<std::string> MyPub;
+  typedef darc::pubsub::subscriber<std::string> MySub;
+
+  boost::asio::io_service io_service;
+
+  darc::pubsub::message_service my_service1(peer1, io_service, ns1);
+  MyPub test_pub(io_service, my_service1);
+
+  darc::pubsub::message_service my_service2(peer2, io_service, ns2);
+  MySub test_sub(io_service, my_service2);
+
+  test_pub.attach("id1");
+  test_sub.attach("id1");
+  test_pub.set_delta(darc::compression::delta_config());
+
+  std::string received;
+  int count = 0;
+  test_sub.addCallback(boost::bind(&string_count_handler, &received, &count, _1));
+
+  std::string data(10*1024, 'd');
+  for(int i = 0; i < 3; i++)
+  {
+    data[i * 100] = 'x';
+    test_pub.publish(data);
+  }
+  io_service.run();
+
+  EXPECT_EQ(3, count);
+  EXPECT_EQ(data, received);
+  EXPECT_EQ(1u, test_pub.delta_stats().keyframes);
+  EXPECT_LT(test_pub.delta_stats().bytes_out, data.size() + 100);
+};